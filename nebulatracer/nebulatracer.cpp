@@ -1,5 +1,16 @@
 #define HL_NAME(n) nebulatracer_##n
 
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 #define GLAD_MX
 #include "gl.h"
 #include <GLFW/glfw3.h>
@@ -16,6 +27,17 @@
 #include <thread>
 #include <chrono>
 #include <mutex>
+#include <cstring>
+#include <cmath>
+#include <xmmintrin.h>
+#include <emmintrin.h>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <algorithm>
+#include <deque>
+#include <memory>
+#include <shared_mutex>
 
 std::mutex glMutex;
 
@@ -43,9 +65,38 @@ typedef struct
     int primID;
 } HitResult;
 
+// Layout must match `NebulaTracer.MATERIAL_SIZE`, one record per geomID.
+typedef struct
+{
+    float red, green, blue;
+    float reflectiveness;
+    float emissiveness;
+    int isEmitter;
+    int pad0, pad1;
+} MaterialRecord;
+
+// Layout must match `NebulaTracer.LIGHT_SIZE`.
+typedef struct
+{
+    float posx, posy, posz;
+    float red, green, blue;
+    float power;
+    int geomID;
+} LightRecord;
+
+// One per MeshPart, the slot index is also the geomID of the part.
+// Embree owns copies of the part's buffers, Haxe may grow (reallocate) or edit its own whenever it wants.
+struct GeometrySlot {
+    RTCGeometry geom = nullptr;
+    uint64_t hash = 0;
+};
+
 struct RaytracerInstance {
     RTCDevice device = nullptr;
     RTCScene scene = nullptr;
+    std::vector<GeometrySlot> slots;
+    std::vector<MaterialRecord> materials;
+    std::vector<LightRecord> lights;
 
     RaytracerInstance() {
         device = rtcNewDevice(nullptr);
@@ -53,146 +104,3779 @@ struct RaytracerInstance {
     }
 
     ~RaytracerInstance() {
+        for (GeometrySlot& slot : slots)
+            if (slot.geom) rtcReleaseGeometry(slot.geom);
         if (scene) rtcReleaseScene(scene);
         if (device) rtcReleaseDevice(device);
     }
-};
+};
+
+std::unordered_map<int, RaytracerInstance*> raytracers;
+// traces only read the scene and share the lock, anything that edits it takes it exclusively
+std::shared_mutex raytracerMutex;
+int nextID = 0;
+
+extern "C" void createRaytracer() {
+    std::lock_guard<std::shared_mutex> lock(raytracerMutex);
+    int id = nextID++;
+    raytracers[id] = new RaytracerInstance();
+}
+
+extern "C" void disposeRaytracer(int id) {
+    std::lock_guard<std::shared_mutex> lock(raytracerMutex);
+    if (raytracers.count(id)) {
+        delete raytracers[id];
+        raytracers.erase(id);
+    }
+}
+
+extern "C" void buildBVH(int id) {
+    std::lock_guard<std::shared_mutex> lock(raytracerMutex);
+    if (raytracers.count(id)) {
+        rtcSetSceneFlags(raytracers[id]->scene, RTC_SCENE_FLAG_DYNAMIC | RTC_SCENE_FLAG_ROBUST);
+        rtcCommitScene(raytracers[id]->scene);
+    }
+}
+
+// Embree has no refitting... :(
+extern "C" void refitBVH(int id) {
+    buildBVH(id);
+}
+
+extern "C" void rebuildBVH(int id) {
+    buildBVH(id);
+}
+
+extern "C" HitResult traceRay(int id, SimpleRay* ray) {
+    std::shared_lock<std::shared_mutex> lock(raytracerMutex);
+    HitResult result = {};
+    auto it = raytracers.find(id);
+    if (it == raytracers.end())
+        return result;
+    RaytracerInstance* instance = it->second;
+
+    RTCRayHit rayhit = {};
+    rayhit.ray = {};
+    rayhit.hit = {};
+    rayhit.ray.org_x = ray->posx;
+    rayhit.ray.org_y = ray->posy;
+    rayhit.ray.org_z = ray->posz;
+    rayhit.ray.dir_x = ray->dirx;
+    rayhit.ray.dir_y = ray->diry;
+    rayhit.ray.dir_z = ray->dirz;
+    rayhit.ray.tnear = 0.0f;
+    rayhit.ray.tfar = INFINITY;
+    rayhit.ray.time = 0.0f;
+    rayhit.ray.mask = -1;
+    rayhit.ray.id = 0;
+    rayhit.ray.flags = 0;
+    rayhit.hit.geomID = RTC_INVALID_GEOMETRY_ID;
+    rayhit.hit.primID = RTC_INVALID_GEOMETRY_ID;
+    rayhit.hit.instID[0] = RTC_INVALID_GEOMETRY_ID;
+    rtcIntersect1(instance->scene, &rayhit);
+	result.distance = rayhit.ray.tfar;
+	result.hit = rayhit.hit.geomID != RTC_INVALID_GEOMETRY_ID;
+	result.geomID = rayhit.hit.geomID;
+	result.primID = rayhit.hit.primID;
+    return result;
+}
+
+void loadGeometry(const char* json, int id) {
+    JSON_Value* rootVal = json_parse_string(json);
+    JSON_Object* rootObj = json_value_get_object(rootVal);
+    JSON_Array* geometryArr = json_object_get_array(rootObj, "geometry");
+    RaytracerInstance* raytracer = raytracers[id];
+	RTCDevice device = raytracer->device;
+	RTCScene scene = raytracer->scene;
+
+    for (GeometrySlot& slot : raytracer->slots)
+        if (slot.geom) rtcReleaseGeometry(slot.geom);
+    raytracer->slots.clear();
+    rtcReleaseScene(scene);
+    raytracer->scene = rtcNewScene(device);
+    scene = raytracer->scene;
+    rtcSetSceneFlags(scene, RTC_SCENE_FLAG_DYNAMIC | RTC_SCENE_FLAG_ROBUST);
+   
+    for (size_t i = 0; i < json_array_get_count(geometryArr); ++i) {
+        JSON_Object* meshObj = json_array_get_object(geometryArr, i);
+        JSON_Array* parts = json_object_get_array(meshObj, "meshParts");
+
+        for (size_t j = 0; j < json_array_get_count(parts); ++j) {
+            JSON_Object* part = json_array_get_object(parts, j);
+            JSON_Array* indices = json_object_get_array(part, "indices");
+            JSON_Array* vertices = json_object_get_array(part, "vertices");
+
+            size_t indexCount = json_array_get_count(indices);
+            size_t vertexCount = json_array_get_count(vertices);
+
+            unsigned* inds = new unsigned[indexCount];
+            float* verts = new float[vertexCount];
+
+            for (size_t k = 0; k < indexCount; ++k)
+                inds[k] = (unsigned)json_array_get_number(indices, k);
+            for (size_t i = 0; i < vertexCount; ++i) {
+                verts[i] = (float)json_array_get_number(vertices, i);
+            }
+
+            size_t triangleCount = indexCount / 3;
+            size_t vertexCount3 = vertexCount / 3;
+
+            RTCGeometry geom = rtcNewGeometry(device, RTC_GEOMETRY_TYPE_TRIANGLE);
+
+            rtcSetSharedGeometryBuffer(
+                geom,
+                RTC_BUFFER_TYPE_VERTEX,
+                0,
+                RTC_FORMAT_FLOAT3,
+                verts,
+                0,
+                sizeof(float) * 3,
+                vertexCount3
+            );
+
+            rtcSetSharedGeometryBuffer(
+                geom,
+                RTC_BUFFER_TYPE_INDEX,
+                0,
+                RTC_FORMAT_UINT3,
+                inds,
+                0,
+                sizeof(unsigned) * 3,
+                triangleCount
+            );
+
+            rtcCommitGeometry(geom);
+            rtcAttachGeometry(scene, geom);
+            rtcReleaseGeometry(geom);
+        }
+    }
+
+    rtcCommitScene(scene);
+    json_value_free(rootVal);
+}
+
+//--------- Geometry change detection ---------//
+// 64-bit content hash (xxHash64). The 4 independent lanes let the compiler keep them in vector registers.
+static const uint64_t HASH_PRIME1 = 0x9E3779B185EBCA87ULL;
+static const uint64_t HASH_PRIME2 = 0xC2B2AE3D27D4EB4FULL;
+static const uint64_t HASH_PRIME3 = 0x165667B19E3779F9ULL;
+static const uint64_t HASH_PRIME4 = 0x85EBCA77C2B2AE63ULL;
+static const uint64_t HASH_PRIME5 = 0x27D4EB2F165667C5ULL;
+
+static inline uint64_t rotl64(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t read64(const unsigned char* p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint32_t read32(const unsigned char* p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint64_t hashRound(uint64_t acc, uint64_t input) {
+    acc += input * HASH_PRIME2;
+    acc = rotl64(acc, 31);
+    return acc * HASH_PRIME1;
+}
+
+static inline uint64_t hashMerge(uint64_t acc, uint64_t lane) {
+    acc ^= hashRound(0, lane);
+    return acc * HASH_PRIME1 + HASH_PRIME4;
+}
+
+uint64_t hash64(const void* data, size_t len, uint64_t seed) {
+    const unsigned char* p = (const unsigned char*)data;
+    const unsigned char* end = p + len;
+    uint64_t h;
+
+    if (len >= 32) {
+        uint64_t lanes[4] = { seed + HASH_PRIME1 + HASH_PRIME2, seed + HASH_PRIME2, seed, seed - HASH_PRIME1 };
+        const unsigned char* limit = end - 32;
+        do {
+            for (int i = 0; i < 4; ++i)
+                lanes[i] = hashRound(lanes[i], read64(p + i * 8));
+            p += 32;
+        } while (p <= limit);
+
+        h = rotl64(lanes[0], 1) + rotl64(lanes[1], 7) + rotl64(lanes[2], 12) + rotl64(lanes[3], 18);
+        for (int i = 0; i < 4; ++i)
+            h = hashMerge(h, lanes[i]);
+    }
+    else {
+        h = seed + HASH_PRIME5;
+    }
+
+    h += (uint64_t)len;
+    for (; p + 8 <= end; p += 8)
+        h = rotl64(h ^ hashRound(0, read64(p)), 27) * HASH_PRIME1 + HASH_PRIME4;
+    if (p + 4 <= end) {
+        h = rotl64(h ^ ((uint64_t)read32(p) * HASH_PRIME1), 23) * HASH_PRIME2 + HASH_PRIME3;
+        p += 4;
+    }
+    for (; p < end; ++p)
+        h = rotl64(h ^ ((*p) * HASH_PRIME5), 11) * HASH_PRIME1;
+
+    h ^= h >> 33;
+    h *= HASH_PRIME2;
+    h ^= h >> 29;
+    h *= HASH_PRIME3;
+    h ^= h >> 32;
+    return h;
+}
+
+static void releaseSlot(RaytracerInstance* raytracer, unsigned slotID) {
+    GeometrySlot& slot = raytracer->slots[slotID];
+    if (slot.geom) {
+        rtcDetachGeometry(raytracer->scene, slotID);
+        rtcReleaseGeometry(slot.geom);
+        slot.geom = nullptr;
+    }
+    slot.hash = 0;
+}
+
+extern "C" void setMeshPartCount(int id, int count) {
+    std::lock_guard<std::shared_mutex> lock(raytracerMutex);
+    if (!raytracers.count(id) || count < 0)
+        return;
+    RaytracerInstance* raytracer = raytracers[id];
+    for (size_t i = count; i < raytracer->slots.size(); ++i)
+        releaseSlot(raytracer, (unsigned)i);
+    raytracer->slots.resize(count);
+}
+
+static uint64_t meshPartHash(const float* vertices, int vertexCount, const unsigned* indices, int indexCount) {
+    uint64_t hash = hash64(vertices, sizeof(float) * 3 * vertexCount, (uint64_t)vertexCount);
+    hash = hash64(indices, sizeof(unsigned) * 3 * (indexCount / 3), hash);
+    return hash == 0 ? 1 : hash; // 0 means "empty slot"
+}
+
+// Whether a slot already holds exactly this geometry, so uploadMeshPart would do nothing.
+// Only takes the shared lock, threads tracing the scene keep going while it hashes.
+extern "C" bool meshPartMatches(int id, int slotID, const float* vertices, int vertexCount, const unsigned* indices, int indexCount) {
+    std::shared_lock<std::shared_mutex> lock(raytracerMutex);
+    auto it = raytracers.find(id);
+    if (it == raytracers.end() || slotID < 0 || (size_t)slotID >= it->second->slots.size())
+        return false;
+    return it->second->slots[slotID].hash == meshPartHash(vertices, vertexCount, indices, indexCount);
+}
+
+// Copies the buffers of a MeshPart into a slot, but only if their content hash differs from what the slot already has.
+// The copies live in embree's own (padded) buffers, so the BVH never points into memory the GC may move or free.
+// Returns whether the geometry changed, you have to rebuild the BVH if it did.
+extern "C" bool uploadMeshPart(int id, int slotID, const float* vertices, int vertexCount, const unsigned* indices, int indexCount) {
+    std::lock_guard<std::shared_mutex> lock(raytracerMutex);
+    if (!raytracers.count(id) || slotID < 0)
+        return false;
+    RaytracerInstance* raytracer = raytracers[id];
+    if ((size_t)slotID >= raytracer->slots.size())
+        raytracer->slots.resize(slotID + 1);
+    GeometrySlot& slot = raytracer->slots[slotID];
+
+    size_t triangleCount = indexCount / 3;
+    uint64_t hash = meshPartHash(vertices, vertexCount, indices, indexCount);
+    if (slot.hash == hash)
+        return false;
+
+    if (vertexCount <= 0 || triangleCount == 0) {
+        bool hadGeometry = slot.geom != nullptr;
+        releaseSlot(raytracer, slotID);
+        slot.hash = hash;
+        return hadGeometry;
+    }
+
+    bool attach = slot.geom == nullptr;
+    if (attach)
+        slot.geom = rtcNewGeometry(raytracer->device, RTC_GEOMETRY_TYPE_TRIANGLE);
+    // a new buffer replaces the old one, so parts that changed size are covered too
+    void* vertexBuffer = rtcSetNewGeometryBuffer(slot.geom, RTC_BUFFER_TYPE_VERTEX, 0, RTC_FORMAT_FLOAT3, sizeof(float) * 3, vertexCount);
+    void* indexBuffer = rtcSetNewGeometryBuffer(slot.geom, RTC_BUFFER_TYPE_INDEX, 0, RTC_FORMAT_UINT3, sizeof(unsigned) * 3, triangleCount);
+    memcpy(vertexBuffer, vertices, sizeof(float) * 3 * vertexCount);
+    memcpy(indexBuffer, indices, sizeof(unsigned) * 3 * triangleCount);
+    rtcCommitGeometry(slot.geom);
+    if (attach)
+        rtcAttachGeometryByID(raytracer->scene, slot.geom, slotID);
+
+    slot.hash = hash;
+    return true;
+}
+
+// Materials and lights live next to the scene, not inside it, so editing them never touches the BVH.
+extern "C" void updateMaterials(int id, const MaterialRecord* records, int start, int count, int total) {
+    std::lock_guard<std::shared_mutex> lock(raytracerMutex);
+    if (!raytracers.count(id) || start < 0 || count < 0 || start + count > total)
+        return;
+    std::vector<MaterialRecord>& materials = raytracers[id]->materials;
+    if ((int)materials.size() != total)
+        materials.resize(total, MaterialRecord{});
+    if (count > 0)
+        memcpy(&materials[start], records, sizeof(MaterialRecord) * count);
+}
+
+extern "C" void updateLights(int id, const LightRecord* records, int count) {
+    std::lock_guard<std::shared_mutex> lock(raytracerMutex);
+    if (!raytracers.count(id) || count < 0)
+        return;
+    std::vector<LightRecord>& lights = raytracers[id]->lights;
+    lights.resize(count);
+    if (count > 0)
+        memcpy(lights.data(), records, sizeof(LightRecord) * count);
+}
+
+//--------- Worker pool ---------//
+// Persistent threads for the parallel stages. parallelFor blocks until every index ran, the calling thread helps out.
+// Don't call parallelFor from inside a job, it'll deadlock.
+class WorkerPool {
+public:
+    static WorkerPool& shared() {
+        // never destroyed, joining threads while the dll unloads can deadlock
+        static WorkerPool* pool = new WorkerPool();
+        return *pool;
+    }
+
+    int size() const {
+        return (int)threads.size() + 1;
+    }
+
+    void parallelFor(int count, const std::function<void(int)>& fn) {
+        if (count <= 0)
+            return;
+        if (threads.empty() || count == 1) {
+            for (int i = 0; i < count; ++i)
+                fn(i);
+            return;
+        }
+
+        std::lock_guard<std::mutex> submit(submitMutex);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            job = &fn;
+            jobCount = count;
+            next = 0;
+            busy = (int)threads.size();
+            jobID++;
+        }
+        wake.notify_all();
+        runJob(fn, count);
+
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this] { return busy == 0; });
+        job = nullptr;
+    }
+
+private:
+    std::vector<std::thread> threads;
+    std::mutex submitMutex;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    const std::function<void(int)>* job = nullptr;
+    int jobCount = 0;
+    int busy = 0;
+    uint64_t jobID = 0;
+    std::atomic<int> next{ 0 };
+
+    WorkerPool() {
+        unsigned count = std::thread::hardware_concurrency();
+        for (unsigned i = 1; i < count; ++i)
+            threads.emplace_back([this] { workerLoop(); });
+    }
+
+    void runJob(const std::function<void(int)>& fn, int count) {
+        for (int i = next.fetch_add(1); i < count; i = next.fetch_add(1))
+            fn(i);
+    }
+
+    void workerLoop() {
+        uint64_t seen = 0;
+        while (true) {
+            const std::function<void(int)>* fn;
+            int count;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [&] { return jobID != seen; });
+                seen = jobID;
+                fn = job;
+                count = jobCount;
+            }
+            runJob(*fn, count);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (--busy == 0)
+                    done.notify_all();
+            }
+        }
+    }
+};
+
+//--------- Rasterizer ---------//
+// Mirrors `nebulatracer.RasterizerExt.ProjectionTransform`.
+typedef struct
+{
+    hl_type* t;
+    float meshX, meshY, meshZ;
+    float meshYaw, meshPitch, meshRoll;
+    float scaleX, scaleY, scaleZ;
+    float pivotX, pivotY, pivotZ;
+    float camX, camY, camZ;
+    float camYaw, camPitch;
+    float fov, aspect, nearPlane, farPlane;
+    float width, height;
+    float uvScaleU, uvScaleV, uvOffsetU, uvOffsetV;
+    float boundsX, boundsY, boundsZ, boundsRadius;
+    int cullMode;
+} ProjectionTransform;
+
+// Same values as `nebula.mesh.MeshPart.CullMode`
+enum CullMode { CULL_NONE = 0, CULL_CW = 1, CULL_CCW = 2 };
+
+// Row major, column vectors (p' = M * p)
+struct Mat4 {
+    float m[4][4];
+
+    static Mat4 identity() {
+        Mat4 r = {};
+        for (int i = 0; i < 4; ++i)
+            r.m[i][i] = 1.0f;
+        return r;
+    }
+
+    static Mat4 translation(float x, float y, float z) {
+        Mat4 r = identity();
+        r.m[0][3] = x;
+        r.m[1][3] = y;
+        r.m[2][3] = z;
+        return r;
+    }
+
+    static Mat4 scale(float x, float y, float z) {
+        Mat4 r = identity();
+        r.m[0][0] = x;
+        r.m[1][1] = y;
+        r.m[2][2] = z;
+        return r;
+    }
+
+    // Same order and signs as `N3DView.applyRotation`: yaw (y axis), then pitch (x axis), then roll (z axis)
+    static Mat4 rotation(float yaw, float pitch, float roll) {
+        float cy = cosf(yaw), sy = sinf(yaw);
+        float cp = cosf(pitch), sp = sinf(pitch);
+        float cr = cosf(roll), sr = sinf(roll);
+        Mat4 ry = identity(), rx = identity(), rz = identity();
+        ry.m[0][0] = cy; ry.m[0][2] = -sy;
+        ry.m[2][0] = sy; ry.m[2][2] = cy;
+        rx.m[1][1] = cp; rx.m[1][2] = -sp;
+        rx.m[2][1] = sp; rx.m[2][2] = cp;
+        rz.m[0][0] = cr; rz.m[0][1] = -sr;
+        rz.m[1][0] = sr; rz.m[1][1] = cr;
+        return rz * rx * ry;
+    }
+
+    // Same as `N3DView.projectionMatrix`
+    static Mat4 perspective(float fov, float aspect, float nearPlane, float farPlane) {
+        float f = 1.0f / tanf(fov * 3.14159265358979f / 360.0f);
+        float nf = 1.0f / (nearPlane - farPlane);
+        Mat4 r = {};
+        r.m[0][0] = f / aspect;
+        r.m[1][1] = f;
+        r.m[2][2] = (farPlane + nearPlane) * nf;
+        r.m[2][3] = 2.0f * farPlane * nearPlane * nf;
+        r.m[3][2] = -1.0f;
+        return r;
+    }
+
+    Mat4 operator*(const Mat4& o) const {
+        Mat4 r;
+        for (int i = 0; i < 4; ++i)
+            for (int j = 0; j < 4; ++j)
+                r.m[i][j] = m[i][0] * o.m[0][j] + m[i][1] * o.m[1][j] + m[i][2] * o.m[2][j] + m[i][3] * o.m[3][j];
+        return r;
+    }
+};
+
+static Mat4 modelMatrix(const ProjectionTransform* t) {
+    // parts rotate around their pivot (the centroid), not around the mesh origin
+    return Mat4::translation(t->pivotX + t->meshX, t->pivotY + t->meshY, t->pivotZ + t->meshZ)
+        * Mat4::rotation(t->meshYaw, t->meshPitch, t->meshRoll)
+        * Mat4::scale(t->scaleX, t->scaleY, t->scaleZ)
+        * Mat4::translation(-t->pivotX, -t->pivotY, -t->pivotZ);
+}
+
+static Mat4 viewMatrix(const ProjectionTransform* t) {
+    return Mat4::rotation(-t->camYaw, -t->camPitch, 0.0f) * Mat4::translation(-t->camX, -t->camY, -t->camZ);
+}
+
+// Transforms packed xyz positions into packed xyzw clip space positions, 4 lanes at a time.
+static void transformPositions(const Mat4& mat, const float* positions, int vertexCount, float* out) {
+    __m128 col0 = _mm_set_ps(mat.m[3][0], mat.m[2][0], mat.m[1][0], mat.m[0][0]);
+    __m128 col1 = _mm_set_ps(mat.m[3][1], mat.m[2][1], mat.m[1][1], mat.m[0][1]);
+    __m128 col2 = _mm_set_ps(mat.m[3][2], mat.m[2][2], mat.m[1][2], mat.m[0][2]);
+    __m128 col3 = _mm_set_ps(mat.m[3][3], mat.m[2][3], mat.m[1][3], mat.m[0][3]);
+    for (int i = 0; i < vertexCount; ++i) {
+        const float* p = positions + i * 3;
+        __m128 r = _mm_add_ps(
+            _mm_add_ps(_mm_mul_ps(col0, _mm_set1_ps(p[0])), _mm_mul_ps(col1, _mm_set1_ps(p[1]))),
+            _mm_add_ps(_mm_mul_ps(col2, _mm_set1_ps(p[2])), col3));
+        _mm_storeu_ps(out + i * 4, r);
+    }
+}
+
+struct ClipVertex {
+    float x, y, z, w;
+    float u, v;
+};
+
+static inline ClipVertex lerpClipVertex(const ClipVertex& a, const ClipVertex& b, float t) {
+    return {
+        a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t, a.z + (b.z - a.z) * t, a.w + (b.w - a.w) * t,
+        a.u + (b.u - a.u) * t, a.v + (b.v - a.v) * t
+    };
+}
+
+// Signed distance to the near (z >= -w) or far (z <= w) plane in clip space, inside is >= 0
+static inline float clipDistance(const ClipVertex& c, int plane) {
+    return plane == 0 ? c.z + c.w : c.w - c.z;
+}
+
+// Sutherland-Hodgman against one plane. A triangle clipped against both planes has at most 5 vertices.
+static int clipPolygon(const ClipVertex* in, int count, ClipVertex* out, int plane) {
+    int written = 0;
+    for (int i = 0; i < count; ++i) {
+        const ClipVertex& a = in[i];
+        const ClipVertex& b = in[(i + 1) % count];
+        float da = clipDistance(a, plane);
+        float db = clipDistance(b, plane);
+        if (da >= 0.0f)
+            out[written++] = a;
+        if ((da >= 0.0f) != (db >= 0.0f))
+            out[written++] = lerpClipVertex(a, b, da / (da - db));
+    }
+    return written;
+}
+
+// Writes the part's positions after the model transform (mesh position, rotation and scale around the pivot),
+// packed x, y, z like the input. N3DView caches the result and projects it with an identity model transform.
+extern "C" void transformMeshPart(const ProjectionTransform* t, const float* positions, int vertexCount, float* out) {
+    Mat4 model = modelMatrix(t);
+    alignas(16) float block[64 * 4];
+    for (int start = 0; start < vertexCount; start += 64) {
+        int count = std::min(64, vertexCount - start);
+        transformPositions(model, positions + start * 3, count, block);
+        for (int i = 0; i < count; ++i) {
+            out[(start + i) * 3] = block[i * 4];
+            out[(start + i) * 3 + 1] = block[i * 4 + 1];
+            out[(start + i) * 3 + 2] = block[i * 4 + 2];
+        }
+    }
+}
+
+// Tests the part's bounding sphere against the view frustum in view space (the camera looks down -z).
+static bool sphereInFrustum(const ProjectionTransform* t, const Mat4& modelView) {
+    if (t->boundsRadius < 0.0f)
+        return true;
+    float c[4];
+    float center[3] = { t->boundsX, t->boundsY, t->boundsZ };
+    transformPositions(modelView, center, 1, c);
+    float scale = std::max({ fabsf(t->scaleX), fabsf(t->scaleY), fabsf(t->scaleZ) });
+    float r = t->boundsRadius * scale;
+    float depth = -c[2];
+    if (depth + r < t->nearPlane || depth - r > t->farPlane)
+        return false;
+
+    float f = 1.0f / tanf(t->fov * 3.14159265358979f / 360.0f);
+    float a = f / t->aspect;
+    float sideX = (fabsf(c[0]) * a - depth) / sqrtf(a * a + 1.0f);
+    float sideY = (fabsf(c[1]) * f - depth) / sqrtf(f * f + 1.0f);
+    return sideX <= r && sideY <= r;
+}
+
+// Transforms a whole MeshPart into screen space, ready for drawTriangles.
+// Triangles crossing the near or far plane are clipped (and split) in clip space, so nothing pops out near the camera.
+// Output is an unindexed triangle list: 2 floats per vertex in outVerts, u/v/t in outUvt, a running index in outIndices
+// and 1/w in outDepth (optional, the native rasterizer uses it for depth and perspective correct UVs).
+// Returns the number of vertices written, the outputs must hold at least indexCount * 3 vertices.
+extern "C" int projectMeshPart(const ProjectionTransform* t, const float* positions, int vertexCount, const unsigned* indices, int indexCount,
+    const float* uvs, int uvCount, float* outVerts, float* outUvt, int* outIndices, float* outDepth) {
+    Mat4 modelView = viewMatrix(t) * modelMatrix(t);
+    if (!sphereInFrustum(t, modelView))
+        return 0;
+
+    thread_local std::vector<float> clip;
+    if (clip.size() < (size_t)vertexCount * 4)
+        clip.resize((size_t)vertexCount * 4);
+
+    Mat4 mvp = Mat4::perspective(t->fov, t->aspect, t->nearPlane, t->farPlane) * modelView;
+    transformPositions(mvp, positions, vertexCount, clip.data());
+
+    float halfWidth = t->width * 0.5f;
+    float halfHeight = t->height * 0.5f;
+    int written = 0;
+    auto emit = [&](const ClipVertex& c) {
+        float invW = 1.0f / c.w;
+        outVerts[written * 2] = (c.x * invW + 1.0f) * halfWidth;
+        outVerts[written * 2 + 1] = (c.y * invW + 1.0f) * halfHeight;
+        outUvt[written * 3] = c.u * t->uvScaleU + t->uvOffsetU;
+        outUvt[written * 3 + 1] = c.v * t->uvScaleV + t->uvOffsetV;
+        outUvt[written * 3 + 2] = 1.0f;
+        outIndices[written] = written;
+        if (outDepth)
+            outDepth[written] = invW;
+        written++;
+    };
+
+    ClipVertex polygon[8], clipped[8];
+    for (int tri = 0; tri + 2 < indexCount; tri += 3) {
+        unsigned idx[3] = { indices[tri], indices[tri + 1], indices[tri + 2] };
+        if (idx[0] >= (unsigned)vertexCount || idx[1] >= (unsigned)vertexCount || idx[2] >= (unsigned)vertexCount)
+            continue;
+
+        int outsideNear = 0, outsideFar = 0;
+        for (int i = 0; i < 3; ++i) {
+            const float* c = &clip[idx[i] * 4];
+            int uv = (int)idx[i] * 2;
+            polygon[i] = { c[0], c[1], c[2], c[3], uv + 1 < uvCount ? uvs[uv] : 0.0f, uv + 1 < uvCount ? uvs[uv + 1] : 0.0f };
+            outsideNear += clipDistance(polygon[i], 0) < 0.0f;
+            outsideFar += clipDistance(polygon[i], 1) < 0.0f;
+        }
+        if (outsideNear == 3 || outsideFar == 3)
+            continue;
+
+        int count = 3;
+        if (outsideNear > 0) {
+            count = clipPolygon(polygon, count, clipped, 0);
+            memcpy(polygon, clipped, sizeof(ClipVertex) * count);
+        }
+        if (outsideFar > 0) {
+            count = clipPolygon(polygon, count, clipped, 1);
+            memcpy(polygon, clipped, sizeof(ClipVertex) * count);
+        }
+
+        // clipping keeps the winding, so the first three vertices tell which way the whole polygon faces
+        if (t->cullMode != CULL_NONE) {
+            float ax = polygon[0].x / polygon[0].w, ay = polygon[0].y / polygon[0].w;
+            float bx = polygon[1].x / polygon[1].w - ax, by = polygon[1].y / polygon[1].w - ay;
+            float cx = polygon[2].x / polygon[2].w - ax, cy = polygon[2].y / polygon[2].w - ay;
+            // positive is clockwise on screen (y points down)
+            float area = bx * cy - cx * by;
+            if ((t->cullMode == CULL_CW && area > 0.0f) || (t->cullMode == CULL_CCW && area < 0.0f))
+                continue;
+        }
+
+        // fan out whatever is left
+        for (int i = 1; i + 1 < count; ++i) {
+            emit(polygon[0]);
+            emit(polygon[i]);
+            emit(polygon[i + 1]);
+        }
+    }
+    return written;
+}
+
+//--------- Projection batches ---------//
+// Parts are queued from Haxe and projected together across the worker pool.
+// The output buffers belong to the caller and have to stay alive until runProjectionBatch returns.
+struct ProjectionJob {
+    ProjectionTransform transform;
+    const float* positions;
+    int vertexCount;
+    const unsigned* indices;
+    int indexCount;
+    const float* uvs;
+    int uvCount;
+    float* outVerts;
+    float* outUvt;
+    int* outIndices;
+    float* outDepth;
+};
+
+std::unordered_map<int, std::vector<ProjectionJob>*> projectionBatches;
+std::mutex projectionMutex;
+int nextProjectionBatchID = 0;
+
+extern "C" int createProjectionBatch() {
+    std::lock_guard<std::mutex> lock(projectionMutex);
+    int id = nextProjectionBatchID++;
+    projectionBatches[id] = new std::vector<ProjectionJob>();
+    return id;
+}
+
+extern "C" void disposeProjectionBatch(int id) {
+    std::lock_guard<std::mutex> lock(projectionMutex);
+    if (projectionBatches.count(id)) {
+        delete projectionBatches[id];
+        projectionBatches.erase(id);
+    }
+}
+
+extern "C" void queueProjection(int id, const ProjectionTransform* t, const float* positions, int vertexCount, const unsigned* indices, int indexCount,
+    const float* uvs, int uvCount, float* outVerts, float* outUvt, int* outIndices, float* outDepth) {
+    std::lock_guard<std::mutex> lock(projectionMutex);
+    if (!projectionBatches.count(id))
+        return;
+    projectionBatches[id]->push_back({ *t, positions, vertexCount, indices, indexCount, uvs, uvCount, outVerts, outUvt, outIndices, outDepth });
+}
+
+// Projects every queued part and writes how many vertices each one produced into outCounts, in queue order.
+extern "C" void runProjectionBatch(int id, int* outCounts) {
+    std::vector<ProjectionJob>* jobs;
+    {
+        std::lock_guard<std::mutex> lock(projectionMutex);
+        if (!projectionBatches.count(id))
+            return;
+        jobs = projectionBatches[id];
+    }
+    WorkerPool::shared().parallelFor((int)jobs->size(), [jobs, outCounts](int i) {
+        const ProjectionJob& job = (*jobs)[i];
+        outCounts[i] = projectMeshPart(&job.transform, job.positions, job.vertexCount, job.indices, job.indexCount, job.uvs, job.uvCount,
+            job.outVerts, job.outUvt, job.outIndices, job.outDepth);
+    });
+    jobs->clear();
+}
+
+// Texels are stored as 0xAARRGGBB, straight alpha.
+struct RasterTexture {
+    int width = 0;
+    int height = 0;
+    std::vector<uint32_t> texels;
+    // whether any texel is partly transparent, see isRasterTextureTranslucent
+    bool translucent = false;
+};
+
+// Mirrors `nebulatracer.NebulaRasterizer.RasterBlend`.
+enum RasterBlend {
+    RASTER_BLEND_NORMAL = 0,
+    RASTER_BLEND_ADD = 1,
+    RASTER_BLEND_MULTIPLY = 2,
+    RASTER_BLEND_SCREEN = 3,
+    RASTER_BLEND_SUBTRACT = 4,
+    RASTER_BLEND_LIGHTEN = 5,
+    RASTER_BLEND_DARKEN = 6,
+    RASTER_BLEND_DIFFERENCE = 7
+};
+
+struct RasterTriangle {
+    float x[3], y[3];
+    float invW[3];
+    float uOverW[3], vOverW[3];
+    int minX, minY, maxX, maxY;
+    const RasterTexture* texture;
+    bool repeat, smooth;
+    // partly transparent texels are left to the blended pass
+    bool translucent;
+    int blend;
+    // mean 1/w, the blended pass draws the lowest (farthest) first
+    float sortDepth;
+};
+
+static const int RASTER_TILE_SIZE = 64;
+
+struct RasterInstance {
+    int width = 0;
+    int height = 0;
+    int tilesX = 0;
+    int tilesY = 0;
+    uint32_t clearColor = 0xFF000000;
+    std::vector<uint32_t> color;
+    std::vector<float> depth;
+    std::vector<RasterTriangle> triangles;
+    std::vector<std::vector<int>> bins;
+    // drawn after the opaque triangles, depth tested but without writing depth
+    std::vector<RasterTriangle> blended;
+    std::vector<int> blendOrder;
+    std::vector<std::vector<int>> blendedBins;
+};
+
+std::unordered_map<int, RasterInstance*> rasterizers;
+std::unordered_map<int, RasterTexture*> rasterTextures;
+std::mutex rasterMutex;
+int nextRasterizerID = 0;
+int nextTextureID = 0;
+
+// Same values as lime's PixelFormat
+enum PixelFormat { PIXEL_RGBA32 = 0, PIXEL_ARGB32 = 1, PIXEL_BGRA32 = 2 };
+
+static inline uint32_t loadPixel(const unsigned char* p, int format) {
+    switch (format) {
+        case PIXEL_ARGB32: return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+        case PIXEL_BGRA32: return ((uint32_t)p[3] << 24) | ((uint32_t)p[2] << 16) | ((uint32_t)p[1] << 8) | p[0];
+        default: return ((uint32_t)p[3] << 24) | ((uint32_t)p[0] << 16) | ((uint32_t)p[1] << 8) | p[2];
+    }
+}
+
+static inline void storePixel(unsigned char* p, uint32_t argb, int format) {
+    unsigned char a = argb >> 24, r = (argb >> 16) & 0xFF, g = (argb >> 8) & 0xFF, b = argb & 0xFF;
+    switch (format) {
+        case PIXEL_ARGB32: p[0] = a; p[1] = r; p[2] = g; p[3] = b; break;
+        case PIXEL_BGRA32: p[0] = b; p[1] = g; p[2] = r; p[3] = a; break;
+        default: p[0] = r; p[1] = g; p[2] = b; p[3] = a; break;
+    }
+}
+
+static inline int wrapTexel(int i, int size, bool repeat) {
+    if (repeat) {
+        i %= size;
+        return i < 0 ? i + size : i;
+    }
+    return i < 0 ? 0 : (i >= size ? size - 1 : i);
+}
+
+static inline uint32_t sampleTexture(const RasterTexture* tex, float u, float v, bool repeat, bool smooth) {
+    if (!tex || tex->texels.empty())
+        return 0xFFFFFFFF;
+    if (!smooth) {
+        int x = wrapTexel((int)floorf(u * tex->width), tex->width, repeat);
+        int y = wrapTexel((int)floorf(v * tex->height), tex->height, repeat);
+        return tex->texels[y * tex->width + x];
+    }
+
+    float fx = u * tex->width - 0.5f;
+    float fy = v * tex->height - 0.5f;
+    float floorX = floorf(fx), floorY = floorf(fy);
+    int tx = (int)((fx - floorX) * 256.0f), ty = (int)((fy - floorY) * 256.0f);
+    int x0 = wrapTexel((int)floorX, tex->width, repeat), x1 = wrapTexel((int)floorX + 1, tex->width, repeat);
+    int y0 = wrapTexel((int)floorY, tex->height, repeat), y1 = wrapTexel((int)floorY + 1, tex->height, repeat);
+    uint32_t c00 = tex->texels[y0 * tex->width + x0], c10 = tex->texels[y0 * tex->width + x1];
+    uint32_t c01 = tex->texels[y1 * tex->width + x0], c11 = tex->texels[y1 * tex->width + x1];
+
+    uint32_t result = 0;
+    for (int shift = 0; shift < 32; shift += 8) {
+        int top = (int)((c00 >> shift) & 0xFF) * (256 - tx) + (int)((c10 >> shift) & 0xFF) * tx;
+        int bottom = (int)((c01 >> shift) & 0xFF) * (256 - tx) + (int)((c11 >> shift) & 0xFF) * tx;
+        result |= (uint32_t)(((top * (256 - ty) + bottom * ty) >> 16) & 0xFF) << shift;
+    }
+    return result;
+}
+
+extern "C" int createRasterTexture(const unsigned char* pixels, int width, int height, int format, bool premultiplied) {
+    RasterTexture* tex = new RasterTexture();
+    tex->width = width;
+    tex->height = height;
+    tex->texels.resize((size_t)width * height);
+    for (int i = 0; i < width * height; ++i) {
+        uint32_t argb = loadPixel(pixels + i * 4, format);
+        uint32_t a = argb >> 24;
+        if (premultiplied && a > 0 && a < 255) {
+            uint32_t r = std::min(255u, ((argb >> 16) & 0xFF) * 255 / a);
+            uint32_t g = std::min(255u, ((argb >> 8) & 0xFF) * 255 / a);
+            uint32_t b = std::min(255u, (argb & 0xFF) * 255 / a);
+            argb = (a << 24) | (r << 16) | (g << 8) | b;
+        }
+        if (a > 0 && a < 255)
+            tex->translucent = true;
+        tex->texels[i] = argb;
+    }
+
+    std::lock_guard<std::mutex> lock(rasterMutex);
+    int id = nextTextureID++;
+    rasterTextures[id] = tex;
+    return id;
+}
+
+// Whether any texel in the rectangle is partly transparent. Parts drawn from it have to go through the blended pass,
+// asked per rectangle since an atlas page mixes opaque and translucent graphics.
+extern "C" bool isRasterTextureTranslucent(int id, int x, int y, int width, int height) {
+    std::lock_guard<std::mutex> lock(rasterMutex);
+    auto it = rasterTextures.find(id);
+    if (it == rasterTextures.end() || !it->second->translucent)
+        return false;
+    const RasterTexture* tex = it->second;
+    int x0 = std::max(0, x), y0 = std::max(0, y);
+    int x1 = std::min(tex->width, x + width), y1 = std::min(tex->height, y + height);
+    for (int ty = y0; ty < y1; ++ty)
+        for (int tx = x0; tx < x1; ++tx) {
+            uint32_t a = tex->texels[(size_t)ty * tex->width + tx] >> 24;
+            if (a > 0 && a < 255)
+                return true;
+        }
+    return false;
+}
+
+extern "C" void disposeRasterTexture(int id) {
+    std::lock_guard<std::mutex> lock(rasterMutex);
+    if (rasterTextures.count(id)) {
+        delete rasterTextures[id];
+        rasterTextures.erase(id);
+    }
+}
+
+extern "C" int createRasterizer() {
+    std::lock_guard<std::mutex> lock(rasterMutex);
+    int id = nextRasterizerID++;
+    rasterizers[id] = new RasterInstance();
+    return id;
+}
+
+extern "C" void disposeRasterizer(int id) {
+    std::lock_guard<std::mutex> lock(rasterMutex);
+    if (rasterizers.count(id)) {
+        delete rasterizers[id];
+        rasterizers.erase(id);
+    }
+}
+
+extern "C" void beginRaster(int id, int width, int height, uint32_t clearColor) {
+    std::lock_guard<std::mutex> lock(rasterMutex);
+    if (!rasterizers.count(id))
+        return;
+    RasterInstance* r = rasterizers[id];
+    if (r->width != width || r->height != height) {
+        r->width = width;
+        r->height = height;
+        r->tilesX = (width + RASTER_TILE_SIZE - 1) / RASTER_TILE_SIZE;
+        r->tilesY = (height + RASTER_TILE_SIZE - 1) / RASTER_TILE_SIZE;
+        r->color.assign((size_t)width * height, clearColor);
+        r->depth.assign((size_t)width * height, 0.0f);
+        r->bins.assign((size_t)r->tilesX * r->tilesY, std::vector<int>());
+        r->blendedBins.assign((size_t)r->tilesX * r->tilesY, std::vector<int>());
+    }
+    r->clearColor = clearColor;
+    r->triangles.clear();
+    r->blended.clear();
+}
+
+// Adds the output of projectMeshPart (an unindexed triangle list) to the frame.
+// Parts with a blend mode other than normal only go through the blended pass, `translucent` ones with the normal mode
+// go through both: opaque texels write depth like any other part, the partly transparent ones are blended afterwards.
+extern "C" void submitRaster(int id, const float* verts, const float* depth, const float* uvt, int vertexCount, int textureID, bool repeat, bool smooth,
+    int blend, bool translucent, float offsetX, float offsetY) {
+    std::lock_guard<std::mutex> lock(rasterMutex);
+    if (!rasterizers.count(id))
+        return;
+    RasterInstance* r = rasterizers[id];
+    const RasterTexture* texture = rasterTextures.count(textureID) ? rasterTextures[textureID] : nullptr;
+
+    for (int v = 0; v + 2 < vertexCount; v += 3) {
+        RasterTriangle t;
+        for (int i = 0; i < 3; ++i) {
+            t.x[i] = verts[(v + i) * 2] + offsetX;
+            t.y[i] = verts[(v + i) * 2 + 1] + offsetY;
+            t.invW[i] = depth[v + i];
+            t.uOverW[i] = uvt[(v + i) * 3] * t.invW[i];
+            t.vOverW[i] = uvt[(v + i) * 3 + 1] * t.invW[i];
+        }
+        float area = (t.x[1] - t.x[0]) * (t.y[2] - t.y[0]) - (t.x[2] - t.x[0]) * (t.y[1] - t.y[0]);
+        if (fabsf(area) < 1e-6f)
+            continue;
+
+        t.minX = std::max(0, (int)floorf(std::min({ t.x[0], t.x[1], t.x[2] })));
+        t.minY = std::max(0, (int)floorf(std::min({ t.y[0], t.y[1], t.y[2] })));
+        t.maxX = std::min(r->width - 1, (int)ceilf(std::max({ t.x[0], t.x[1], t.x[2] })));
+        t.maxY = std::min(r->height - 1, (int)ceilf(std::max({ t.y[0], t.y[1], t.y[2] })));
+        if (t.minX > t.maxX || t.minY > t.maxY)
+            continue;
+
+        t.texture = texture;
+        t.repeat = repeat;
+        t.smooth = smooth;
+        t.translucent = translucent;
+        t.blend = blend;
+        t.sortDepth = (t.invW[0] + t.invW[1] + t.invW[2]) / 3.0f;
+        if (blend == RASTER_BLEND_NORMAL)
+            r->triangles.push_back(t);
+        if (blend != RASTER_BLEND_NORMAL || translucent)
+            r->blended.push_back(t);
+    }
+}
+
+// Blends a straight alpha texel over an opaque pixel, both 0xAARRGGBB.
+static inline uint32_t blendPixel(uint32_t dst, uint32_t src, int blend) {
+    int alpha = (int)(src >> 24);
+    uint32_t result = 0xFF000000;
+    for (int shift = 0; shift < 24; shift += 8) {
+        int s = (int)((src >> shift) & 0xFF), d = (int)((dst >> shift) & 0xFF), c;
+        switch (blend) {
+            case RASTER_BLEND_ADD: c = std::min(255, d + s); break;
+            case RASTER_BLEND_MULTIPLY: c = s * d / 255; break;
+            case RASTER_BLEND_SCREEN: c = 255 - (255 - s) * (255 - d) / 255; break;
+            case RASTER_BLEND_SUBTRACT: c = std::max(0, d - s); break;
+            case RASTER_BLEND_LIGHTEN: c = std::max(s, d); break;
+            case RASTER_BLEND_DARKEN: c = std::min(s, d); break;
+            case RASTER_BLEND_DIFFERENCE: c = abs(d - s); break;
+            default: c = s; break;
+        }
+        result |= (uint32_t)((d * (255 - alpha) + c * alpha + 127) / 255) << shift;
+    }
+    return result;
+}
+
+static void rasterizeTriangle(RasterInstance* r, const RasterTriangle& t, int tileX0, int tileY0, int tileX1, int tileY1, bool blendPass) {
+    int minX = std::max(t.minX, tileX0), maxX = std::min(t.maxX, tileX1 - 1);
+    int minY = std::max(t.minY, tileY0), maxY = std::min(t.maxY, tileY1 - 1);
+    if (minX > maxX || minY > maxY)
+        return;
+
+    // edge i is opposite to vertex i, so its value is the (unnormalized) barycentric weight of vertex i
+    float a[3], b[3], c[3];
+    for (int i = 0; i < 3; ++i) {
+        int j = (i + 1) % 3, k = (i + 2) % 3;
+        a[i] = t.y[j] - t.y[k];
+        b[i] = t.x[k] - t.x[j];
+        c[i] = t.x[j] * t.y[k] - t.x[k] * t.y[j];
+    }
+    float area = (t.x[1] - t.x[0]) * (t.y[2] - t.y[0]) - (t.x[2] - t.x[0]) * (t.y[1] - t.y[0]);
+    float sign = area < 0.0f ? -1.0f : 1.0f;
+    float invArea = 1.0f / fabsf(area);
+    for (int i = 0; i < 3; ++i) {
+        a[i] *= sign * invArea;
+        b[i] *= sign * invArea;
+        c[i] *= sign * invArea;
+    }
+
+    const __m128 laneOffsets = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+    const __m128 zero = _mm_setzero_ps();
+    __m128 stepA[3], va[3];
+    for (int i = 0; i < 3; ++i) {
+        va[i] = _mm_set1_ps(a[i]);
+        stepA[i] = _mm_set1_ps(a[i] * 4.0f);
+    }
+
+    alignas(16) float l[3][4];
+    for (int y = minY; y <= maxY; ++y) {
+        float py = y + 0.5f;
+        __m128 px = _mm_add_ps(_mm_set1_ps((float)minX), laneOffsets);
+        __m128 e[3];
+        for (int i = 0; i < 3; ++i)
+            e[i] = _mm_add_ps(_mm_mul_ps(va[i], px), _mm_set1_ps(b[i] * py + c[i]));
+
+        for (int x = minX; x <= maxX; x += 4) {
+            __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(e[0], zero), _mm_cmpge_ps(e[1], zero)), _mm_cmpge_ps(e[2], zero));
+            int mask = _mm_movemask_ps(inside);
+            if (maxX - x < 3)
+                mask &= (1 << (maxX - x + 1)) - 1;
+            if (mask) {
+                for (int i = 0; i < 3; ++i)
+                    _mm_store_ps(l[i], e[i]);
+                for (int lane = 0; lane < 4; ++lane) {
+                    if (!(mask & (1 << lane)))
+                        continue;
+                    float l0 = l[0][lane], l1 = l[1][lane], l2 = l[2][lane];
+                    float invW = l0 * t.invW[0] + l1 * t.invW[1] + l2 * t.invW[2];
+                    size_t index = (size_t)y * r->width + x + lane;
+                    if (invW <= r->depth[index])
+                        continue;
+                    float w = 1.0f / invW;
+                    float u = (l0 * t.uOverW[0] + l1 * t.uOverW[1] + l2 * t.uOverW[2]) * w;
+                    float v = (l0 * t.vOverW[0] + l1 * t.vOverW[1] + l2 * t.vOverW[2]) * w;
+                    uint32_t texel = sampleTexture(t.texture, u, v, t.repeat, t.smooth);
+                    uint32_t alpha = texel >> 24;
+                    if (alpha == 0)
+                        continue;
+                    if (blendPass) {
+                        // opaque texels of normal blended parts were drawn by the opaque pass
+                        if (t.blend == RASTER_BLEND_NORMAL && alpha == 255)
+                            continue;
+                        r->color[index] = blendPixel(r->color[index], texel, t.blend);
+                        continue;
+                    }
+                    if (t.translucent && alpha < 255)
+                        continue;
+                    r->depth[index] = invW;
+                    r->color[index] = texel | 0xFF000000;
+                }
+            }
+            for (int i = 0; i < 3; ++i)
+                e[i] = _mm_add_ps(e[i], stepA[i]);
+        }
+    }
+}
+
+// Bins the submitted triangles into screen tiles, rasterizes the tiles across the worker pool
+// and writes the frame into `out` (width * height pixels in `format`).
+// Every tile draws its opaque triangles first, then its blended ones back to front against the finished depth.
+extern "C" void finishRaster(int id, unsigned char* out, int format) {
+    std::lock_guard<std::mutex> lock(rasterMutex);
+    if (!rasterizers.count(id))
+        return;
+    RasterInstance* r = rasterizers[id];
+
+    for (std::vector<int>& bin : r->bins)
+        bin.clear();
+    for (int i = 0; i < (int)r->triangles.size(); ++i) {
+        const RasterTriangle& t = r->triangles[i];
+        for (int ty = t.minY / RASTER_TILE_SIZE; ty <= t.maxY / RASTER_TILE_SIZE; ++ty)
+            for (int tx = t.minX / RASTER_TILE_SIZE; tx <= t.maxX / RASTER_TILE_SIZE; ++tx)
+                r->bins[ty * r->tilesX + tx].push_back(i);
+    }
+
+    // sorted per triangle so parts crossing each other still blend in order, ties keep the submission order
+    r->blendOrder.resize(r->blended.size());
+    for (int i = 0; i < (int)r->blended.size(); ++i)
+        r->blendOrder[i] = i;
+    std::stable_sort(r->blendOrder.begin(), r->blendOrder.end(),
+        [r](int a, int b) { return r->blended[a].sortDepth < r->blended[b].sortDepth; });
+    for (std::vector<int>& bin : r->blendedBins)
+        bin.clear();
+    for (int i : r->blendOrder) {
+        const RasterTriangle& t = r->blended[i];
+        for (int ty = t.minY / RASTER_TILE_SIZE; ty <= t.maxY / RASTER_TILE_SIZE; ++ty)
+            for (int tx = t.minX / RASTER_TILE_SIZE; tx <= t.maxX / RASTER_TILE_SIZE; ++tx)
+                r->blendedBins[ty * r->tilesX + tx].push_back(i);
+    }
+
+    WorkerPool::shared().parallelFor(r->tilesX * r->tilesY, [r, out, format](int tile) {
+        int x0 = (tile % r->tilesX) * RASTER_TILE_SIZE, y0 = (tile / r->tilesX) * RASTER_TILE_SIZE;
+        int x1 = std::min(x0 + RASTER_TILE_SIZE, r->width), y1 = std::min(y0 + RASTER_TILE_SIZE, r->height);
+        for (int y = y0; y < y1; ++y) {
+            std::fill(&r->color[(size_t)y * r->width + x0], &r->color[(size_t)y * r->width + x1], r->clearColor);
+            std::fill(&r->depth[(size_t)y * r->width + x0], &r->depth[(size_t)y * r->width + x1], 0.0f);
+        }
+
+        // triangles keep their submission order within a tile, so equal depths resolve the same way every frame
+        for (int index : r->bins[tile])
+            rasterizeTriangle(r, r->triangles[index], x0, y0, x1, y1, false);
+        for (int index : r->blendedBins[tile])
+            rasterizeTriangle(r, r->blended[index], x0, y0, x1, y1, true);
+
+        if (out)
+            for (int y = y0; y < y1; ++y)
+                for (int x = x0; x < x1; ++x)
+                    storePixel(out + ((size_t)y * r->width + x) * 4, r->color[(size_t)y * r->width + x], format);
+    });
+}
+
+//--------- Framebuffer ---------//
+// Float32 HDR accumulation buffer for the raytracers. Samples are added per pixel and the image shown is their running mean,
+// so every sample traced since the last reset improves the picture.
+// Convergence is tracked per tile of FRAMEBUFFER_TILE pixels squared.
+static const int FRAMEBUFFER_TILE = 16;
+
+struct FramebufferInstance {
+    int width = 0;
+    int height = 0;
+    // r, g, b and luminance squared sums, 16 bytes per pixel
+    std::vector<float> sum;
+    std::vector<uint32_t> count;
+    std::atomic<uint64_t> totalSamples{ 0 };
+    int tilesX = 0;
+    int tilesY = 0;
+    // feature buffers guiding the denoiser: albedo rgb, normal xyz, depth and padding sums, with their own counts
+    std::vector<float> features;
+    std::vector<uint32_t> featureCount;
+    // geomID of the last primary hit (-1 for none), and whether the pixel only holds reprojected history so far
+    std::vector<int> geomIDs;
+    std::vector<uint8_t> history;
+};
+
+static inline float luminance(float r, float g, float b) {
+    return 0.2126f * r + 0.7152f * g + 0.0722f * b;
+}
+
+std::unordered_map<int, FramebufferInstance*> framebuffers;
+std::mutex framebufferMutex;
+int nextFramebufferID = 0;
+
+static FramebufferInstance* getFramebuffer(int id) {
+    std::lock_guard<std::mutex> lock(framebufferMutex);
+    auto it = framebuffers.find(id);
+    return it == framebuffers.end() ? nullptr : it->second;
+}
+
+// Clears every sample, also used to resize.
+extern "C" void resetFramebuffer(int id, int width, int height) {
+    FramebufferInstance* fb = getFramebuffer(id);
+    if (!fb)
+        return;
+    fb->width = width;
+    fb->height = height;
+    fb->sum.assign((size_t)width * height * 4, 0.0f);
+    fb->count.assign((size_t)width * height, 0);
+    fb->totalSamples = 0;
+    fb->features.assign((size_t)width * height * 8, 0.0f);
+    fb->featureCount.assign((size_t)width * height, 0);
+    fb->geomIDs.assign((size_t)width * height, -1);
+    fb->history.assign((size_t)width * height, 0);
+    fb->tilesX = (width + FRAMEBUFFER_TILE - 1) / FRAMEBUFFER_TILE;
+    fb->tilesY = (height + FRAMEBUFFER_TILE - 1) / FRAMEBUFFER_TILE;
+}
+
+extern "C" int createFramebuffer(int width, int height) {
+    int id;
+    {
+        std::lock_guard<std::mutex> lock(framebufferMutex);
+        id = nextFramebufferID++;
+        framebuffers[id] = new FramebufferInstance();
+    }
+    resetFramebuffer(id, width, height);
+    return id;
+}
+
+extern "C" void disposeFramebuffer(int id) {
+    std::lock_guard<std::mutex> lock(framebufferMutex);
+    auto it = framebuffers.find(id);
+    if (it != framebuffers.end()) {
+        delete it->second;
+        framebuffers.erase(it);
+    }
+}
+
+// Pixels are never locked, two threads must not add to the same pixel at once (tiles never overlap).
+extern "C" void addFramebufferSample(int id, int x, int y, float r, float g, float b) {
+    FramebufferInstance* fb = getFramebuffer(id);
+    if (!fb || x < 0 || y < 0 || x >= fb->width || y >= fb->height)
+        return;
+    size_t pixel = (size_t)y * fb->width + x;
+    float* sum = &fb->sum[pixel * 4];
+    sum[0] += r;
+    sum[1] += g;
+    sum[2] += b;
+    float l = luminance(r, g, b);
+    sum[3] += l * l;
+    fb->count[pixel]++;
+    fb->totalSamples++;
+}
+
+static void clearFramebufferPixel(FramebufferInstance* fb, size_t pixel) {
+    fb->totalSamples -= fb->count[pixel];
+    memset(&fb->sum[pixel * 4], 0, 16);
+    memset(&fb->features[pixel * 8], 0, 32);
+    fb->count[pixel] = 0;
+    fb->featureCount[pixel] = 0;
+}
+
+// Adds what the primary ray hit to the denoiser's feature buffers. Misses should pass an albedo of 1, a zero normal and a geomID of -1.
+// Add them before the sample: a pixel holding reprojected history drops it here if the first fresh hit is another geometry.
+extern "C" void addFramebufferFeatures(int id, int x, int y, float albedoR, float albedoG, float albedoB, float normalX, float normalY,
+    float normalZ, float depth, int geomID) {
+    FramebufferInstance* fb = getFramebuffer(id);
+    if (!fb || x < 0 || y < 0 || x >= fb->width || y >= fb->height)
+        return;
+    size_t pixel = (size_t)y * fb->width + x;
+    if (fb->history[pixel]) {
+        if (fb->geomIDs[pixel] != geomID)
+            clearFramebufferPixel(fb, pixel);
+        fb->history[pixel] = 0;
+    }
+    fb->geomIDs[pixel] = geomID;
+    float* f = &fb->features[pixel * 8];
+    f[0] += albedoR;
+    f[1] += albedoG;
+    f[2] += albedoB;
+    f[3] += normalX;
+    f[4] += normalY;
+    f[5] += normalZ;
+    f[6] += depth;
+    fb->featureCount[pixel]++;
+}
+
+extern "C" int getFramebufferSampleCount(int id, int x, int y) {
+    FramebufferInstance* fb = getFramebuffer(id);
+    if (!fb || x < 0 || y < 0 || x >= fb->width || y >= fb->height)
+        return 0;
+    return (int)fb->count[(size_t)y * fb->width + x];
+}
+
+// Estimates how noisy every tile still is and how many samples per pixel it should get next.
+// A pixel's error is the standard error of its mean luminance relative to the mean, a tile's error is its worst pixel's.
+// Tiles at or under targetError with at least minSamples in every sampled pixel are converged and get 0,
+// the others get between 1 and maxSamples depending on how far off they are.
+// Only pixels on the `stride` grid are traced (every pixel with 1), one of those without samples keeps its tile at 1.
+// outTileSamples gets one byte per tile, row by row. Returns how many tiles converged.
+extern "C" int updateFramebufferConvergence(int id, float targetError, int minSamples, int maxSamples, int stride,
+    unsigned char* outTileSamples) {
+    FramebufferInstance* fb = getFramebuffer(id);
+    if (!fb)
+        return 0;
+    minSamples = std::max(minSamples, 2);
+    maxSamples = std::clamp(maxSamples, 1, 255);
+    stride = std::max(stride, 1);
+    std::atomic<int> converged{ 0 };
+    WorkerPool::shared().parallelFor(fb->tilesX * fb->tilesY, [&](int tile) {
+        int startX = (tile % fb->tilesX) * FRAMEBUFFER_TILE;
+        int startY = (tile / fb->tilesX) * FRAMEBUFFER_TILE;
+        int endX = std::min(startX + FRAMEBUFFER_TILE, fb->width);
+        int endY = std::min(startY + FRAMEBUFFER_TILE, fb->height);
+        bool sampled = false, tooFew = false;
+        float worst = 0.0f;
+        for (int y = startY; y < endY; ++y) {
+            for (int x = startX; x < endX; ++x) {
+                size_t pixel = (size_t)y * fb->width + x;
+                uint32_t n = fb->count[pixel];
+                // pixels off the grid may still have samples from an earlier pass, they count but aren't required
+                if (n == 0) {
+                    tooFew = tooFew || (x % stride == 0 && y % stride == 0);
+                    continue;
+                }
+                sampled = true;
+                if (n < (uint32_t)minSamples) {
+                    tooFew = true;
+                    continue;
+                }
+                const float* sum = &fb->sum[pixel * 4];
+                float mean = luminance(sum[0], sum[1], sum[2]) / n;
+                float variance = std::max(0.0f, sum[3] / n - mean * mean) * n / (n - 1);
+                // dark pixels get an absolute floor, their relative error is meaningless
+                float error = sqrtf(variance / n) / std::max(mean, 0.05f);
+                worst = std::max(worst, error);
+            }
+        }
+        int samples;
+        if (!sampled || tooFew)
+            samples = 1;
+        else if (worst <= targetError)
+            samples = 0;
+        else
+            samples = std::clamp((int)ceilf(worst / targetError), 1, maxSamples);
+        outTileSamples[tile] = (unsigned char)samples;
+        if (samples == 0)
+            converged++;
+    });
+    return converged;
+}
+
+// Rebuilds the pixels without samples from a tent weighted average of the sampled ones within `radius`,
+// so a sparse frame looks smooth instead of blocky. Done separably, rows then columns, on the sample means.
+// Pixels with nothing sampled in reach keep what `out` already had.
+static void fillSparsePixels(FramebufferInstance* fb, float* out, int radius) {
+    int width = fb->width, height = fb->height;
+    // per pixel r, g, b and weight of the horizontal pass
+    std::vector<float> rows((size_t)width * height * 4);
+    WorkerPool& pool = WorkerPool::shared();
+    pool.parallelFor(height, [&](int y) {
+        const float* sum = &fb->sum[(size_t)y * width * 4];
+        const uint32_t* count = &fb->count[(size_t)y * width];
+        float* dst = &rows[(size_t)y * width * 4];
+        for (int x = 0; x < width; ++x) {
+            float r = 0, g = 0, b = 0, weight = 0;
+            for (int sx = std::max(0, x - radius); sx <= std::min(width - 1, x + radius); ++sx) {
+                if (count[sx] == 0)
+                    continue;
+                float w = (float)(radius + 1 - std::abs(sx - x)) / count[sx];
+                r += sum[sx * 4] * w;
+                g += sum[sx * 4 + 1] * w;
+                b += sum[sx * 4 + 2] * w;
+                weight += radius + 1 - std::abs(sx - x);
+            }
+            dst[x * 4] = r;
+            dst[x * 4 + 1] = g;
+            dst[x * 4 + 2] = b;
+            dst[x * 4 + 3] = weight;
+        }
+    });
+    pool.parallelFor(height, [&](int y) {
+        const uint32_t* count = &fb->count[(size_t)y * width];
+        float* row = &out[(size_t)y * width * 3];
+        for (int x = 0; x < width; ++x) {
+            if (count[x] > 0)
+                continue;
+            float r = 0, g = 0, b = 0, weight = 0;
+            for (int sy = std::max(0, y - radius); sy <= std::min(height - 1, y + radius); ++sy) {
+                const float* src = &rows[((size_t)sy * width + x) * 4];
+                float w = (float)(radius + 1 - std::abs(sy - y));
+                r += src[0] * w;
+                g += src[1] * w;
+                b += src[2] * w;
+                weight += src[3] * w;
+            }
+            if (weight > 0) {
+                row[x * 3] = r / weight;
+                row[x * 3 + 1] = g / weight;
+                row[x * 3 + 2] = b / weight;
+            }
+        }
+    });
+}
+
+// Writes the mean of every pixel into out as float32 r, g, b. Pixels without samples yet take the nearest sampled pixel
+// on their row (or the nearest row that has any), so sparse passes still fill the screen.
+// `fillRadius` above 0 first rebuilds them from the samples around them (see fillSparsePixels).
+// Returns how many samples the buffer holds in total.
+extern "C" double resolveFramebuffer(int id, float* out, int fillRadius) {
+    FramebufferInstance* fb = getFramebuffer(id);
+    if (!fb)
+        return 0;
+    int width = fb->width, height = fb->height;
+    std::vector<char> rowSampled(height, 0);
+
+    WorkerPool::shared().parallelFor(height, [&](int y) {
+        const float* sum = &fb->sum[(size_t)y * width * 4];
+        const uint32_t* count = &fb->count[(size_t)y * width];
+        float* row = &out[(size_t)y * width * 3];
+        int last = -1;
+        for (int x = 0; x < width; ++x) {
+            if (count[x] > 0) {
+                float scale = 1.0f / count[x];
+                row[x * 3] = sum[x * 4] * scale;
+                row[x * 3 + 1] = sum[x * 4 + 1] * scale;
+                row[x * 3 + 2] = sum[x * 4 + 2] * scale;
+                if (last < 0)
+                    for (int before = 0; before < x; ++before)
+                        memcpy(&row[before * 3], &row[x * 3], 12);
+                last = x;
+            } else if (last >= 0) {
+                memcpy(&row[x * 3], &row[last * 3], 12);
+            }
+        }
+        rowSampled[y] = last >= 0;
+    });
+
+    int previous = -1;
+    for (int y = 0; y < height; ++y) {
+        if (rowSampled[y]) {
+            previous = y;
+            continue;
+        }
+        int next = y + 1;
+        while (next < height && !rowSampled[next])
+            next++;
+        int source = previous < 0 ? (next < height ? next : -1) : (next < height && next - y < y - previous ? next : previous);
+        float* row = &out[(size_t)y * width * 3];
+        if (source < 0)
+            memset(row, 0, (size_t)width * 12);
+        else
+            memcpy(row, &out[(size_t)source * width * 3], (size_t)width * 12);
+    }
+    if (fillRadius > 0 && previous >= 0)
+        fillSparsePixels(fb, out, fillRadius);
+    return (double)fb->totalSamples;
+}
+
+//--------- Temporal reprojection ---------//
+// Keeps what a moving camera can still see. Every pixel with a primary hit is put back in the world from its mean depth,
+// projected into the new camera and splatted there, the nearest one wins. Surfaces that now face away are dropped,
+// and the first fresh hit of another geometry drops a pixel's history (see addFramebufferFeatures).
+// Only disoccluded pixels start over, the rest keep up to maxHistory samples that fresh ones blend with.
+
+// A camera the way CPURaytracer.pixelToWorld builds its rays: x, y, z, yaw, pitch (radians) and vertical fov (degrees).
+struct FramebufferCamera {
+    float x, y, z, yaw, pitch, fov;
+};
+
+static inline void cameraRay(const FramebufferCamera& c, int width, int height, int px, int py, float* dir) {
+    float tanFov = tanf(c.fov * 3.14159265f / 360.0f);
+    float dx = ((2.0f * px) / width - 1) * ((float)width / height) * tanFov;
+    float dy = ((2.0f * py) / height - 1) * tanFov;
+    float dz = -1;
+    float length = sqrtf(dx * dx + dy * dy + dz * dz);
+    dx /= length;
+    dy /= length;
+    dz /= length;
+    float cosPitch = cosf(c.pitch), sinPitch = sinf(c.pitch);
+    float y1 = dy * cosPitch - dz * sinPitch;
+    float z1 = dy * sinPitch + dz * cosPitch;
+    float cosYaw = cosf(c.yaw), sinYaw = sinf(c.yaw);
+    dir[0] = dx * cosYaw - z1 * sinYaw;
+    dir[1] = y1;
+    dir[2] = dx * sinYaw + z1 * cosYaw;
+}
+
+// The inverse of cameraRay, false if the point is behind the camera.
+static inline bool projectToCamera(const FramebufferCamera& c, int width, int height, const float* p, float& px, float& py, float& distance) {
+    float vx = p[0] - c.x, vy = p[1] - c.y, vz = p[2] - c.z;
+    distance = sqrtf(vx * vx + vy * vy + vz * vz);
+    float cosYaw = cosf(c.yaw), sinYaw = sinf(c.yaw);
+    float x1 = vx * cosYaw + vz * sinYaw;
+    float z1 = -vx * sinYaw + vz * cosYaw;
+    float cosPitch = cosf(c.pitch), sinPitch = sinf(c.pitch);
+    float dy = vy * cosPitch + z1 * sinPitch;
+    float dz = -vy * sinPitch + z1 * cosPitch;
+    if (dz >= -1e-6f)
+        return false;
+    float tanFov = tanf(c.fov * 3.14159265f / 360.0f);
+    px = ((x1 / -dz) / (((float)width / height) * tanFov) + 1) * width * 0.5f;
+    py = ((dy / -dz) / tanFov + 1) * height * 0.5f;
+    return true;
+}
+
+// `fromCamera` is what the framebuffer's samples were traced with, `toCamera` the new one (6 floats each, see FramebufferCamera).
+// Returns how many pixels kept their history.
+extern "C" int reprojectFramebuffer(int id, const float* fromCamera, const float* toCamera, int maxHistory) {
+    FramebufferInstance* fb = getFramebuffer(id);
+    if (!fb || maxHistory <= 0)
+        return 0;
+    FramebufferCamera from, to;
+    memcpy(&from, fromCamera, sizeof(FramebufferCamera));
+    memcpy(&to, toCamera, sizeof(FramebufferCamera));
+    int width = fb->width, height = fb->height;
+    size_t pixels = (size_t)width * height;
+
+    std::vector<float> sum = std::move(fb->sum), features = std::move(fb->features);
+    std::vector<uint32_t> count = std::move(fb->count), featureCount = std::move(fb->featureCount);
+    std::vector<int> geomIDs = std::move(fb->geomIDs);
+    resetFramebuffer(id, width, height);
+
+    // depth bits over the source pixel, positive floats sort the same as their bits
+    std::vector<std::atomic<uint64_t>> nearest(pixels);
+    WorkerPool& pool = WorkerPool::shared();
+    pool.parallelFor(height, [&](int y) {
+        for (int x = 0; x < width; ++x)
+            nearest[(size_t)y * width + x].store(UINT64_MAX, std::memory_order_relaxed);
+    });
+    pool.parallelFor(height, [&](int y) {
+        for (int x = 0; x < width; ++x) {
+            size_t source = (size_t)y * width + x;
+            uint32_t n = featureCount[source];
+            const float* f = &features[source * 8];
+            if (count[source] == 0 || n == 0 || geomIDs[source] < 0)
+                continue;
+            float dir[3], p[3];
+            cameraRay(from, width, height, x, y, dir);
+            float depth = f[6] / n;
+            for (int i = 0; i < 3; ++i)
+                p[i] = (&from.x)[i] + dir[i] * depth;
+            // normals aren't normalized, only the sign matters
+            if (f[3] * (p[0] - to.x) + f[4] * (p[1] - to.y) + f[5] * (p[2] - to.z) >= 0)
+                continue;
+            float px, py, distance;
+            if (!projectToCamera(to, width, height, p, px, py, distance))
+                continue;
+            int tx = (int)floorf(px + 0.5f), ty = (int)floorf(py + 0.5f);
+            if (tx < 0 || ty < 0 || tx >= width || ty >= height)
+                continue;
+            uint32_t bits;
+            memcpy(&bits, &distance, 4);
+            uint64_t key = ((uint64_t)bits << 32) | (uint32_t)source;
+            std::atomic<uint64_t>& slot = nearest[(size_t)ty * width + tx];
+            uint64_t current = slot.load(std::memory_order_relaxed);
+            while (key < current && !slot.compare_exchange_weak(current, key, std::memory_order_relaxed)) {
+            }
+        }
+    });
+
+    std::atomic<int> kept{ 0 };
+    std::atomic<uint64_t> samples{ 0 };
+    pool.parallelFor(height, [&](int y) {
+        int rowKept = 0;
+        uint64_t rowSamples = 0;
+        for (int x = 0; x < width; ++x) {
+            size_t target = (size_t)y * width + x;
+            uint64_t key = nearest[target].load(std::memory_order_relaxed);
+            if (key == UINT64_MAX)
+                continue;
+            size_t source = (size_t)(key & 0xFFFFFFFFu);
+            uint32_t bits = (uint32_t)(key >> 32);
+            float distance;
+            memcpy(&distance, &bits, 4);
+
+            uint32_t n = std::min(count[source], (uint32_t)maxHistory);
+            float scale = (float)n / count[source];
+            for (int i = 0; i < 4; ++i)
+                fb->sum[target * 4 + i] = sum[source * 4 + i] * scale;
+            fb->count[target] = n;
+            float featureScale = 1.0f / featureCount[source];
+            for (int i = 0; i < 6; ++i)
+                fb->features[target * 8 + i] = features[source * 8 + i] * featureScale;
+            fb->features[target * 8 + 6] = distance;
+            fb->featureCount[target] = 1;
+            fb->geomIDs[target] = geomIDs[source];
+            fb->history[target] = 1;
+            rowKept++;
+            rowSamples += n;
+        }
+        kept += rowKept;
+        samples += rowSamples;
+    });
+    fb->totalSamples = samples.load();
+    return kept;
+}
+
+//--------- Denoiser ---------//
+// Cleans up the resolved framebuffer. The built in filter is an edge avoiding à-trous wavelet filter in the spirit of SVGF:
+// lighting is divided by the albedo so textures stay sharp, then filtered with a 5x5 B3 spline at growing strides,
+// with weights from luminance (scaled by the pixel's estimated noise), normals and depth. Its variance is filtered along.
+// Intel Open Image Denoise is used instead when nebulatracer is built with NEBULATRACER_OIDN (and linked against it).
+#ifdef NEBULATRACER_OIDN
+#include <OpenImageDenoise/oidn.h>
+#endif
+
+static const int DENOISER_NONE = 0;
+static const int DENOISER_ATROUS = 1;
+static const int DENOISER_OIDN = 2;
+
+extern "C" bool isDenoiserAvailable(int mode) {
+#ifdef NEBULATRACER_OIDN
+    return mode >= DENOISER_NONE && mode <= DENOISER_OIDN;
+#else
+    return mode == DENOISER_NONE || mode == DENOISER_ATROUS;
+#endif
+}
+
+#ifdef NEBULATRACER_OIDN
+static bool denoiseOIDN(const float* color, const float* albedo, const float* normal, float* out, int width, int height) {
+    static OIDNDevice device = nullptr;
+    static std::mutex deviceMutex;
+    std::lock_guard<std::mutex> lock(deviceMutex);
+    if (!device) {
+        device = oidnNewDevice(OIDN_DEVICE_TYPE_CPU);
+        oidnCommitDevice(device);
+    }
+    OIDNFilter filter = oidnNewFilter(device, "RT");
+    oidnSetSharedFilterImage(filter, "color", (void*)color, OIDN_FORMAT_FLOAT3, width, height, 0, 0, 0);
+    oidnSetSharedFilterImage(filter, "albedo", (void*)albedo, OIDN_FORMAT_FLOAT3, width, height, 0, 0, 0);
+    oidnSetSharedFilterImage(filter, "normal", (void*)normal, OIDN_FORMAT_FLOAT3, width, height, 0, 0, 0);
+    oidnSetSharedFilterImage(filter, "output", out, OIDN_FORMAT_FLOAT3, width, height, 0, 0, 0);
+    oidnSetFilterBool(filter, "hdr", true);
+    oidnCommitFilter(filter);
+    oidnExecuteFilter(filter);
+    const char* message;
+    bool ok = oidnGetDeviceError(device, &message) == OIDN_ERROR_NONE;
+    oidnReleaseFilter(filter);
+    return ok;
+}
+#endif
+
+// Denoises `color` (float32 r, g, b per pixel, as written by resolveFramebuffer) into `out`, which may not be `color`.
+// Returns the mode that actually ran, OIDN falls back to à-trous when it isn't built in.
+extern "C" int denoiseFramebuffer(int id, const float* color, float* out, int mode, int iterations, float sigmaColor, float sigmaNormal,
+    float sigmaDepth) {
+    FramebufferInstance* fb = getFramebuffer(id);
+    if (!fb)
+        return DENOISER_NONE;
+    int width = fb->width, height = fb->height;
+    size_t pixels = (size_t)width * height;
+    if (mode == DENOISER_NONE || pixels == 0) {
+        memcpy(out, color, pixels * 12);
+        return DENOISER_NONE;
+    }
+    WorkerPool& pool = WorkerPool::shared();
+
+    // resolve the features, pixels without any (not traced yet) or that hit nothing get an albedo of 1, no normal and no depth
+    enum : uint8_t { UNKNOWN, MISS, SURFACE };
+    std::vector<float> albedo(pixels * 3, 1.0f), normal(pixels * 3, 0.0f), depth(pixels, 0.0f);
+    std::vector<uint8_t> kind(pixels, UNKNOWN);
+    pool.parallelFor(height, [&](int y) {
+        for (int x = 0; x < width; ++x) {
+            size_t p = (size_t)y * width + x;
+            uint32_t n = fb->featureCount[p];
+            if (n == 0)
+                continue;
+            const float* f = &fb->features[p * 8];
+            float scale = 1.0f / n;
+            for (int i = 0; i < 3; ++i)
+                albedo[p * 3 + i] = f[i] * scale;
+            float nx = f[3], ny = f[4], nz = f[5];
+            float length = sqrtf(nx * nx + ny * ny + nz * nz);
+            kind[p] = length > 0 ? SURFACE : MISS;
+            if (length > 0) {
+                normal[p * 3] = nx / length;
+                normal[p * 3 + 1] = ny / length;
+                normal[p * 3 + 2] = nz / length;
+            }
+            depth[p] = f[6] * scale;
+        }
+    });
+
+#ifdef NEBULATRACER_OIDN
+    if (mode == DENOISER_OIDN && denoiseOIDN(color, albedo.data(), normal.data(), out, width, height))
+        return DENOISER_OIDN;
+#endif
+
+    // demodulated lighting and the variance of its mean luminance
+    std::vector<float> lighting(pixels * 3), variance(pixels);
+    std::vector<float> nextLighting(pixels * 3), nextVariance(pixels);
+    pool.parallelFor(height, [&](int y) {
+        for (int x = 0; x < width; ++x) {
+            size_t p = (size_t)y * width + x;
+            const float* a = &albedo[p * 3];
+            for (int i = 0; i < 3; ++i)
+                lighting[p * 3 + i] = color[p * 3 + i] / std::max(a[i], 0.01f);
+            float albedoLuminance = std::max(luminance(a[0], a[1], a[2]), 0.01f);
+            uint32_t n = fb->count[p];
+            const float* sum = &fb->sum[p * 4];
+            float mean = luminance(lighting[p * 3], lighting[p * 3 + 1], lighting[p * 3 + 2]);
+            if (n < 2) {
+                // one sample says nothing about the noise, assume it's as large as the signal
+                variance[p] = (mean + 0.1f) * (mean + 0.1f);
+                continue;
+            }
+            float sampleMean = luminance(sum[0], sum[1], sum[2]) / n;
+            float sampleVariance = std::max(0.0f, sum[3] / n - sampleMean * sampleMean) * n / (n - 1);
+            variance[p] = sampleVariance / n / (albedoLuminance * albedoLuminance);
+        }
+    });
+
+    static const float kernel[5] = { 1.0f / 16, 1.0f / 4, 3.0f / 8, 1.0f / 4, 1.0f / 16 };
+    for (int iteration = 0; iteration < iterations; ++iteration) {
+        int step = 1 << iteration;
+        pool.parallelFor(height, [&](int y) {
+            for (int x = 0; x < width; ++x) {
+                size_t p = (size_t)y * width + x;
+                const float* lp = &lighting[p * 3];
+                const float* np = &normal[p * 3];
+                float luminanceP = luminance(lp[0], lp[1], lp[2]);
+                float sigmaL = sigmaColor * sqrtf(variance[p]) + 1e-4f;
+                float sigmaZ = sigmaDepth * step * std::max(depth[p], 1e-3f);
+                float weightSum = 0, varianceSum = 0;
+                float sum[3] = { 0, 0, 0 };
+                for (int dy = -2; dy <= 2; ++dy) {
+                    int qy = y + dy * step;
+                    if (qy < 0 || qy >= height)
+                        continue;
+                    for (int dx = -2; dx <= 2; ++dx) {
+                        int qx = x + dx * step;
+                        if (qx < 0 || qx >= width)
+                            continue;
+                        size_t q = (size_t)qy * width + qx;
+                        const float* lq = &lighting[q * 3];
+                        const float* nq = &normal[q * 3];
+                        // unknown pixels can't tell an edge apart, geometry and sky never mix
+                        if (kind[p] != kind[q] && kind[p] != UNKNOWN && kind[q] != UNKNOWN)
+                            continue;
+                        float weight = kernel[dx + 2] * kernel[dy + 2];
+                        weight *= expf(-fabsf(luminanceP - luminance(lq[0], lq[1], lq[2])) / sigmaL);
+                        if (kind[p] == SURFACE && kind[q] == SURFACE) {
+                            float cosine = std::max(0.0f, np[0] * nq[0] + np[1] * nq[1] + np[2] * nq[2]);
+                            weight *= powf(cosine, sigmaNormal);
+                            weight *= expf(-fabsf(depth[p] - depth[q]) / sigmaZ);
+                        }
+                        weightSum += weight;
+                        varianceSum += weight * weight * variance[q];
+                        sum[0] += lq[0] * weight;
+                        sum[1] += lq[1] * weight;
+                        sum[2] += lq[2] * weight;
+                    }
+                }
+                // the pixel itself always has a weight, weightSum is never 0
+                for (int i = 0; i < 3; ++i)
+                    nextLighting[p * 3 + i] = sum[i] / weightSum;
+                nextVariance[p] = varianceSum / (weightSum * weightSum);
+            }
+        });
+        lighting.swap(nextLighting);
+        variance.swap(nextVariance);
+    }
+
+    pool.parallelFor(height, [&](int y) {
+        for (size_t i = (size_t)y * width * 3; i < (size_t)(y + 1) * width * 3; ++i)
+            out[i] = lighting[i] * std::max(albedo[i], 0.01f);
+    });
+    return DENOISER_ATROUS;
+}
+
+//--------- Tonemapping ---------//
+// Turns a resolved float32 r, g, b frame into 8 bit pixels in one pass, written straight into a bitmap's memory.
+// The curve runs on 4 pixels (12 floats) per SSE iteration, it doesn't care which channel a lane holds,
+// then every channel is quantized to TONEMAP_LUT_SIZE steps and looked up in an 8 bit (optionally sRGB encoded) table.
+static const int TONEMAP_CLAMP = 0;
+static const int TONEMAP_ACES = 1;
+static const int TONEMAP_LUT_SIZE = 4096;
+
+struct TonemapLUT {
+    unsigned char linear[TONEMAP_LUT_SIZE];
+    unsigned char srgb[TONEMAP_LUT_SIZE];
+
+    TonemapLUT() {
+        for (int i = 0; i < TONEMAP_LUT_SIZE; ++i) {
+            float v = (float)i / (TONEMAP_LUT_SIZE - 1);
+            float encoded = v <= 0.0031308f ? v * 12.92f : 1.055f * powf(v, 1.0f / 2.4f) - 0.055f;
+            // rounded to the nearest byte, like the tonemappers' map()
+            linear[i] = (unsigned char)(v * 255.0f + 0.5f);
+            srgb[i] = (unsigned char)(encoded * 255.0f + 0.5f);
+        }
+    }
+};
+
+static inline __m128 tonemapCurve(__m128 x, int op) {
+    const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+    x = _mm_max_ps(x, zero);
+    if (op == TONEMAP_ACES) {
+        // Narkowicz's fit, same constants as ACESTonemapper
+        __m128 numerator = _mm_mul_ps(x, _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(2.51f)), _mm_set1_ps(0.03f)));
+        __m128 denominator = _mm_add_ps(_mm_mul_ps(x, _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(2.43f)), _mm_set1_ps(0.59f))), _mm_set1_ps(0.14f));
+        x = _mm_div_ps(numerator, denominator);
+    }
+    return _mm_min_ps(x, one);
+}
+
+// `in` is width * height float32 r, g, b, `out` width * height pixels in `format` (lime's PixelFormat), alpha is always 255.
+extern "C" void tonemapFrame(const float* in, int width, int height, unsigned char* out, int format, int op, float exposure, bool srgb) {
+    static const TonemapLUT lut;
+    const unsigned char* table = srgb ? lut.srgb : lut.linear;
+    // byte offsets of r, g, b, a within a pixel
+    int ro, go, bo, ao;
+    switch (format) {
+        case PIXEL_ARGB32: ao = 0; ro = 1; go = 2; bo = 3; break;
+        case PIXEL_BGRA32: bo = 0; go = 1; ro = 2; ao = 3; break;
+        default: ro = 0; go = 1; bo = 2; ao = 3; break;
+    }
+
+    WorkerPool::shared().parallelFor(height, [&](int y) {
+        const float* row = in + (size_t)y * width * 3;
+        unsigned char* dst = out + (size_t)y * width * 4;
+        const __m128 exposed = _mm_set1_ps(exposure);
+        const __m128 steps = _mm_set1_ps((float)(TONEMAP_LUT_SIZE - 1));
+        const __m128 half = _mm_set1_ps(0.5f);
+        alignas(16) int32_t index[12];
+        int x = 0;
+        for (; x + 4 <= width; x += 4) {
+            const float* p = row + x * 3;
+            for (int i = 0; i < 3; ++i) {
+                __m128 v = tonemapCurve(_mm_mul_ps(_mm_loadu_ps(p + i * 4), exposed), op);
+                _mm_store_si128((__m128i*)(index + i * 4), _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(v, steps), half)));
+            }
+            for (int i = 0; i < 4; ++i) {
+                unsigned char* pixel = dst + (x + i) * 4;
+                pixel[ro] = table[index[i * 3]];
+                pixel[go] = table[index[i * 3 + 1]];
+                pixel[bo] = table[index[i * 3 + 2]];
+                pixel[ao] = 255;
+            }
+        }
+        for (; x < width; ++x) {
+            const float* p = row + x * 3;
+            alignas(16) float v[4];
+            _mm_store_ps(v, tonemapCurve(_mm_mul_ps(_mm_set_ps(0.0f, p[2], p[1], p[0]), exposed), op));
+            unsigned char* pixel = dst + x * 4;
+            pixel[ro] = table[(int)(v[0] * (TONEMAP_LUT_SIZE - 1) + 0.5f)];
+            pixel[go] = table[(int)(v[1] * (TONEMAP_LUT_SIZE - 1) + 0.5f)];
+            pixel[bo] = table[(int)(v[2] * (TONEMAP_LUT_SIZE - 1) + 0.5f)];
+            pixel[ao] = 255;
+        }
+    });
+}
+
+//--------- Tile scheduler ---------//
+// Hands out FRAMEBUFFER_TILE sized screen tiles to the threads tracing a frame. Every worker owns a deque, it takes tiles
+// from the front of its own and steals from the back of the others' once it runs dry.
+// Restarting (or cancelling) bumps the generation and drops every queued tile. A worker still tracing an older tile sees
+// isTileCurrent turn false and drops it too, so a new frame never waits behind an obsolete one.
+struct TileEntry {
+    int tile;
+    uint32_t generation;
+};
+
+struct TileWorker {
+    std::mutex mutex;
+    std::deque<TileEntry> tiles;
+    // generation of the tile this worker is tracing
+    std::atomic<uint32_t> generation{ 0 };
+};
+
+struct TileSchedulerInstance {
+    int width = 0;
+    int height = 0;
+    int tilesX = 0;
+    int tilesY = 0;
+    std::vector<std::unique_ptr<TileWorker>> workers;
+    std::atomic<uint32_t> generation{ 0 };
+    // tiles of the current generation that didn't finish yet
+    std::atomic<int> pending{ 0 };
+    // tiles handed out and not finished, of any generation, plus workers looking for one
+    std::atomic<int> active{ 0 };
+    int waiting = 0;
+    bool disposed = false;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable idle;
+};
+
+// Every call holds its own reference, so a scheduler disposed while a worker is inside one of them lives until it returns.
+std::unordered_map<int, std::shared_ptr<TileSchedulerInstance>> tileSchedulers;
+std::mutex tileSchedulerMutex;
+int nextTileSchedulerID = 0;
+
+static std::shared_ptr<TileSchedulerInstance> getTileScheduler(int id) {
+    std::lock_guard<std::mutex> lock(tileSchedulerMutex);
+    auto it = tileSchedulers.find(id);
+    return it == tileSchedulers.end() ? nullptr : it->second;
+}
+
+static void clearTileQueues(TileSchedulerInstance* s) {
+    for (std::unique_ptr<TileWorker>& worker : s->workers) {
+        std::lock_guard<std::mutex> lock(worker->mutex);
+        worker->tiles.clear();
+    }
+}
+
+// `workers` of 0 or less uses one per hardware thread but the one presenting the frames.
+extern "C" int createTileScheduler(int width, int height, int workers) {
+    if (workers <= 0)
+        workers = std::max(1, (int)std::thread::hardware_concurrency() - 1);
+    std::shared_ptr<TileSchedulerInstance> s = std::make_shared<TileSchedulerInstance>();
+    s->width = width;
+    s->height = height;
+    s->tilesX = (width + FRAMEBUFFER_TILE - 1) / FRAMEBUFFER_TILE;
+    s->tilesY = (height + FRAMEBUFFER_TILE - 1) / FRAMEBUFFER_TILE;
+    for (int i = 0; i < workers; ++i)
+        s->workers.emplace_back(new TileWorker());
+    std::lock_guard<std::mutex> lock(tileSchedulerMutex);
+    int id = nextTileSchedulerID++;
+    tileSchedulers[id] = s;
+    return id;
+}
+
+// Wakes every waiting worker (acquireTile returns -1 to them) and forgets the id once none of them is inside it,
+// calls made with the id after that find nothing. The last reference frees the scheduler.
+extern "C" void disposeTileScheduler(int id) {
+    std::shared_ptr<TileSchedulerInstance> s = getTileScheduler(id);
+    if (!s)
+        return;
+    {
+        std::unique_lock<std::mutex> lock(s->mutex);
+        if (s->disposed)
+            return;
+        s->disposed = true;
+        s->generation++;
+        s->wake.notify_all();
+        // tiles being traced still have to be finished through the id
+        s->idle.wait(lock, [&s] { return s->active == 0 && s->waiting == 0; });
+    }
+    clearTileQueues(s.get());
+    std::lock_guard<std::mutex> lock(tileSchedulerMutex);
+    tileSchedulers.erase(id);
+}
+
+extern "C" int getTileSchedulerWorkers(int id) {
+    std::shared_ptr<TileSchedulerInstance> s = getTileScheduler(id);
+    return s ? (int)s->workers.size() : 0;
+}
+
+static const int TILE_ORDER_ROWS = 0;
+static const int TILE_ORDER_SPIRAL = 1;
+
+// Tiles in the order they should be traced. The spiral goes ring by ring (square rings, in tiles) around the focus point,
+// clockwise from the top within a ring, so whatever the user looks at comes first.
+static std::vector<int> buildTileOrder(int tilesX, int tilesY, int order, float focusX, float focusY) {
+    std::vector<int> tiles(tilesX * tilesY);
+    for (int i = 0; i < (int)tiles.size(); ++i)
+        tiles[i] = i;
+    if (order != TILE_ORDER_SPIRAL)
+        return tiles;
+
+    int focusTileX = std::clamp((int)(focusX / FRAMEBUFFER_TILE), 0, tilesX - 1);
+    int focusTileY = std::clamp((int)(focusY / FRAMEBUFFER_TILE), 0, tilesY - 1);
+    std::vector<std::pair<float, int>> keys(tiles.size());
+    for (int i = 0; i < (int)tiles.size(); ++i) {
+        int dx = i % tilesX - focusTileX, dy = i / tilesX - focusTileY;
+        int ring = std::max(std::abs(dx), std::abs(dy));
+        // the angle in [0, 1) orders tiles within the ring, 0 straight up (y points down)
+        float angle = atan2f((float)dx, (float)-dy) / 6.2831853f;
+        if (angle < 0)
+            angle += 1.0f;
+        keys[i] = { ring + std::min(angle, 0.999f), i };
+    }
+    std::sort(keys.begin(), keys.end());
+    for (int i = 0; i < (int)tiles.size(); ++i)
+        tiles[i] = keys[i].second;
+    return tiles;
+}
+
+// Drops every queued tile and queues the whole screen again as a new generation, resizing if needed.
+// Tiles are dealt round robin in `order` (TILE_ORDER_*, spirals start at the focus pixel), so the workers' fronts
+// together walk the screen in that order.
+extern "C" int restartTileScheduler(int id, int width, int height, int order, float focusX, float focusY) {
+    std::shared_ptr<TileSchedulerInstance> s = getTileScheduler(id);
+    if (!s)
+        return 0;
+    std::lock_guard<std::mutex> lock(s->mutex);
+    if (s->disposed)
+        return 0;
+    clearTileQueues(s.get());
+    s->width = width;
+    s->height = height;
+    s->tilesX = (width + FRAMEBUFFER_TILE - 1) / FRAMEBUFFER_TILE;
+    s->tilesY = (height + FRAMEBUFFER_TILE - 1) / FRAMEBUFFER_TILE;
+    uint32_t generation = ++s->generation;
+    std::vector<int> tiles = buildTileOrder(s->tilesX, s->tilesY, order, focusX, focusY);
+    int workers = (int)s->workers.size();
+    for (int i = 0; i < (int)tiles.size(); ++i) {
+        TileWorker* worker = s->workers[i % workers].get();
+        std::lock_guard<std::mutex> queueLock(worker->mutex);
+        worker->tiles.push_back({ tiles[i], generation });
+    }
+    s->pending = (int)tiles.size();
+    s->wake.notify_all();
+    return (int)generation;
+}
+
+// Drops every queued tile and cancels the ones being traced, without queueing anything new.
+extern "C" void cancelTileScheduler(int id) {
+    std::shared_ptr<TileSchedulerInstance> s = getTileScheduler(id);
+    if (!s)
+        return;
+    std::lock_guard<std::mutex> lock(s->mutex);
+    s->generation++;
+    clearTileQueues(s.get());
+    s->pending = 0;
+}
+
+// Blocks until no tile is being traced, after a cancel nothing touches the scene or the framebuffer anymore.
+extern "C" void waitTileSchedulerIdle(int id) {
+    std::shared_ptr<TileSchedulerInstance> s = getTileScheduler(id);
+    if (!s)
+        return;
+    std::unique_lock<std::mutex> lock(s->mutex);
+    s->idle.wait(lock, [&s] { return s->active == 0; });
+}
+
+static bool popTile(TileWorker* worker, bool front, TileEntry& entry) {
+    std::lock_guard<std::mutex> lock(worker->mutex);
+    if (worker->tiles.empty())
+        return false;
+    if (front) {
+        entry = worker->tiles.front();
+        worker->tiles.pop_front();
+    } else {
+        entry = worker->tiles.back();
+        worker->tiles.pop_back();
+    }
+    return true;
+}
+
+// Gives `worker` its next tile, stealing one if its own deque is empty, and blocks while there's nothing to do.
+// Returns -1 once the scheduler is disposed.
+extern "C" int acquireTile(int id, int worker) {
+    std::shared_ptr<TileSchedulerInstance> s = getTileScheduler(id);
+    if (!s || worker < 0 || worker >= (int)s->workers.size())
+        return -1;
+    int workers = (int)s->workers.size();
+    std::unique_lock<std::mutex> lock(s->mutex);
+    s->waiting++;
+    while (!s->disposed) {
+        uint32_t generation = s->generation;
+        // counted before popping, so waitTileSchedulerIdle can't miss a tile on its way out of a deque
+        s->active++;
+        lock.unlock();
+        TileEntry entry;
+        bool found = popTile(s->workers[worker].get(), true, entry);
+        for (int i = 1; !found && i < workers; ++i)
+            found = popTile(s->workers[(worker + i) % workers].get(), false, entry);
+        lock.lock();
+        if (found) {
+            s->workers[worker]->generation = entry.generation;
+            s->waiting--;
+            return entry.tile;
+        }
+        if (--s->active == 0)
+            s->idle.notify_all();
+        s->wake.wait(lock, [&s, generation] { return s->disposed || s->generation != generation; });
+    }
+    if (--s->waiting == 0)
+        s->idle.notify_all();
+    return -1;
+}
+
+// Whether the tile `worker` is tracing still belongs to the current generation, check it often and drop the tile if not.
+extern "C" bool isTileCurrent(int id, int worker) {
+    std::shared_ptr<TileSchedulerInstance> s = getTileScheduler(id);
+    if (!s || worker < 0 || worker >= (int)s->workers.size())
+        return false;
+    return s->workers[worker]->generation == s->generation;
+}
+
+// Hands the tile `worker` was tracing back. Returns how many tiles of the current generation are left.
+extern "C" int finishTile(int id, int worker) {
+    std::shared_ptr<TileSchedulerInstance> s = getTileScheduler(id);
+    if (!s || worker < 0 || worker >= (int)s->workers.size())
+        return 0;
+    std::lock_guard<std::mutex> lock(s->mutex);
+    if (s->workers[worker]->generation == s->generation && s->pending > 0)
+        s->pending--;
+    if (--s->active == 0)
+        s->idle.notify_all();
+    return s->pending;
+}
+
+extern "C" int getTileSchedulerPending(int id) {
+    std::shared_ptr<TileSchedulerInstance> s = getTileScheduler(id);
+    return s ? (int)s->pending : 0;
+}
+
+//--------- Radiance cache ---------//
+// A spatial hash of the light leaving the scene's surfaces, keyed on the position quantized to a cell, the normal
+// quantized to a few directions and how many bounces of light the value holds. It's an open-addressed table that's only ever touched with atomics, so any number
+// of threads can read and write it at once: a slot is claimed by swapping its key in, and samples are added in place.
+// Paths write what every vertex they trace sees and stop as soon as they reach a vertex with enough samples,
+// reading the cached value instead. A vertex only reads and writes the entry for the bounces it has left, so a cut short
+// path never passes for a longer one. Once the cache filled in, a path of any length costs about one bounce.
+#define RADIANCE_CACHE_PROBES 16
+
+struct RadianceCacheEntry {
+    // 0 is a free slot
+    std::atomic<uint64_t> key{ 0 };
+    std::atomic<float> red{ 0 }, green{ 0 }, blue{ 0 };
+    std::atomic<uint32_t> count{ 0 };
+};
+
+struct RadianceCacheInstance {
+    std::unique_ptr<RadianceCacheEntry[]> entries;
+    uint32_t mask = 0;
+    float cellSize = 1;
+    // vertices with this many samples end paths, vertices with maxSamples stop taking new ones
+    uint32_t minSamples = 4;
+    uint32_t maxSamples = 64;
+};
+
+std::unordered_map<int, RadianceCacheInstance*> radianceCaches;
+std::mutex radianceCacheMutex;
+int nextRadianceCacheID = 0;
+
+static RadianceCacheInstance* getRadianceCache(int id) {
+    std::lock_guard<std::mutex> lock(radianceCacheMutex);
+    auto it = radianceCaches.find(id);
+    return it == radianceCaches.end() ? nullptr : it->second;
+}
+
+// Traces one ray against `scene`, the caller holds raytracerMutex. `normal` (optional) gets the unit geometric normal
+// of the hit, flipped to face the ray.
+static bool intersectScene(RTCScene scene, const float* origin, const float* dir, float tfar, float& distance, unsigned& geomID,
+    float* normal = nullptr) {
+    RTCRayHit rayhit = {};
+    rayhit.ray.org_x = origin[0];
+    rayhit.ray.org_y = origin[1];
+    rayhit.ray.org_z = origin[2];
+    rayhit.ray.dir_x = dir[0];
+    rayhit.ray.dir_y = dir[1];
+    rayhit.ray.dir_z = dir[2];
+    rayhit.ray.tnear = 0.0f;
+    rayhit.ray.tfar = tfar;
+    rayhit.ray.mask = -1;
+    rayhit.hit.geomID = RTC_INVALID_GEOMETRY_ID;
+    rayhit.hit.primID = RTC_INVALID_GEOMETRY_ID;
+    rayhit.hit.instID[0] = RTC_INVALID_GEOMETRY_ID;
+    rtcIntersect1(scene, &rayhit);
+    distance = rayhit.ray.tfar;
+    geomID = rayhit.hit.geomID;
+    if (geomID == RTC_INVALID_GEOMETRY_ID)
+        return false;
+    if (normal) {
+        float n[3] = { rayhit.hit.Ng_x, rayhit.hit.Ng_y, rayhit.hit.Ng_z };
+        float length = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        float flip = n[0] * dir[0] + n[1] * dir[1] + n[2] * dir[2] > 0 ? -1.0f : 1.0f;
+        for (int i = 0; i < 3; ++i)
+            normal[i] = length > 0 ? n[i] * flip / length : 0;
+    }
+    return true;
+}
+
+static inline uint64_t radianceCacheKey(const RadianceCacheInstance* cache, const float* position, const float* normal, int bounces) {
+    uint64_t key = (uint64_t)bounces * 0xC2B2AE3D27D4EB4Full;
+    for (int i = 0; i < 3; ++i) {
+        int64_t cell = (int64_t)floorf(position[i] / cache->cellSize);
+        // 5 directions per axis, walls of a thin part don't share their light
+        int64_t bucket = (int64_t)lrintf(normal[i] * 2) + 2;
+        key = (key ^ (uint64_t)(cell * 3 + 1) ^ ((uint64_t)bucket << 40)) * 0x9E3779B97F4A7C15ull;
+        key ^= key >> 29;
+    }
+    return key | 1;
+}
+
+// The slot holding `key`, claimed if it isn't there yet. nullptr if every slot it may use is taken.
+static RadianceCacheEntry* findRadianceCacheEntry(RadianceCacheInstance* cache, uint64_t key, bool insert) {
+    for (uint32_t i = 0; i < RADIANCE_CACHE_PROBES; ++i) {
+        RadianceCacheEntry& entry = cache->entries[(key + i) & cache->mask];
+        uint64_t current = entry.key.load(std::memory_order_acquire);
+        if (current == key)
+            return &entry;
+        if (current == 0) {
+            if (!insert)
+                return nullptr;
+            if (entry.key.compare_exchange_strong(current, key, std::memory_order_acq_rel) || current == key)
+                return &entry;
+        }
+    }
+    return nullptr;
+}
+
+static inline void atomicAdd(std::atomic<float>& value, float amount) {
+    float current = value.load(std::memory_order_relaxed);
+    while (!value.compare_exchange_weak(current, current + amount, std::memory_order_relaxed)) {
+    }
+}
+
+static inline void addRadianceSample(RadianceCacheInstance* cache, RadianceCacheEntry* entry, const float* color) {
+    if (entry->count.load(std::memory_order_relaxed) >= cache->maxSamples)
+        return;
+    atomicAdd(entry->red, color[0]);
+    atomicAdd(entry->green, color[1]);
+    atomicAdd(entry->blue, color[2]);
+    entry->count.fetch_add(1, std::memory_order_release);
+}
+
+// false if the entry doesn't have minSamples yet
+static inline bool readRadianceEntry(const RadianceCacheInstance* cache, const RadianceCacheEntry* entry, float* out) {
+    uint32_t count = entry->count.load(std::memory_order_acquire);
+    if (count < cache->minSamples)
+        return false;
+    // a sample being added may be in the sums but not the count yet, that's well within the noise
+    out[0] = entry->red.load(std::memory_order_relaxed) / count;
+    out[1] = entry->green.load(std::memory_order_relaxed) / count;
+    out[2] = entry->blue.load(std::memory_order_relaxed) / count;
+    return true;
+}
+
+// What paths need to shade their vertices, everything is read only while they trace.
+struct RadiancePath {
+    RadianceCacheInstance* cache;
+    RTCScene scene;
+    const std::vector<MaterialRecord>* materials;
+    const std::vector<LightRecord>* lights;
+    float sky[3];
+    uint32_t random;
+};
+
+static inline float nextRandom(uint32_t& state) {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return (state >> 8) * (1.0f / 16777216.0f);
+}
+
+// One sample of the light leaving the surface at `position` towards where the path came from: the surface's color times
+// the light of every visible light (falling off linearly to 0 at its power, like the primary shading) plus, if `bounces`
+// is above 1, one cosine weighted bounce. A vertex with enough cached samples for these `bounces` is read instead of traced.
+static void traceRadiancePath(RadiancePath& path, const float* position, const float* normal, unsigned geomID, int bounces, float* out) {
+    const MaterialRecord* material = geomID < path.materials->size() ? &(*path.materials)[geomID] : nullptr;
+    float albedo[3] = { 1, 1, 1 };
+    if (material) {
+        albedo[0] = material->red;
+        albedo[1] = material->green;
+        albedo[2] = material->blue;
+        if (material->isEmitter) {
+            memcpy(out, albedo, 12);
+            return;
+        }
+    }
+
+    uint64_t key = radianceCacheKey(path.cache, position, normal, bounces);
+    RadianceCacheEntry* entry = findRadianceCacheEntry(path.cache, key, true);
+    if (entry && readRadianceEntry(path.cache, entry, out))
+        return;
+
+    float origin[3];
+    for (int i = 0; i < 3; ++i)
+        origin[i] = position[i] + normal[i] * 0.001f;
+    float light[3] = { 0, 0, 0 };
+    for (const LightRecord& record : *path.lights) {
+        float toLight[3] = { record.posx - origin[0], record.posy - origin[1], record.posz - origin[2] };
+        float distance = sqrtf(toLight[0] * toLight[0] + toLight[1] * toLight[1] + toLight[2] * toLight[2]);
+        float falloff = record.power > 0 ? 1 - distance / record.power : 0;
+        if (distance <= 0 || falloff <= 0)
+            continue;
+        for (int i = 0; i < 3; ++i)
+            toLight[i] /= distance;
+        float cosine = toLight[0] * normal[0] + toLight[1] * normal[1] + toLight[2] * normal[2];
+        if (cosine <= 0)
+            continue;
+        float hitDistance;
+        unsigned hitGeomID;
+        // lights sit on their emitter, hitting it counts as reaching the light
+        if (intersectScene(path.scene, origin, toLight, distance, hitDistance, hitGeomID) && hitGeomID != (unsigned)record.geomID)
+            continue;
+        light[0] += record.red * falloff * cosine;
+        light[1] += record.green * falloff * cosine;
+        light[2] += record.blue * falloff * cosine;
+    }
+
+    if (bounces > 1) {
+        // cosine weighted around the normal
+        float u = nextRandom(path.random), v = nextRandom(path.random);
+        float r = sqrtf(u), phi = 6.28318531f * v;
+        float tangent[3], bitangent[3];
+        if (fabsf(normal[1]) < 0.999f) {
+            tangent[0] = normal[2];
+            tangent[1] = 0;
+            tangent[2] = -normal[0];
+        }
+        else {
+            tangent[0] = 0;
+            tangent[1] = -normal[2];
+            tangent[2] = normal[1];
+        }
+        float length = sqrtf(tangent[0] * tangent[0] + tangent[1] * tangent[1] + tangent[2] * tangent[2]);
+        for (int i = 0; i < 3; ++i)
+            tangent[i] /= length;
+        bitangent[0] = normal[1] * tangent[2] - normal[2] * tangent[1];
+        bitangent[1] = normal[2] * tangent[0] - normal[0] * tangent[2];
+        bitangent[2] = normal[0] * tangent[1] - normal[1] * tangent[0];
+        float up = sqrtf(std::max(0.0f, 1 - u));
+        float dir[3];
+        for (int i = 0; i < 3; ++i)
+            dir[i] = tangent[i] * r * cosf(phi) + bitangent[i] * r * sinf(phi) + normal[i] * up;
+
+        float distance, hitNormal[3], bounce[3];
+        unsigned hitGeomID;
+        if (intersectScene(path.scene, origin, dir, INFINITY, distance, hitGeomID, hitNormal)) {
+            float hit[3] = { origin[0] + dir[0] * distance, origin[1] + dir[1] * distance, origin[2] + dir[2] * distance };
+            traceRadiancePath(path, hit, hitNormal, hitGeomID, bounces - 1, bounce);
+        }
+        else
+            memcpy(bounce, path.sky, 12);
+        for (int i = 0; i < 3; ++i)
+            light[i] += bounce[i];
+    }
+
+    for (int i = 0; i < 3; ++i)
+        out[i] = albedo[i] * light[i];
+    if (entry)
+        addRadianceSample(path.cache, entry, out);
+}
+
+extern "C" int createRadianceCache() {
+    std::lock_guard<std::mutex> lock(radianceCacheMutex);
+    int id = nextRadianceCacheID++;
+    radianceCaches[id] = new RadianceCacheInstance();
+    return id;
+}
+
+extern "C" void disposeRadianceCache(int id) {
+    std::lock_guard<std::mutex> lock(radianceCacheMutex);
+    auto it = radianceCaches.find(id);
+    if (it == radianceCaches.end())
+        return;
+    delete it->second;
+    radianceCaches.erase(it);
+}
+
+// Empties the cache and sizes its cells so `cells` of them fit along the longest side of `raytracerID`'s scene.
+// `capacity` is rounded up to a power of two. Nothing may trace through the cache while it's reset.
+extern "C" void resetRadianceCache(int id, int raytracerID, int capacity, int cells, int minSamples, int maxSamples) {
+    RadianceCacheInstance* cache = getRadianceCache(id);
+    if (!cache)
+        return;
+    RTCBounds bounds = {};
+    {
+        std::shared_lock<std::shared_mutex> lock(raytracerMutex);
+        auto it = raytracers.find(raytracerID);
+        if (it != raytracers.end())
+            rtcGetSceneBounds(it->second->scene, &bounds);
+    }
+    float longest = std::max(bounds.upper_x - bounds.lower_x, std::max(bounds.upper_y - bounds.lower_y, bounds.upper_z - bounds.lower_z));
+    cache->cellSize = longest > 0 && std::isfinite(longest) ? longest / std::max(1, cells) : 1;
+    cache->minSamples = (uint32_t)std::max(1, minSamples);
+    cache->maxSamples = (uint32_t)std::max(minSamples, maxSamples);
+    uint32_t size = 1;
+    while (size < (uint32_t)std::max(RADIANCE_CACHE_PROBES, capacity) && size < (1u << 30))
+        size <<= 1;
+    if (size != cache->mask + 1 || !cache->entries) {
+        cache->entries.reset(new RadianceCacheEntry[size]);
+        cache->mask = size - 1;
+        return;
+    }
+    WorkerPool::shared().parallelFor((int)((size + 4095) / 4096), [&](int block) {
+        uint32_t end = std::min(size, (uint32_t)(block + 1) * 4096);
+        for (uint32_t i = (uint32_t)block * 4096; i < end; ++i) {
+            RadianceCacheEntry& entry = cache->entries[i];
+            entry.key.store(0, std::memory_order_relaxed);
+            entry.red.store(0, std::memory_order_relaxed);
+            entry.green.store(0, std::memory_order_relaxed);
+            entry.blue.store(0, std::memory_order_relaxed);
+            entry.count.store(0, std::memory_order_relaxed);
+        }
+    });
+}
+
+// How many slots of the cache are taken.
+extern "C" int getRadianceCacheSize(int id) {
+    RadianceCacheInstance* cache = getRadianceCache(id);
+    if (!cache || !cache->entries)
+        return 0;
+    int used = 0;
+    for (uint32_t i = 0; i <= cache->mask; ++i)
+        if (cache->entries[i].key.load(std::memory_order_relaxed) != 0)
+            used++;
+    return used;
+}
+
+//--------- Irradiance probes ---------//
+// A grid of light probes over the scene bounds, every probe keeps the light arriving at it as L1 spherical harmonics
+// (4 coefficients per channel). Probes are refined a batch at a time: an update traces a few rays from each of the next
+// probes in line across the worker pool and folds them into the running sums, so the grid converges over a few frames
+// instead of stalling one. Rays continue a low discrepancy sequence per probe, every batch fills the gaps of the ones before.
+// Shading points blend the 8 probes around them, trilinearly and away from probes behind the surface.
+#define PROBE_COEFFICIENTS 12
+
+struct ProbeGridInstance {
+    int resX = 0, resY = 0, resZ = 0;
+    float originX = 0, originY = 0, originZ = 0;
+    float cellX = 1, cellY = 1, cellZ = 1;
+    // radiance times every SH basis function, summed over every ray so far, r g b interleaved per coefficient
+    std::vector<float> sums;
+    std::vector<uint32_t> rays;
+    int cursor = 0;
+    // updates only write under the exclusive lock, sampling shares it
+    std::shared_mutex lock;
+};
+
+std::unordered_map<int, ProbeGridInstance*> probeGrids;
+std::mutex probeGridMutex;
+int nextProbeGridID = 0;
+
+static ProbeGridInstance* getProbeGrid(int id) {
+    std::lock_guard<std::mutex> lock(probeGridMutex);
+    auto it = probeGrids.find(id);
+    return it == probeGrids.end() ? nullptr : it->second;
+}
+
+static inline double fract(double x) {
+    return x - floor(x);
+}
+
+// The n-th direction of a uniform sphere sequence (R2 sequence mapped to the sphere), offset per probe.
+// Done in double and with the seed reduced to an offset first, float32 runs out of fractional bits on large seeds.
+static inline void sphereDirection(uint32_t n, uint32_t seed, float* dir) {
+    float u = (float)fract(0.5 + n * 0.7548776662 + fract(seed * 0.7548776662));
+    float v = (float)fract(0.5 + n * 0.5698402910 + fract(seed * 0.5698402910));
+    float z = 1 - 2 * u;
+    float r = sqrtf(std::max(0.0f, 1 - z * z));
+    float phi = 6.28318531f * v;
+    dir[0] = r * cosf(phi);
+    dir[1] = r * sinf(phi);
+    dir[2] = z;
+}
+
+extern "C" int createProbeGrid() {
+    std::lock_guard<std::mutex> lock(probeGridMutex);
+    int id = nextProbeGridID++;
+    probeGrids[id] = new ProbeGridInstance();
+    return id;
+}
+
+extern "C" void disposeProbeGrid(int id) {
+    std::lock_guard<std::mutex> lock(probeGridMutex);
+    auto it = probeGrids.find(id);
+    if (it == probeGrids.end())
+        return;
+    delete it->second;
+    probeGrids.erase(it);
+}
+
+// Spreads the grid over the bounds of `raytracerID`'s scene with at most `resolution` probes along the longest axis,
+// and throws away everything traced so far. Returns how many probes the grid has.
+extern "C" int resetProbeGrid(int id, int raytracerID, int resolution) {
+    ProbeGridInstance* grid = getProbeGrid(id);
+    if (!grid)
+        return 0;
+    RTCBounds bounds = {};
+    {
+        std::shared_lock<std::shared_mutex> lock(raytracerMutex);
+        auto it = raytracers.find(raytracerID);
+        if (it == raytracers.end())
+            return 0;
+        rtcGetSceneBounds(it->second->scene, &bounds);
+    }
+    float extent[3] = { bounds.upper_x - bounds.lower_x, bounds.upper_y - bounds.lower_y, bounds.upper_z - bounds.lower_z };
+    float longest = std::max(extent[0], std::max(extent[1], extent[2]));
+    std::unique_lock<std::shared_mutex> lock(grid->lock);
+    if (!(longest > 0) || !std::isfinite(longest) || resolution < 2) {
+        grid->resX = grid->resY = grid->resZ = 0;
+        grid->sums.clear();
+        grid->rays.clear();
+        return 0;
+    }
+    // probes sit on the bounds, one cell apart along every axis
+    float cell = longest / (resolution - 1);
+    int res[3];
+    for (int i = 0; i < 3; ++i)
+        res[i] = std::max(2, (int)ceilf(extent[i] / cell) + 1);
+    grid->resX = res[0];
+    grid->resY = res[1];
+    grid->resZ = res[2];
+    grid->cellX = std::max(extent[0], cell) / (res[0] - 1);
+    grid->cellY = std::max(extent[1], cell) / (res[1] - 1);
+    grid->cellZ = std::max(extent[2], cell) / (res[2] - 1);
+    grid->originX = bounds.lower_x;
+    grid->originY = bounds.lower_y;
+    grid->originZ = bounds.lower_z;
+    size_t count = (size_t)res[0] * res[1] * res[2];
+    grid->sums.assign(count * PROBE_COEFFICIENTS, 0.0f);
+    grid->rays.assign(count, 0);
+    grid->cursor = 0;
+    return (int)count;
+}
+
+// Traces `raysPerProbe` rays from each of the next `probeCount` probes that have fewer than `maxRays`.
+// Rays are traced against `raytracerID`, what they hit is colored by the materials of `materialsID` (both can be the same),
+// rays that hit nothing see `sky`. Returns how many probes were refined, 0 once the whole grid reached `maxRays`.
+// With a radiance cache (`cacheID` of -1 for none) and `bounces` above 1, what a ray hits is shaded by a path of up to
+// `bounces - 1` more vertices through the cache instead of just its color.
+extern "C" int updateProbeGrid(int id, int raytracerID, int materialsID, int probeCount, int raysPerProbe, int maxRays, float skyR, float skyG,
+    float skyB, int cacheID, int bounces) {
+    ProbeGridInstance* grid = getProbeGrid(id);
+    if (!grid || probeCount <= 0 || raysPerProbe <= 0)
+        return 0;
+
+    // picks the batch, the sums are only read by this thread so no lock is needed until they're written
+    int total = (int)grid->rays.size();
+    std::vector<int> batch;
+    for (int i = 0; i < total && (int)batch.size() < probeCount; ++i) {
+        int probe = (grid->cursor + i) % total;
+        if (grid->rays[probe] < (uint32_t)maxRays)
+            batch.push_back(probe);
+    }
+    if (batch.empty())
+        return 0;
+    grid->cursor = (batch.back() + 1) % total;
+
+    RadianceCacheInstance* cache = bounces > 1 ? getRadianceCache(cacheID) : nullptr;
+    if (cache && !cache->entries)
+        cache = nullptr;
+    std::vector<float> deltas(batch.size() * PROBE_COEFFICIENTS, 0.0f);
+    {
+        std::shared_lock<std::shared_mutex> lock(raytracerMutex);
+        auto tracer = raytracers.find(raytracerID);
+        auto materials = raytracers.find(materialsID);
+        if (tracer == raytracers.end() || materials == raytracers.end())
+            return 0;
+        RTCScene scene = tracer->second->scene;
+        const std::vector<MaterialRecord>& records = materials->second->materials;
+        WorkerPool::shared().parallelFor((int)batch.size(), [&](int b) {
+            int probe = batch[b];
+            int px = probe % grid->resX;
+            int py = (probe / grid->resX) % grid->resY;
+            int pz = probe / (grid->resX * grid->resY);
+            float origin[3] = { grid->originX + px * grid->cellX, grid->originY + py * grid->cellY, grid->originZ + pz * grid->cellZ };
+            float* delta = &deltas[(size_t)b * PROBE_COEFFICIENTS];
+            uint32_t first = grid->rays[probe];
+            RadiancePath path = { cache, scene, &records, &materials->second->lights, { skyR, skyG, skyB },
+                ((uint32_t)probe * 0x9E3779B9u) ^ (first * 0x85EBCA6Bu) ^ 0x1234567u };
+            for (int r = 0; r < raysPerProbe; ++r) {
+                float dir[3], distance, normal[3];
+                unsigned geomID;
+                sphereDirection(first + r, (uint32_t)probe * 7919u, dir);
+                float color[3] = { skyR, skyG, skyB };
+                if (intersectScene(scene, origin, dir, INFINITY, distance, geomID, normal)) {
+                    if (cache) {
+                        float hit[3] = { origin[0] + dir[0] * distance, origin[1] + dir[1] * distance, origin[2] + dir[2] * distance };
+                        traceRadiancePath(path, hit, normal, geomID, bounces - 1, color);
+                    }
+                    else if (geomID < records.size()) {
+                        color[0] = records[geomID].red;
+                        color[1] = records[geomID].green;
+                        color[2] = records[geomID].blue;
+                    }
+                    else
+                        color[0] = color[1] = color[2] = 1;
+                }
+                // L1 basis: 0.282095, then 0.488603 times y, z and x
+                float basis[4] = { 0.282095f, 0.488603f * dir[1], 0.488603f * dir[2], 0.488603f * dir[0] };
+                for (int k = 0; k < 4; ++k)
+                    for (int c = 0; c < 3; ++c)
+                        delta[k * 3 + c] += color[c] * basis[k];
+            }
+        });
+    }
+
+    std::unique_lock<std::shared_mutex> lock(grid->lock);
+    if (grid->rays.size() != (size_t)total)
+        return 0;
+    for (size_t b = 0; b < batch.size(); ++b) {
+        float* sums = &grid->sums[(size_t)batch[b] * PROBE_COEFFICIENTS];
+        for (int k = 0; k < PROBE_COEFFICIENTS; ++k)
+            sums[k] += deltas[b * PROBE_COEFFICIENTS + k];
+        grid->rays[batch[b]] += raysPerProbe;
+    }
+    return (int)batch.size();
+}
+
+// Writes the light bouncing off a surface at `position` facing `normal` into `out` (rgb): the cosine weighted mean
+// of the radiance around it, i.e. irradiance over pi. Returns false if none of the probes around it were traced yet.
+extern "C" bool sampleProbeGrid(int id, float x, float y, float z, float normalX, float normalY, float normalZ, float* out) {
+    ProbeGridInstance* grid = getProbeGrid(id);
+    if (!grid)
+        return false;
+    std::shared_lock<std::shared_mutex> lock(grid->lock);
+    if (grid->rays.empty())
+        return false;
+    float position[3] = { x, y, z };
+    float origin[3] = { grid->originX, grid->originY, grid->originZ };
+    float cell[3] = { grid->cellX, grid->cellY, grid->cellZ };
+    int res[3] = { grid->resX, grid->resY, grid->resZ };
+    int base[3];
+    float frac[3];
+    for (int i = 0; i < 3; ++i) {
+        float g = std::min(std::max((position[i] - origin[i]) / cell[i], 0.0f), (float)(res[i] - 1));
+        base[i] = std::min((int)g, res[i] - 2);
+        frac[i] = g - base[i];
+    }
+
+    // the irradiance of an L1 probe convolved with the clamped cosine, over pi
+    const float band0 = 0.282095f, band1 = 0.488603f * 2.0f / 3.0f;
+    float sum[3] = { 0, 0, 0 };
+    float weights = 0;
+    for (int corner = 0; corner < 8; ++corner) {
+        int offset[3] = { corner & 1, (corner >> 1) & 1, (corner >> 2) & 1 };
+        int probe = ((base[2] + offset[2]) * res[1] + base[1] + offset[1]) * res[0] + base[0] + offset[0];
+        uint32_t rays = grid->rays[probe];
+        if (rays == 0)
+            continue;
+        float weight = 1;
+        float toProbe[3];
+        float length = 0;
+        for (int i = 0; i < 3; ++i) {
+            weight *= offset[i] ? frac[i] : 1 - frac[i];
+            toProbe[i] = origin[i] + (base[i] + offset[i]) * cell[i] - position[i];
+            length += toProbe[i] * toProbe[i];
+        }
+        // probes behind the surface fade out smoothly, they'd leak light from the other side
+        length = sqrtf(length);
+        float facing = length > 1e-6f ? (toProbe[0] * normalX + toProbe[1] * normalY + toProbe[2] * normalZ) / length : 1;
+        facing = (facing + 1) * 0.5f;
+        weight *= facing * facing + 0.05f;
+        if (weight <= 0)
+            continue;
+
+        // Monte Carlo over the sphere, every coefficient is 4 pi times the mean of radiance times basis
+        const float* sh = &grid->sums[(size_t)probe * PROBE_COEFFICIENTS];
+        float scale = 4 * 3.14159265f / rays;
+        for (int c = 0; c < 3; ++c) {
+            float value = band0 * sh[c] + band1 * (sh[3 + c] * normalY + sh[6 + c] * normalZ + sh[9 + c] * normalX);
+            sum[c] += std::max(0.0f, value * scale) * weight;
+        }
+        weights += weight;
+    }
+    if (weights <= 0)
+        return false;
+    for (int c = 0; c < 3; ++c)
+        out[c] = sum[c] / weights;
+    return true;
+}
+
+//--------- Mesh loading ---------//
+// Read-only view of a whole file, memory mapped so parsing never copies it.
+class MappedFile {
+public:
+    const char* data = nullptr;
+    size_t size = 0;
+
+    bool open(const char* path) {
+#ifdef _WIN32
+        int length = MultiByteToWideChar(CP_UTF8, 0, path, -1, nullptr, 0);
+        std::wstring widePath(length, L'\0');
+        MultiByteToWideChar(CP_UTF8, 0, path, -1, &widePath[0], length);
+        file = CreateFileW(widePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+            return false;
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(file, &fileSize))
+            return false;
+        size = (size_t)fileSize.QuadPart;
+        if (size == 0) {
+            data = "";
+            return true;
+        }
+        mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!mapping)
+            return false;
+        data = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        return data != nullptr;
+#else
+        fd = ::open(path, O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat info;
+        if (fstat(fd, &info) != 0)
+            return false;
+        size = (size_t)info.st_size;
+        if (size == 0) {
+            data = "";
+            return true;
+        }
+        void* view = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (view == MAP_FAILED)
+            return false;
+        madvise(view, size, MADV_SEQUENTIAL);
+        data = (const char*)view;
+        return true;
+#endif
+    }
+
+    ~MappedFile() {
+#ifdef _WIN32
+        if (data && size > 0)
+            UnmapViewOfFile(data);
+        if (mapping)
+            CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE)
+            CloseHandle(file);
+#else
+        if (data && size > 0)
+            munmap((void*)data, size);
+        if (fd >= 0)
+            close(fd);
+#endif
+    }
+
+private:
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+#else
+    int fd = -1;
+#endif
+};
+
+// What the loaders hand back to Haxe, flat buffers ready to be copied into a MeshPart.
+struct LoadedMeshPart {
+    std::vector<float> vertices;
+    std::vector<float> uvs;
+    std::vector<unsigned> indices;
+    std::string texture;
+    bool hasColor = false;
+    uint32_t color = 0xFFFFFFFF;
+};
+
+struct LoadedMesh {
+    std::vector<LoadedMeshPart> parts;
+};
+
+std::unordered_map<int, LoadedMesh*> loadedMeshes;
+std::mutex loadedMeshMutex;
+int nextLoadedMeshID = 0;
+
+static int storeLoadedMesh(LoadedMesh* mesh) {
+    std::lock_guard<std::mutex> lock(loadedMeshMutex);
+    int id = nextLoadedMeshID++;
+    loadedMeshes[id] = mesh;
+    return id;
+}
+
+static LoadedMesh* getLoadedMesh(int id) {
+    std::lock_guard<std::mutex> lock(loadedMeshMutex);
+    auto it = loadedMeshes.find(id);
+    return it == loadedMeshes.end() ? nullptr : it->second;
+}
+
+static inline bool isBlank(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+static inline void skipBlanks(const char*& p, const char* end) {
+    while (p < end && isBlank(*p))
+        p++;
+}
+
+static inline const char* lineEnd(const char* p, const char* end) {
+    const char* found = (const char*)memchr(p, '\n', end - p);
+    return found ? found : end;
+}
+
+// Locale independent and a lot faster than strtof, good enough for mesh data.
+static inline float parseFloat(const char*& p, const char* end) {
+    skipBlanks(p, end);
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+'))
+        negative = *p++ == '-';
+    double value = 0.0;
+    while (p < end && *p >= '0' && *p <= '9')
+        value = value * 10.0 + (*p++ - '0');
+    if (p < end && *p == '.') {
+        p++;
+        double scale = 0.1;
+        while (p < end && *p >= '0' && *p <= '9') {
+            value += (*p++ - '0') * scale;
+            scale *= 0.1;
+        }
+    }
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        p++;
+        bool negativeExponent = false;
+        if (p < end && (*p == '-' || *p == '+'))
+            negativeExponent = *p++ == '-';
+        int exponent = 0;
+        while (p < end && *p >= '0' && *p <= '9')
+            exponent = exponent * 10 + (*p++ - '0');
+        value *= pow(10.0, negativeExponent ? -exponent : exponent);
+    }
+    return (float)(negative ? -value : value);
+}
+
+static inline bool parseInt(const char*& p, const char* end, int& out) {
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+'))
+        negative = *p++ == '-';
+    if (p >= end || *p < '0' || *p > '9')
+        return false;
+    int value = 0;
+    while (p < end && *p >= '0' && *p <= '9')
+        value = value * 10 + (*p++ - '0');
+    out = negative ? -value : value;
+    return true;
+}
+
+static inline std::string restOfLine(const char* p, const char* end) {
+    skipBlanks(p, end);
+    while (end > p && isBlank(end[-1]))
+        end--;
+    return std::string(p, end);
+}
+
+// Negative OBJ indices count back from the last element, which depends on everything parsed before this chunk,
+// so they're kept relative to the chunk and resolved once every chunk is done.
+struct OBJCorner {
+    int v, vt;
+    bool vRelative, vtRelative;
+};
+
+struct OBJEvent {
+    int triangle;
+    bool material;
+    std::string name;
+};
+
+struct OBJChunk {
+    const char* begin;
+    const char* end;
+    std::vector<float> positions;
+    std::vector<float> uvs;
+    std::vector<OBJCorner> corners;
+    std::vector<OBJEvent> events;
+    std::string mtllib;
+    int positionBase = 0;
+    int uvBase = 0;
+};
+
+static void parseOBJChunk(OBJChunk& chunk) {
+    std::vector<OBJCorner> face;
+    const char* p = chunk.begin;
+    while (p < chunk.end) {
+        const char* end = lineEnd(p, chunk.end);
+        skipBlanks(p, end);
+        if (p + 1 < end && p[0] == 'v' && isBlank(p[1])) {
+            p++;
+            for (int i = 0; i < 3; ++i)
+                chunk.positions.push_back(parseFloat(p, end));
+        } else if (p + 2 < end && p[0] == 'v' && p[1] == 't' && isBlank(p[2])) {
+            p += 2;
+            chunk.uvs.push_back(parseFloat(p, end));
+            chunk.uvs.push_back(parseFloat(p, end));
+        } else if (p + 1 < end && p[0] == 'f' && isBlank(p[1])) {
+            p++;
+            face.clear();
+            int positionCount = (int)chunk.positions.size() / 3;
+            int uvCount = (int)chunk.uvs.size() / 2;
+            while (true) {
+                skipBlanks(p, end);
+                OBJCorner corner = { 0, -1, false, false };
+                if (!parseInt(p, end, corner.v))
+                    break;
+                if (corner.v < 0) {
+                    corner.v += positionCount;
+                    corner.vRelative = true;
+                } else
+                    corner.v -= 1;
+                if (p < end && *p == '/') {
+                    p++;
+                    if (parseInt(p, end, corner.vt)) {
+                        if (corner.vt < 0) {
+                            corner.vt += uvCount;
+                            corner.vtRelative = true;
+                        } else
+                            corner.vt -= 1;
+                    } else
+                        corner.vt = -1;
+                    // normals aren't used yet
+                    if (p < end && *p == '/') {
+                        p++;
+                        int ignored;
+                        parseInt(p, end, ignored);
+                    }
+                }
+                face.push_back(corner);
+                while (p < end && !isBlank(*p))
+                    p++;
+            }
+            for (size_t i = 1; i + 1 < face.size(); ++i) {
+                chunk.corners.push_back(face[0]);
+                chunk.corners.push_back(face[i]);
+                chunk.corners.push_back(face[i + 1]);
+            }
+        } else if (end - p > 7 && strncmp(p, "usemtl", 6) == 0 && isBlank(p[6])) {
+            chunk.events.push_back({ (int)chunk.corners.size() / 3, true, restOfLine(p + 6, end) });
+        } else if (p + 1 < end && p[0] == 'o' && isBlank(p[1])) {
+            chunk.events.push_back({ (int)chunk.corners.size() / 3, false, restOfLine(p + 1, end) });
+        } else if (chunk.mtllib.empty() && end - p > 7 && strncmp(p, "mtllib", 6) == 0 && isBlank(p[6])) {
+            chunk.mtllib = restOfLine(p + 6, end);
+        }
+        p = end + 1;
+    }
+}
+
+struct OBJMaterial {
+    std::string texture;
+    bool hasColor = false;
+    uint32_t color = 0xFFFFFFFF;
+};
+
+static void parseMTL(const char* p, const char* end, const std::string& dir, std::unordered_map<std::string, OBJMaterial>& materials) {
+    OBJMaterial* current = nullptr;
+    while (p < end) {
+        const char* lineStop = lineEnd(p, end);
+        skipBlanks(p, lineStop);
+        if (lineStop - p > 7 && strncmp(p, "newmtl", 6) == 0 && isBlank(p[6])) {
+            current = &materials[restOfLine(p + 6, lineStop)];
+        } else if (current && lineStop - p > 7 && strncmp(p, "map_Kd", 6) == 0 && isBlank(p[6])) {
+            current->texture = dir + "/" + restOfLine(p + 6, lineStop);
+        } else if (current && p + 2 < lineStop && p[0] == 'K' && p[1] == 'd' && isBlank(p[2])) {
+            p += 2;
+            uint32_t color = 0xFF000000;
+            for (int shift = 16; shift >= 0; shift -= 8) {
+                float channel = std::min(1.0f, std::max(0.0f, parseFloat(p, lineStop)));
+                color |= (uint32_t)(channel * 255.0f + 0.5f) << shift;
+            }
+            current->hasColor = true;
+            current->color = color;
+        }
+        p = lineStop + 1;
+    }
+}
+
+// Merges identical position/uv pairs. The map is keyed on the two indices packed in one integer.
+static void buildOBJPart(LoadedMeshPart& part, const std::vector<const OBJCorner*>& triangles, const std::vector<float>& positions,
+    const std::vector<float>& uvs) {
+    size_t cornerCount = triangles.size() * 3;
+    size_t tableSize = 16;
+    while (tableSize < cornerCount * 2)
+        tableSize <<= 1;
+    std::vector<uint64_t> keys(tableSize, UINT64_MAX);
+    std::vector<unsigned> values(tableSize);
+
+    int positionCount = (int)positions.size() / 3;
+    int uvCount = (int)uvs.size() / 2;
+    part.indices.reserve(cornerCount);
+    for (const OBJCorner* triangle : triangles) {
+        bool valid = true;
+        for (int i = 0; i < 3; ++i)
+            valid = valid && triangle[i].v >= 0 && triangle[i].v < positionCount && triangle[i].vt < uvCount;
+        if (!valid)
+            continue;
+
+        for (int i = 0; i < 3; ++i) {
+            const OBJCorner& corner = triangle[i];
+            int vt = corner.vt < 0 ? -1 : corner.vt;
+            uint64_t key = ((uint64_t)(uint32_t)corner.v << 32) | (uint32_t)(vt + 1);
+            size_t slot = (size_t)((key * 0x9E3779B97F4A7C15ULL) >> 32) & (tableSize - 1);
+            while (keys[slot] != UINT64_MAX && keys[slot] != key)
+                slot = (slot + 1) & (tableSize - 1);
+            if (keys[slot] == UINT64_MAX) {
+                keys[slot] = key;
+                values[slot] = (unsigned)(part.vertices.size() / 3);
+                part.vertices.insert(part.vertices.end(), &positions[corner.v * 3], &positions[corner.v * 3] + 3);
+                part.uvs.push_back(vt >= 0 ? uvs[vt * 2] : 0.0f);
+                part.uvs.push_back(vt >= 0 ? uvs[vt * 2 + 1] : 0.0f);
+            }
+            part.indices.push_back(values[slot]);
+        }
+    }
+}
+
+// Parses OBJ data in parallel chunks. `dir` is where the mtllib and textures are looked up,
+// `mtlData` overrides reading the mtllib from disk when it isn't null.
+static LoadedMesh* parseOBJ(const char* data, size_t size, const std::string& dir, const char* mtlData, size_t mtlSize) {
+    WorkerPool& pool = WorkerPool::shared();
+    int chunkCount = (int)std::max<size_t>(1, std::min<size_t>((size_t)pool.size() * 4, size / (64 * 1024) + 1));
+    std::vector<OBJChunk> chunks(chunkCount);
+    const char* cursor = data;
+    const char* end = data + size;
+    for (int i = 0; i < chunkCount; ++i) {
+        chunks[i].begin = cursor;
+        const char* split = i == chunkCount - 1 ? end : std::max(cursor, data + size * (i + 1) / chunkCount);
+        split = split < end ? lineEnd(split, end) : end;
+        chunks[i].end = split;
+        cursor = split < end ? split + 1 : end;
+    }
+    pool.parallelFor(chunkCount, [&chunks](int i) { parseOBJChunk(chunks[i]); });
+
+    std::vector<float> positions, uvs;
+    size_t positionTotal = 0, uvTotal = 0;
+    for (OBJChunk& chunk : chunks) {
+        chunk.positionBase = (int)(positionTotal / 3);
+        chunk.uvBase = (int)(uvTotal / 2);
+        positionTotal += chunk.positions.size();
+        uvTotal += chunk.uvs.size();
+    }
+    positions.resize(positionTotal);
+    uvs.resize(uvTotal);
+    pool.parallelFor(chunkCount, [&](int i) {
+        OBJChunk& chunk = chunks[i];
+        if (!chunk.positions.empty())
+            memcpy(&positions[chunk.positionBase * 3], chunk.positions.data(), chunk.positions.size() * sizeof(float));
+        if (!chunk.uvs.empty())
+            memcpy(&uvs[chunk.uvBase * 2], chunk.uvs.data(), chunk.uvs.size() * sizeof(float));
+        for (OBJCorner& corner : chunk.corners) {
+            if (corner.vRelative)
+                corner.v += chunk.positionBase;
+            if (corner.vtRelative)
+                corner.vt += chunk.uvBase;
+        }
+    });
+
+    std::unordered_map<std::string, OBJMaterial> materials;
+    std::string mtllib;
+    for (OBJChunk& chunk : chunks)
+        if (mtllib.empty())
+            mtllib = chunk.mtllib;
+    if (mtlData)
+        parseMTL(mtlData, mtlData + mtlSize, dir, materials);
+    else if (!mtllib.empty()) {
+        MappedFile mtl;
+        if (mtl.open((dir + "/" + mtllib).c_str()))
+            parseMTL(mtl.data, mtl.data + mtl.size, dir, materials);
+    }
+
+    // a new part starts at every usemtl and o, parts without triangles are dropped
+    std::vector<std::vector<const OBJCorner*>> partTriangles(1);
+    std::vector<std::string> partMaterials(1);
+    std::string material;
+    for (OBJChunk& chunk : chunks) {
+        size_t event = 0;
+        int triangleCount = (int)chunk.corners.size() / 3;
+        for (int t = 0; t <= triangleCount; ++t) {
+            while (event < chunk.events.size() && chunk.events[event].triangle == t) {
+                if (chunk.events[event].material)
+                    material = chunk.events[event].name;
+                if (!partTriangles.back().empty()) {
+                    partTriangles.emplace_back();
+                    partMaterials.emplace_back();
+                }
+                partMaterials.back() = material;
+                event++;
+            }
+            if (t < triangleCount)
+                partTriangles.back().push_back(&chunk.corners[t * 3]);
+        }
+    }
+    if (partTriangles.back().empty()) {
+        partTriangles.pop_back();
+        partMaterials.pop_back();
+    }
+
+    LoadedMesh* mesh = new LoadedMesh();
+    mesh->parts.resize(partTriangles.size());
+    pool.parallelFor((int)partTriangles.size(), [&](int i) {
+        LoadedMeshPart& part = mesh->parts[i];
+        buildOBJPart(part, partTriangles[i], positions, uvs);
+        auto found = materials.find(partMaterials[i]);
+        if (found != materials.end()) {
+            part.texture = found->second.texture;
+            part.hasColor = found->second.hasColor;
+            part.color = found->second.color;
+        }
+    });
+    return mesh;
+}
+
+static std::string directoryOf(const std::string& path) {
+    size_t slash = path.find_last_of("/\\");
+    return slash == std::string::npos ? "." : path.substr(0, slash);
+}
+
+extern "C" int loadOBJFile(const char* path) {
+    MappedFile file;
+    if (!file.open(path))
+        return -1;
+    return storeLoadedMesh(parseOBJ(file.data, file.size, directoryOf(path), nullptr, 0));
+}
+
+extern "C" int loadOBJData(const char* objData, const char* mtlData, const char* dir) {
+    return storeLoadedMesh(parseOBJ(objData, strlen(objData), dir, mtlData, mtlData ? strlen(mtlData) : 0));
+}
+
+extern "C" int getLoadedPartCount(int id) {
+    LoadedMesh* mesh = getLoadedMesh(id);
+    return mesh ? (int)mesh->parts.size() : 0;
+}
+
+// Writes vertex count, index count, whether the part has a color and the ARGB color as int32.
+extern "C" void getLoadedPartInfo(int id, int part, int* out) {
+    LoadedMesh* mesh = getLoadedMesh(id);
+    if (!mesh || part < 0 || part >= (int)mesh->parts.size())
+        return;
+    const LoadedMeshPart& p = mesh->parts[part];
+    out[0] = (int)(p.vertices.size() / 3);
+    out[1] = (int)p.indices.size();
+    out[2] = p.hasColor ? 1 : 0;
+    out[3] = (int)p.color;
+}
+
+extern "C" const std::string* getLoadedPartTexture(int id, int part) {
+    LoadedMesh* mesh = getLoadedMesh(id);
+    if (!mesh || part < 0 || part >= (int)mesh->parts.size())
+        return nullptr;
+    return &mesh->parts[part].texture;
+}
+
+// Copies a part into buffers sized from getLoadedPartInfo, uvs get 2 floats per vertex.
+extern "C" void copyLoadedPart(int id, int part, float* vertices, float* uvs, unsigned* indices) {
+    LoadedMesh* mesh = getLoadedMesh(id);
+    if (!mesh || part < 0 || part >= (int)mesh->parts.size())
+        return;
+    const LoadedMeshPart& p = mesh->parts[part];
+    if (!p.vertices.empty())
+        memcpy(vertices, p.vertices.data(), p.vertices.size() * sizeof(float));
+    if (!p.uvs.empty())
+        memcpy(uvs, p.uvs.data(), p.uvs.size() * sizeof(float));
+    if (!p.indices.empty())
+        memcpy(indices, p.indices.data(), p.indices.size() * sizeof(unsigned));
+}
+
+extern "C" void freeLoadedMesh(int id) {
+    std::lock_guard<std::mutex> lock(loadedMeshMutex);
+    auto it = loadedMeshes.find(id);
+    if (it != loadedMeshes.end()) {
+        delete it->second;
+        loadedMeshes.erase(it);
+    }
+}
+
+//--------- .nmesh ---------//
+// Binary mesh format, written by `nebula.mesh.savers.NMeshSaver`. Everything is little endian.
+// Streams are 16 byte aligned, the loader wraps them in place (the raytracer copies them on upload).
+static const uint32_t NMESH_VERSION = 1;
+static const uint32_t NMESH_HAS_NORMALS = 1;
+static const uint32_t NMESH_HAS_BOUNDS = 2;
+static const uint32_t NMESH_HAS_COLOR = 4;
+static const int NMESH_BOUNDS_FLOATS = 13;
+
+#pragma pack(push, 1)
+struct NMeshHeader {
+    char magic[4]; // "NMSH"
+    uint32_t version;
+    uint32_t partCount;
+    uint32_t reserved;
+    uint64_t partTableOffset;
+    uint64_t fileSize;
+};
+
+struct NMeshPartEntry {
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t uvCount;
+    uint32_t flags;
+    uint64_t positionOffset;
+    uint64_t normalOffset;
+    uint64_t uvOffset;
+    uint64_t indexOffset;
+    // min xyz, max xyz, center xyz, radius, centroid xyz
+    uint64_t boundsOffset;
+    uint64_t graphicOffset;
+    uint32_t graphicLength;
+    uint32_t color;
+};
+#pragma pack(pop)
+
+struct NMeshFile {
+    // either mapped from disk or copied from memory
+    MappedFile file;
+    std::vector<char> owned;
+    const char* data = nullptr;
+    size_t size = 0;
+    const NMeshHeader* header = nullptr;
+    const NMeshPartEntry* parts = nullptr;
+};
+
+std::unordered_map<int, NMeshFile*> nmeshFiles;
+int nextNMeshID = 0;
+
+static bool streamInFile(const NMeshFile* mesh, uint64_t offset, uint64_t size) {
+    return offset % 4 == 0 && offset <= mesh->size && size <= mesh->size - offset;
+}
+
+static bool validateNMesh(NMeshFile* mesh) {
+    if (mesh->size < sizeof(NMeshHeader))
+        return false;
+    mesh->header = (const NMeshHeader*)mesh->data;
+    const NMeshHeader* header = mesh->header;
+    if (memcmp(header->magic, "NMSH", 4) != 0 || header->version != NMESH_VERSION || header->fileSize != mesh->size)
+        return false;
+    if (!streamInFile(mesh, header->partTableOffset, (uint64_t)header->partCount * sizeof(NMeshPartEntry)))
+        return false;
+    mesh->parts = (const NMeshPartEntry*)(mesh->data + header->partTableOffset);
+    for (uint32_t i = 0; i < header->partCount; ++i) {
+        const NMeshPartEntry& part = mesh->parts[i];
+        bool valid = streamInFile(mesh, part.positionOffset, (uint64_t)part.vertexCount * 12)
+            && streamInFile(mesh, part.uvOffset, (uint64_t)part.uvCount * 4)
+            && streamInFile(mesh, part.indexOffset, (uint64_t)part.indexCount * 4)
+            && (part.graphicLength == 0 || (part.graphicOffset <= mesh->size && part.graphicLength <= mesh->size - part.graphicOffset))
+            && (!(part.flags & NMESH_HAS_NORMALS) || streamInFile(mesh, part.normalOffset, (uint64_t)part.vertexCount * 12))
+            && (!(part.flags & NMESH_HAS_BOUNDS) || streamInFile(mesh, part.boundsOffset, NMESH_BOUNDS_FLOATS * 4));
+        if (!valid)
+            return false;
+        // the tracer reads the vertices in place, an out of range index would read outside the file
+        const unsigned* indices = (const unsigned*)(mesh->data + part.indexOffset);
+        for (uint32_t j = 0; j < part.indexCount; ++j)
+            if (indices[j] >= part.vertexCount)
+                return false;
+    }
+    return true;
+}
+
+static int storeNMesh(NMeshFile* mesh) {
+    if (!validateNMesh(mesh)) {
+        delete mesh;
+        return -1;
+    }
+    std::lock_guard<std::mutex> lock(loadedMeshMutex);
+    int id = nextNMeshID++;
+    nmeshFiles[id] = mesh;
+    return id;
+}
+
+// The file stays mapped until closeNMesh, every stream handed out points into the mapping.
+extern "C" int openNMesh(const char* path) {
+    NMeshFile* mesh = new NMeshFile();
+    if (!mesh->file.open(path)) {
+        delete mesh;
+        return -1;
+    }
+    mesh->data = mesh->file.data;
+    mesh->size = mesh->file.size;
+    return storeNMesh(mesh);
+}
+
+// Same as openNMesh for data that's already in memory, it gets copied (into 16 byte aligned memory).
+extern "C" int openNMeshData(const char* data, int size) {
+    NMeshFile* mesh = new NMeshFile();
+    mesh->owned.resize((size_t)size + 16);
+    size_t misalignment = (size_t)mesh->owned.data() % 16;
+    char* aligned = mesh->owned.data() + (misalignment ? 16 - misalignment : 0);
+    memcpy(aligned, data, size);
+    mesh->data = aligned;
+    mesh->size = (size_t)size;
+    return storeNMesh(mesh);
+}
+
+static const NMeshPartEntry* getNMeshPart(int id, int part) {
+    std::lock_guard<std::mutex> lock(loadedMeshMutex);
+    auto it = nmeshFiles.find(id);
+    if (it == nmeshFiles.end() || part < 0 || (uint32_t)part >= it->second->header->partCount)
+        return nullptr;
+    return &it->second->parts[part];
+}
+
+static const char* getNMeshData(int id) {
+    std::lock_guard<std::mutex> lock(loadedMeshMutex);
+    auto it = nmeshFiles.find(id);
+    return it == nmeshFiles.end() ? nullptr : it->second->data;
+}
+
+extern "C" int getNMeshPartCount(int id) {
+    std::lock_guard<std::mutex> lock(loadedMeshMutex);
+    auto it = nmeshFiles.find(id);
+    return it == nmeshFiles.end() ? 0 : (int)it->second->header->partCount;
+}
+
+// Writes vertex count, index count, uv count, flags and color as int32, then the bounds block as float32 when present.
+extern "C" void getNMeshPartInfo(int id, int part, int* out) {
+    const NMeshPartEntry* entry = getNMeshPart(id, part);
+    if (!entry)
+        return;
+    out[0] = (int)entry->vertexCount;
+    out[1] = (int)entry->indexCount;
+    out[2] = (int)entry->uvCount;
+    out[3] = (int)entry->flags;
+    out[4] = (int)entry->color;
+    if (entry->flags & NMESH_HAS_BOUNDS)
+        memcpy(out + 5, getNMeshData(id) + entry->boundsOffset, NMESH_BOUNDS_FLOATS * 4);
+}
+
+// 0 positions, 1 normals, 2 uvs, 3 indices. Returns a pointer into the mapped file.
+extern "C" const char* getNMeshStream(int id, int part, int stream) {
+    const NMeshPartEntry* entry = getNMeshPart(id, part);
+    if (!entry)
+        return nullptr;
+    const char* data = getNMeshData(id);
+    switch (stream) {
+        case 0: return data + entry->positionOffset;
+        case 1: return entry->flags & NMESH_HAS_NORMALS ? data + entry->normalOffset : nullptr;
+        case 2: return data + entry->uvOffset;
+        case 3: return data + entry->indexOffset;
+        default: return nullptr;
+    }
+}
+
+static std::string getNMeshGraphic(int id, int part) {
+    const NMeshPartEntry* entry = getNMeshPart(id, part);
+    if (!entry || entry->graphicLength == 0)
+        return "";
+    return std::string(getNMeshData(id) + entry->graphicOffset, entry->graphicLength);
+}
+
+extern "C" void closeNMesh(int id) {
+    std::lock_guard<std::mutex> lock(loadedMeshMutex);
+    auto it = nmeshFiles.find(id);
+    if (it != nmeshFiles.end()) {
+        delete it->second;
+        nmeshFiles.erase(it);
+    }
+}
+
+//--------- Mesh optimization ---------//
+// Import time cleanup of a mesh part: welds vertices, drops zero area triangles and reorders triangles and vertices
+// so the rasterizer and Embree's BVH builder read memory mostly in order.
+static const int VERTEX_CACHE_SIZE = 32;
+static const float WELD_ATTRIBUTE_EPSILON = 1e-5f;
+
+struct WeldGrid {
+    std::vector<uint64_t> keys;
+    std::vector<int> heads;
+    size_t mask = 0;
+
+    explicit WeldGrid(int vertexCount) {
+        size_t tableSize = 16;
+        while (tableSize < (size_t)vertexCount * 2)
+            tableSize <<= 1;
+        keys.assign(tableSize, UINT64_MAX);
+        heads.assign(tableSize, -1);
+        mask = tableSize - 1;
+    }
+
+    // 21 bits per axis, cells that wrap onto each other only cost an extra comparison
+    static uint64_t cellKey(int64_t x, int64_t y, int64_t z) {
+        return ((uint64_t)(x & 0x1FFFFF) << 42) | ((uint64_t)(y & 0x1FFFFF) << 21) | (uint64_t)(z & 0x1FFFFF);
+    }
+
+    size_t slot(uint64_t key) const {
+        size_t slot = (size_t)((key * 0x9E3779B97F4A7C15ULL) >> 32) & mask;
+        while (keys[slot] != UINT64_MAX && keys[slot] != key)
+            slot = (slot + 1) & mask;
+        return slot;
+    }
+
+    int find(uint64_t key) const {
+        return heads[slot(key)];
+    }
+
+    // at most one cell per vertex is ever inserted, so the table never fills up
+    void insert(uint64_t key, int v, std::vector<int>& next) {
+        size_t s = slot(key);
+        keys[s] = key;
+        next[v] = heads[s];
+        heads[s] = v;
+    }
+};
+
+static float vertexCacheScore(int cachePosition, int trianglesLeft) {
+    if (trianglesLeft == 0)
+        return -1.0f;
+    float score = 0.0f;
+    if (cachePosition >= 0) {
+        // the last triangle's vertices score a bit lower so strips don't keep going back and forth
+        if (cachePosition < 3)
+            score = 0.75f;
+        else
+            score = powf(1.0f - (cachePosition - 3) * (1.0f / (VERTEX_CACHE_SIZE - 3)), 1.5f);
+    }
+    // favour vertices with few triangles left so they get finished and leave the cache
+    return score + 2.0f * powf((float)trianglesLeft, -0.5f);
+}
+
+// Tom Forsyth's linear speed vertex cache optimisation. Triangles must not repeat a vertex.
+static std::vector<unsigned> reorderForVertexCache(const std::vector<unsigned>& indices, int vertexCount) {
+    int triangleCount = (int)indices.size() / 3;
+    std::vector<int> trianglesLeft(vertexCount, 0);
+    for (unsigned index : indices)
+        trianglesLeft[index]++;
+
+    std::vector<int> adjacencyStart(vertexCount + 1, 0);
+    for (int v = 0; v < vertexCount; ++v)
+        adjacencyStart[v + 1] = adjacencyStart[v] + trianglesLeft[v];
+    std::vector<int> adjacency(indices.size());
+    std::vector<int> fill(adjacencyStart.begin(), adjacencyStart.end() - 1);
+    for (int t = 0; t < triangleCount; ++t)
+        for (int i = 0; i < 3; ++i)
+            adjacency[fill[indices[t * 3 + i]]++] = t;
+
+    std::vector<int> cachePosition(vertexCount, -1);
+    std::vector<float> vertexScore(vertexCount);
+    for (int v = 0; v < vertexCount; ++v)
+        vertexScore[v] = vertexCacheScore(-1, trianglesLeft[v]);
+
+    std::vector<char> emitted(triangleCount, 0);
+    std::vector<unsigned> out;
+    out.reserve(indices.size());
+    unsigned cache[VERTEX_CACHE_SIZE + 3];
+    unsigned nextCache[VERTEX_CACHE_SIZE + 3];
+    int cacheSize = 0;
+    int best = -1;
+    int cursor = 0;
+    for (int done = 0; done < triangleCount; ++done) {
+        if (best < 0) {
+            // nothing in the cache touches a remaining triangle, carry on from the next one in order
+            while (emitted[cursor])
+                cursor++;
+            best = cursor;
+        }
+        const unsigned* tri = &indices[best * 3];
+        emitted[best] = 1;
+        out.insert(out.end(), tri, tri + 3);
+
+        for (int i = 0; i < 3; ++i) {
+            unsigned v = tri[i];
+            int start = adjacencyStart[v];
+            int last = start + --trianglesLeft[v];
+            for (int j = start; j <= last; ++j) {
+                if (adjacency[j] == best) {
+                    std::swap(adjacency[j], adjacency[last]);
+                    break;
+                }
+            }
+        }
+
+        int nextSize = 0;
+        for (int i = 0; i < 3; ++i)
+            nextCache[nextSize++] = tri[i];
+        for (int i = 0; i < cacheSize; ++i)
+            if (cache[i] != tri[0] && cache[i] != tri[1] && cache[i] != tri[2])
+                nextCache[nextSize++] = cache[i];
+
+        for (int i = 0; i < nextSize; ++i) {
+            unsigned v = nextCache[i];
+            cachePosition[v] = i < VERTEX_CACHE_SIZE ? i : -1;
+            vertexScore[v] = vertexCacheScore(cachePosition[v], trianglesLeft[v]);
+        }
+
+        // only triangles around the cache changed score, the best one is among them
+        best = -1;
+        float bestScore = -1.0f;
+        for (int i = 0; i < std::min(nextSize, VERTEX_CACHE_SIZE); ++i) {
+            unsigned v = nextCache[i];
+            for (int j = adjacencyStart[v]; j < adjacencyStart[v] + trianglesLeft[v]; ++j) {
+                int t = adjacency[j];
+                float score = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+                if (score > bestScore) {
+                    bestScore = score;
+                    best = t;
+                }
+            }
+        }
+        cacheSize = std::min(nextSize, VERTEX_CACHE_SIZE);
+        memcpy(cache, nextCache, cacheSize * sizeof(unsigned));
+    }
+    return out;
+}
+
+// Welds vertices whose positions are within `tolerance` (0 only welds exact copies) and whose normals and uvs match,
+// so texture and shading seams survive. Triangles left with a repeated vertex or no area are dropped,
+// then triangles are reordered for the vertex cache and vertices stored in the order they're first used (unused ones go away).
+// `normals` and `uvs` may be null, missing uvs read as 0 like projectMeshPart does.
+// Outputs must be as large as the inputs (uvs at least vertexCount * 2), outCounts gets the vertex, index and uv counts.
+extern "C" void optimizeMeshPart(const float* positions, const float* normals, const float* uvs, int uvCount, int vertexCount,
+    const unsigned* indices, int indexCount, float tolerance, float* outPositions, float* outNormals, float* outUvs,
+    unsigned* outIndices, int* outCounts) {
+    auto uvAt = [&](int v, int i) { return v * 2 + i < uvCount ? uvs[v * 2 + i] : 0.0f; };
+    auto sameAttributes = [&](int a, int b) {
+        float epsilon = tolerance > 0.0f ? WELD_ATTRIBUTE_EPSILON : 0.0f;
+        for (int i = 0; i < 2; ++i)
+            if (uvs && fabsf(uvAt(a, i) - uvAt(b, i)) > epsilon)
+                return false;
+        for (int i = 0; i < 3; ++i)
+            if (normals && fabsf(normals[a * 3 + i] - normals[b * 3 + i]) > epsilon)
+                return false;
+        return true;
+    };
+
+    // weld against the vertices already kept in the surrounding grid cells
+    std::vector<unsigned> remap(vertexCount);
+    std::vector<int> next(vertexCount, -1);
+    WeldGrid grid(vertexCount);
+    double cellSize = tolerance > 0.0f ? (double)tolerance : 1.0;
+    int reach = tolerance > 0.0f ? 1 : 0;
+    for (int v = 0; v < vertexCount; ++v) {
+        const float* p = &positions[v * 3];
+        remap[v] = (unsigned)v;
+        if (!std::isfinite(p[0]) || !std::isfinite(p[1]) || !std::isfinite(p[2]))
+            continue;
+        int64_t cell[3];
+        for (int i = 0; i < 3; ++i)
+            cell[i] = (int64_t)std::clamp(std::floor(p[i] / cellSize), -1e15, 1e15);
+
+        int found = -1;
+        for (int dx = -reach; dx <= reach && found < 0; ++dx)
+            for (int dy = -reach; dy <= reach && found < 0; ++dy)
+                for (int dz = -reach; dz <= reach && found < 0; ++dz)
+                    for (int other = grid.find(WeldGrid::cellKey(cell[0] + dx, cell[1] + dy, cell[2] + dz)); other >= 0; other = next[other]) {
+                        const float* q = &positions[other * 3];
+                        if (fabsf(p[0] - q[0]) <= tolerance && fabsf(p[1] - q[1]) <= tolerance && fabsf(p[2] - q[2]) <= tolerance
+                            && sameAttributes(v, other)) {
+                            found = other;
+                            break;
+                        }
+                    }
+        if (found >= 0) {
+            remap[v] = (unsigned)found;
+            continue;
+        }
+        grid.insert(WeldGrid::cellKey(cell[0], cell[1], cell[2]), v, next);
+    }
 
-std::unordered_map<int, RaytracerInstance*> raytracers;
-std::mutex raytracerMutex;
-int nextID = 0;
+    double minCross = (double)tolerance * tolerance;
+    std::vector<unsigned> triangles;
+    triangles.reserve(indexCount);
+    for (int t = 0; t + 2 < indexCount; t += 3) {
+        if (indices[t] >= (unsigned)vertexCount || indices[t + 1] >= (unsigned)vertexCount || indices[t + 2] >= (unsigned)vertexCount)
+            continue;
+        unsigned a = remap[indices[t]], b = remap[indices[t + 1]], c = remap[indices[t + 2]];
+        if (a == b || b == c || a == c)
+            continue;
+        const float* pa = &positions[a * 3];
+        const float* pb = &positions[b * 3];
+        const float* pc = &positions[c * 3];
+        double ab[3] = { (double)pb[0] - pa[0], (double)pb[1] - pa[1], (double)pb[2] - pa[2] };
+        double ac[3] = { (double)pc[0] - pa[0], (double)pc[1] - pa[1], (double)pc[2] - pa[2] };
+        double cross[3] = { ab[1] * ac[2] - ab[2] * ac[1], ab[2] * ac[0] - ab[0] * ac[2], ab[0] * ac[1] - ab[1] * ac[0] };
+        // twice the area, so with a tolerance anything thinner than a tolerance sized sliver goes too
+        if (cross[0] * cross[0] + cross[1] * cross[1] + cross[2] * cross[2] <= minCross * minCross)
+            continue;
+        triangles.push_back(a);
+        triangles.push_back(b);
+        triangles.push_back(c);
+    }
 
-extern "C" void createRaytracer() {
-    std::lock_guard<std::mutex> lock(raytracerMutex);
-    int id = nextID++;
-    raytracers[id] = new RaytracerInstance();
-}
+    std::vector<unsigned> ordered = reorderForVertexCache(triangles, vertexCount);
 
-extern "C" void disposeRaytracer(int id) {
-    std::lock_guard<std::mutex> lock(raytracerMutex);
-    if (raytracers.count(id)) {
-        delete raytracers[id];
-        raytracers.erase(id);
+    std::vector<int> newIndex(vertexCount, -1);
+    int written = 0;
+    for (size_t i = 0; i < ordered.size(); ++i) {
+        unsigned v = ordered[i];
+        if (newIndex[v] < 0) {
+            newIndex[v] = written;
+            memcpy(&outPositions[written * 3], &positions[v * 3], 12);
+            if (normals)
+                memcpy(&outNormals[written * 3], &normals[v * 3], 12);
+            if (uvs) {
+                outUvs[written * 2] = uvAt((int)v, 0);
+                outUvs[written * 2 + 1] = uvAt((int)v, 1);
+            }
+            written++;
+        }
+        outIndices[i] = (unsigned)newIndex[v];
     }
+    outCounts[0] = written;
+    outCounts[1] = (int)ordered.size();
+    outCounts[2] = uvs ? written * 2 : 0;
 }
 
-extern "C" void buildBVH(int id) {
-    std::lock_guard<std::mutex> lock(raytracerMutex);
-    if (raytracers.count(id)) {
-        rtcSetSceneFlags(raytracers[id]->scene, RTC_SCENE_FLAG_DYNAMIC | RTC_SCENE_FLAG_ROBUST);
-        rtcCommitScene(raytracers[id]->scene);
+//--------- Mesh simplification ---------//
+// Quadric error edge collapses (Garland & Heckbert). A vertex only ever collapses onto one of its neighbours,
+// so a simplified part is just a new index buffer over the same vertices and its uvs and normals stay valid.
+struct Quadric {
+    // error(p) = p·A·p + 2·b·p + c, summed over the (area weighted) planes of the triangles around a vertex
+    double a00 = 0, a01 = 0, a02 = 0, a11 = 0, a12 = 0, a22 = 0;
+    double b0 = 0, b1 = 0, b2 = 0, c = 0;
+    double weight = 0;
+
+    void add(const Quadric& q) {
+        a00 += q.a00; a01 += q.a01; a02 += q.a02; a11 += q.a11; a12 += q.a12; a22 += q.a22;
+        b0 += q.b0; b1 += q.b1; b2 += q.b2; c += q.c;
+        weight += q.weight;
     }
-}
 
-// Embree has no refitting... :(
-extern "C" void refitBVH(int id) {
-    buildBVH(id);
+    double error(const float* p) const {
+        double x = p[0], y = p[1], z = p[2];
+        double e = a00 * x * x + a11 * y * y + a22 * z * z + 2 * (a01 * x * y + a02 * x * z + a12 * y * z)
+            + 2 * (b0 * x + b1 * y + b2 * z) + c;
+        return e > 0 ? e : 0;
+    }
+};
+
+static Quadric planeQuadric(const float* p0, const float* p1, const float* p2) {
+    double e1[3] = { (double)p1[0] - p0[0], (double)p1[1] - p0[1], (double)p1[2] - p0[2] };
+    double e2[3] = { (double)p2[0] - p0[0], (double)p2[1] - p0[1], (double)p2[2] - p0[2] };
+    double n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+    double length = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+    Quadric q;
+    if (length == 0)
+        return q;
+    n[0] /= length; n[1] /= length; n[2] /= length;
+    double d = -(n[0] * p0[0] + n[1] * p0[1] + n[2] * p0[2]);
+    double w = length * 0.5;
+    q.a00 = w * n[0] * n[0]; q.a01 = w * n[0] * n[1]; q.a02 = w * n[0] * n[2];
+    q.a11 = w * n[1] * n[1]; q.a12 = w * n[1] * n[2]; q.a22 = w * n[2] * n[2];
+    q.b0 = w * n[0] * d; q.b1 = w * n[1] * d; q.b2 = w * n[2] * d;
+    q.c = w * d * d;
+    q.weight = w;
+    return q;
 }
 
-extern "C" void rebuildBVH(int id) {
-    buildBVH(id);
+static void triangleNormal(const float* a, const float* b, const float* c, double* n) {
+    double e1[3] = { (double)b[0] - a[0], (double)b[1] - a[1], (double)b[2] - a[2] };
+    double e2[3] = { (double)c[0] - a[0], (double)c[1] - a[1], (double)c[2] - a[2] };
+    n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+    n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+    n[2] = e1[0] * e2[1] - e1[1] * e2[0];
 }
 
-extern "C" HitResult traceRay(int id, SimpleRay* ray) {
-    std::lock_guard<std::mutex> lock(raytracerMutex);
-    HitResult result = {};
-    RaytracerInstance* instance = raytracers[id];
+// Simplifies until at most targetIndexCount indices are left or the next collapse would move the surface more than maxError.
+// Vertices on open borders and on uv/normal seams (several vertices at one position) are never moved, so meshes don't tear.
+// Writes the new indices into outIndices (as large as indices) and returns how many there are, outError gets the
+// largest distance any collapse moved the surface by.
+extern "C" int simplifyMesh(const float* positions, int vertexCount, const unsigned* indices, int indexCount, int targetIndexCount,
+    float maxError, unsigned* outIndices, float* outError) {
+    std::vector<unsigned> triangles;
+    triangles.reserve(indexCount);
+    for (int i = 0; i + 2 < indexCount; i += 3) {
+        unsigned a = indices[i], b = indices[i + 1], c = indices[i + 2];
+        if (a < (unsigned)vertexCount && b < (unsigned)vertexCount && c < (unsigned)vertexCount && a != b && b != c && a != c)
+            triangles.insert(triangles.end(), { a, b, c });
+    }
 
-    RTCRayHit rayhit = {};
-    rayhit.ray = {};
-    rayhit.hit = {};
-    rayhit.ray.org_x = ray->posx;
-    rayhit.ray.org_y = ray->posy;
-    rayhit.ray.org_z = ray->posz;
-    rayhit.ray.dir_x = ray->dirx;
-    rayhit.ray.dir_y = ray->diry;
-    rayhit.ray.dir_z = ray->dirz;
-    rayhit.ray.tnear = 0.0f;
-    rayhit.ray.tfar = INFINITY;
-    rayhit.ray.time = 0.0f;
-    rayhit.ray.mask = -1;
-    rayhit.ray.id = 0;
-    rayhit.ray.flags = 0;
-    rayhit.hit.geomID = RTC_INVALID_GEOMETRY_ID;
-    rayhit.hit.primID = RTC_INVALID_GEOMETRY_ID;
-    rayhit.hit.instID[0] = RTC_INVALID_GEOMETRY_ID;
-    rtcIntersect1(instance->scene, &rayhit);
-	result.distance = rayhit.ray.tfar;
-	result.hit = rayhit.hit.geomID != RTC_INVALID_GEOMETRY_ID;
-	result.geomID = rayhit.hit.geomID;
-	result.primID = rayhit.hit.primID;
-    return result;
-}
+    // vertices sharing a position are seams, the first one stands for the position when looking for borders
+    std::vector<unsigned> position(vertexCount);
+    std::vector<char> locked(vertexCount, 0);
+    {
+        std::unordered_map<uint64_t, std::vector<unsigned>> byHash;
+        byHash.reserve(vertexCount);
+        for (int v = 0; v < vertexCount; ++v) {
+            const float* p = &positions[v * 3];
+            uint32_t bits[3];
+            memcpy(bits, p, 12);
+            uint64_t hash = ((uint64_t)bits[0] * 73856093ULL) ^ ((uint64_t)bits[1] * 19349663ULL << 16) ^ ((uint64_t)bits[2] * 83492791ULL << 32);
+            std::vector<unsigned>& bucket = byHash[hash];
+            position[v] = (unsigned)v;
+            for (unsigned other : bucket) {
+                if (memcmp(&positions[other * 3], p, 12) == 0) {
+                    position[v] = other;
+                    locked[v] = locked[other] = 1;
+                    break;
+                }
+            }
+            if (position[v] == (unsigned)v)
+                bucket.push_back((unsigned)v);
+        }
 
-void loadGeometry(const char* json, int id) {
-    JSON_Value* rootVal = json_parse_string(json);
-    JSON_Object* rootObj = json_value_get_object(rootVal);
-    JSON_Array* geometryArr = json_object_get_array(rootObj, "geometry");
-    RaytracerInstance* raytracer = raytracers[id];
-	RTCDevice device = raytracer->device;
-	RTCScene scene = raytracer->scene;
+        // an edge only one triangle uses is on a border
+        std::unordered_map<uint64_t, int> edgeUses;
+        edgeUses.reserve(triangles.size());
+        auto edgeKey = [&](unsigned a, unsigned b) {
+            a = position[a];
+            b = position[b];
+            return a < b ? ((uint64_t)a << 32) | b : ((uint64_t)b << 32) | a;
+        };
+        for (size_t t = 0; t < triangles.size(); t += 3)
+            for (int i = 0; i < 3; ++i)
+                edgeUses[edgeKey(triangles[t + i], triangles[t + (i + 1) % 3])]++;
+        for (size_t t = 0; t < triangles.size(); t += 3)
+            for (int i = 0; i < 3; ++i)
+                if (edgeUses[edgeKey(triangles[t + i], triangles[t + (i + 1) % 3])] == 1)
+                    locked[triangles[t + i]] = locked[triangles[t + (i + 1) % 3]] = 1;
+        for (int v = 0; v < vertexCount; ++v)
+            if (locked[v])
+                locked[position[v]] = 1;
+        for (int v = 0; v < vertexCount; ++v)
+            locked[v] = locked[v] || locked[position[v]];
+    }
 
-    rtcReleaseScene(scene);
-    raytracer->scene = rtcNewScene(device);
-    scene = raytracer->scene;
-    rtcSetSceneFlags(scene, RTC_SCENE_FLAG_DYNAMIC | RTC_SCENE_FLAG_ROBUST);
-   
-    for (size_t i = 0; i < json_array_get_count(geometryArr); ++i) {
-        JSON_Object* meshObj = json_array_get_object(geometryArr, i);
-        JSON_Array* parts = json_object_get_array(meshObj, "meshParts");
+    std::vector<Quadric> quadrics(vertexCount);
+    for (size_t t = 0; t < triangles.size(); t += 3) {
+        Quadric q = planeQuadric(&positions[triangles[t] * 3], &positions[triangles[t + 1] * 3], &positions[triangles[t + 2] * 3]);
+        for (int i = 0; i < 3; ++i)
+            quadrics[triangles[t + i]].add(q);
+    }
 
-        for (size_t j = 0; j < json_array_get_count(parts); ++j) {
-            JSON_Object* part = json_array_get_object(parts, j);
-            JSON_Array* indices = json_object_get_array(part, "indices");
-            JSON_Array* vertices = json_object_get_array(part, "vertices");
+    // squared distance of the surface to p, averaged over the planes the two quadrics stand for
+    auto collapseError = [&](unsigned from, unsigned to) {
+        Quadric q = quadrics[from];
+        q.add(quadrics[to]);
+        return q.weight > 0 ? q.error(&positions[to * 3]) / q.weight : 0.0;
+    };
 
-            size_t indexCount = json_array_get_count(indices);
-            size_t vertexCount = json_array_get_count(vertices);
+    double maxErrorSq = (double)maxError * maxError;
+    double resultErrorSq = 0;
+    std::vector<unsigned> remap(vertexCount);
+    std::vector<char> touched(vertexCount);
+    std::vector<int> adjacencyStart(vertexCount + 1);
+    std::vector<int> adjacency;
+    std::vector<unsigned> bestTarget(vertexCount);
+    std::vector<double> bestError(vertexCount);
+    std::vector<unsigned> candidates;
 
-            unsigned* inds = new unsigned[indexCount];
-            float* verts = new float[vertexCount];
+    while ((int)triangles.size() > targetIndexCount) {
+        std::fill(adjacencyStart.begin(), adjacencyStart.end(), 0);
+        for (unsigned v : triangles)
+            adjacencyStart[v + 1]++;
+        for (int v = 0; v < vertexCount; ++v)
+            adjacencyStart[v + 1] += adjacencyStart[v];
+        adjacency.resize(triangles.size());
+        std::vector<int> fill(adjacencyStart.begin(), adjacencyStart.end() - 1);
+        for (size_t i = 0; i < triangles.size(); ++i)
+            adjacency[fill[triangles[i]]++] = (int)(i / 3);
 
-            for (size_t k = 0; k < indexCount; ++k)
-                inds[k] = (unsigned)json_array_get_number(indices, k);
-            for (size_t i = 0; i < vertexCount; ++i) {
-                verts[i] = (float)json_array_get_number(vertices, i);
+        // the cheapest edge out of every movable vertex
+        candidates.clear();
+        std::fill(bestError.begin(), bestError.end(), -1.0);
+        for (size_t t = 0; t < triangles.size(); t += 3) {
+            for (int i = 0; i < 3; ++i) {
+                unsigned from = triangles[t + i];
+                if (locked[from])
+                    continue;
+                for (int j = 1; j < 3; ++j) {
+                    unsigned to = triangles[t + (i + j) % 3];
+                    double error = collapseError(from, to);
+                    if (error > maxErrorSq)
+                        continue;
+                    if (bestError[from] < 0) {
+                        candidates.push_back(from);
+                    } else if (error >= bestError[from]) {
+                        continue;
+                    }
+                    bestError[from] = error;
+                    bestTarget[from] = to;
+                }
             }
+        }
+        if (candidates.empty())
+            break;
+        std::sort(candidates.begin(), candidates.end(), [&](unsigned a, unsigned b) { return bestError[a] < bestError[b]; });
 
-            size_t triangleCount = indexCount / 3;
-            size_t vertexCount3 = vertexCount / 3;
-
-            RTCGeometry geom = rtcNewGeometry(device, RTC_GEOMETRY_TYPE_TRIANGLE);
+        for (int v = 0; v < vertexCount; ++v)
+            remap[v] = (unsigned)v;
+        std::fill(touched.begin(), touched.end(), 0);
+        // a collapse removes about two triangles, don't go much further than needed in one pass
+        int removable = ((int)triangles.size() - targetIndexCount) / 3;
+        int removed = 0;
+        for (unsigned from : candidates) {
+            if (removed >= removable)
+                break;
+            unsigned to = bestTarget[from];
+            if (touched[from] || touched[to])
+                continue;
 
-            rtcSetSharedGeometryBuffer(
-                geom,
-                RTC_BUFFER_TYPE_VERTEX,
-                0,
-                RTC_FORMAT_FLOAT3,
-                verts,
-                0,
-                sizeof(float) * 3,
-                vertexCount3
-            );
+            // reject the collapse if it would flip any triangle that survives it
+            bool flips = false;
+            int shared = 0;
+            for (int j = adjacencyStart[from]; j < adjacencyStart[from + 1] && !flips; ++j) {
+                const unsigned* tri = &triangles[adjacency[j] * 3];
+                if (tri[0] == to || tri[1] == to || tri[2] == to) {
+                    shared++;
+                    continue;
+                }
+                const float* p[3];
+                const float* moved[3];
+                for (int i = 0; i < 3; ++i) {
+                    p[i] = &positions[remap[tri[i]] * 3];
+                    moved[i] = tri[i] == from ? &positions[to * 3] : p[i];
+                }
+                double before[3], after[3];
+                triangleNormal(p[0], p[1], p[2], before);
+                triangleNormal(moved[0], moved[1], moved[2], after);
+                flips = before[0] * after[0] + before[1] * after[1] + before[2] * after[2] <= 0;
+            }
+            if (flips)
+                continue;
 
-            rtcSetSharedGeometryBuffer(
-                geom,
-                RTC_BUFFER_TYPE_INDEX,
-                0,
-                RTC_FORMAT_UINT3,
-                inds,
-                0,
-                sizeof(unsigned) * 3,
-                triangleCount
-            );
+            // neighbours of both ends can't move this pass, the flip test above assumes they stay put
+            for (unsigned v : { from, to })
+                for (int j = adjacencyStart[v]; j < adjacencyStart[v + 1]; ++j)
+                    for (int i = 0; i < 3; ++i)
+                        touched[triangles[adjacency[j] * 3 + i]] = 1;
+            remap[from] = to;
+            quadrics[to].add(quadrics[from]);
+            resultErrorSq = std::max(resultErrorSq, bestError[from]);
+            removed += std::max(shared, 1);
+        }
+        if (removed == 0)
+            break;
 
-            rtcCommitGeometry(geom);
-            rtcAttachGeometry(scene, geom);
-            rtcReleaseGeometry(geom);
+        size_t kept = 0;
+        for (size_t t = 0; t < triangles.size(); t += 3) {
+            unsigned a = remap[triangles[t]], b = remap[triangles[t + 1]], c = remap[triangles[t + 2]];
+            if (a == b || b == c || a == c)
+                continue;
+            triangles[kept++] = a;
+            triangles[kept++] = b;
+            triangles[kept++] = c;
         }
+        triangles.resize(kept);
     }
 
-    rtcCommitScene(scene);
-    json_value_free(rootVal);
+    memcpy(outIndices, triangles.data(), triangles.size() * sizeof(unsigned));
+    *outError = (float)sqrt(resultErrorSq);
+    return (int)triangles.size();
 }
 
 //--------- OpenGL Compute Shaders(Ugh, why is lime so outdated... >:<) ---------//
@@ -383,6 +4067,31 @@ HL_PRIM void HL_NAME(load_geometry_embree)(vstring* jsonStr, int id) {
 }
 DEFINE_PRIM(_VOID, load_geometry_embree, _STRING _I32);
 
+HL_PRIM void HL_NAME(set_mesh_part_count_embree)(int id, int count) {
+    setMeshPartCount(id, count);
+}
+DEFINE_PRIM(_VOID, set_mesh_part_count_embree, _I32 _I32);
+
+HL_PRIM bool HL_NAME(upload_mesh_part_embree)(int id, int slot, vbyte* vertices, int vertexCount, vbyte* indices, int indexCount) {
+    return uploadMeshPart(id, slot, (const float*)vertices, vertexCount, (const unsigned*)indices, indexCount);
+}
+DEFINE_PRIM(_BOOL, upload_mesh_part_embree, _I32 _I32 _BYTES _I32 _BYTES _I32);
+
+HL_PRIM bool HL_NAME(mesh_part_matches_embree)(int id, int slot, vbyte* vertices, int vertexCount, vbyte* indices, int indexCount) {
+    return meshPartMatches(id, slot, (const float*)vertices, vertexCount, (const unsigned*)indices, indexCount);
+}
+DEFINE_PRIM(_BOOL, mesh_part_matches_embree, _I32 _I32 _BYTES _I32 _BYTES _I32);
+
+HL_PRIM void HL_NAME(update_materials_embree)(int id, vbyte* records, int start, int count, int total) {
+    updateMaterials(id, (const MaterialRecord*)records, start, count, total);
+}
+DEFINE_PRIM(_VOID, update_materials_embree, _I32 _BYTES _I32 _I32 _I32);
+
+HL_PRIM void HL_NAME(update_lights_embree)(int id, vbyte* records, int count) {
+    updateLights(id, (const LightRecord*)records, count);
+}
+DEFINE_PRIM(_VOID, update_lights_embree, _I32 _BYTES _I32);
+
 HL_PRIM HitResult* HL_NAME(trace_ray_embree)(int id, SimpleRay* _ray) {
     HitResult res = traceRay(id, _ray);
     HitResult* finalRes = (HitResult*)hl_gc_alloc_raw(sizeof(HitResult));
@@ -394,6 +4103,350 @@ HL_PRIM HitResult* HL_NAME(trace_ray_embree)(int id, SimpleRay* _ray) {
 }
 DEFINE_PRIM(_OBJ(_BOOL _F32 _I32 _I32), trace_ray_embree, _I32 _OBJ(_F32 _F32 _F32 _F32 _F32 _F32));
 
+HL_PRIM int HL_NAME(project_mesh_part)(ProjectionTransform* transform, vbyte* positions, int vertexCount, vbyte* indices, int indexCount,
+    vbyte* uvs, int uvCount, vbyte* outVerts, vbyte* outUvt, vbyte* outIndices, vbyte* outDepth) {
+    return projectMeshPart(transform, (const float*)positions, vertexCount, (const unsigned*)indices, indexCount,
+        (const float*)uvs, uvCount, (float*)outVerts, (float*)outUvt, (int*)outIndices, (float*)outDepth);
+}
+DEFINE_PRIM(_I32, project_mesh_part, _OBJ(_F32 _F32 _F32 _F32 _F32 _F32 _F32 _F32 _F32 _F32 _F32 _F32 _F32 _F32 _F32 _F32 _F32 _F32 _F32 _F32 _F32 _F32 _F32 _F32 _F32 _F32 _F32 _F32 _F32 _F32 _F32 _I32) _BYTES _I32 _BYTES _I32 _BYTES _I32 _BYTES _BYTES _BYTES _BYTES);
+
+HL_PRIM void HL_NAME(transform_mesh_part)(ProjectionTransform* transform, vbyte* positions, int vertexCount, vbyte* out) {
+    transformMeshPart(transform, (const float*)positions, vertexCount, (float*)out);
+}
+DEFINE_PRIM(_VOID, transform_mesh_part, _OBJ(_F32 _F32 _F32 _F32 _F32 _F32 _F32 _F32 _F32 _F32 _F32 _F32 _F32 _F32 _F32 _F32 _F32 _F32 _F32 _F32 _F32 _F32 _F32 _F32 _F32 _F32 _F32 _F32 _F32 _F32 _F32 _I32) _BYTES _I32 _BYTES);
+
+HL_PRIM int HL_NAME(new_projection_batch)(_NO_ARG) {
+    return createProjectionBatch();
+}
+DEFINE_PRIM(_I32, new_projection_batch, _NO_ARG);
+
+HL_PRIM void HL_NAME(dispose_projection_batch)(int id) {
+    disposeProjectionBatch(id);
+}
+DEFINE_PRIM(_VOID, dispose_projection_batch, _I32);
+
+HL_PRIM void HL_NAME(queue_projection)(int id, ProjectionTransform* transform, vbyte* positions, int vertexCount, vbyte* indices, int indexCount,
+    vbyte* uvs, int uvCount, vbyte* outVerts, vbyte* outUvt, vbyte* outIndices, vbyte* outDepth) {
+    queueProjection(id, transform, (const float*)positions, vertexCount, (const unsigned*)indices, indexCount, (const float*)uvs, uvCount,
+        (float*)outVerts, (float*)outUvt, (int*)outIndices, (float*)outDepth);
+}
+DEFINE_PRIM(_VOID, queue_projection, _I32 _OBJ(_F32 _F32 _F32 _F32 _F32 _F32 _F32 _F32 _F32 _F32 _F32 _F32 _F32 _F32 _F32 _F32 _F32 _F32 _F32 _F32 _F32 _F32 _F32 _F32 _F32 _F32 _F32 _F32 _F32 _F32 _F32 _I32) _BYTES _I32 _BYTES _I32 _BYTES _I32 _BYTES _BYTES _BYTES _BYTES);
+
+HL_PRIM void HL_NAME(run_projection_batch)(int id, vbyte* outCounts) {
+    runProjectionBatch(id, (int*)outCounts);
+}
+DEFINE_PRIM(_VOID, run_projection_batch, _I32 _BYTES);
+
+HL_PRIM int HL_NAME(load_obj_file)(vstring* path) {
+    return loadOBJFile(hl_to_utf8(path->bytes));
+}
+DEFINE_PRIM(_I32, load_obj_file, _STRING);
+
+HL_PRIM int HL_NAME(load_obj_data)(vstring* objData, vstring* mtlData, vstring* dir) {
+    return loadOBJData(hl_to_utf8(objData->bytes), mtlData ? hl_to_utf8(mtlData->bytes) : nullptr, hl_to_utf8(dir->bytes));
+}
+DEFINE_PRIM(_I32, load_obj_data, _STRING _STRING _STRING);
+
+HL_PRIM int HL_NAME(loaded_part_count)(int id) {
+    return getLoadedPartCount(id);
+}
+DEFINE_PRIM(_I32, loaded_part_count, _I32);
+
+HL_PRIM void HL_NAME(loaded_part_info)(int id, int part, vbyte* out) {
+    getLoadedPartInfo(id, part, (int*)out);
+}
+DEFINE_PRIM(_VOID, loaded_part_info, _I32 _I32 _BYTES);
+
+HL_PRIM vbyte* HL_NAME(loaded_part_texture)(int id, int part) {
+    const std::string* texture = getLoadedPartTexture(id, part);
+    size_t size = texture ? texture->size() : 0;
+    vbyte* out = hl_alloc_bytes((int)size + 1);
+    if (size > 0)
+        memcpy(out, texture->data(), size);
+    out[size] = 0;
+    return out;
+}
+DEFINE_PRIM(_BYTES, loaded_part_texture, _I32 _I32);
+
+HL_PRIM void HL_NAME(copy_loaded_part)(int id, int part, vbyte* vertices, vbyte* uvs, vbyte* indices) {
+    copyLoadedPart(id, part, (float*)vertices, (float*)uvs, (unsigned*)indices);
+}
+DEFINE_PRIM(_VOID, copy_loaded_part, _I32 _I32 _BYTES _BYTES _BYTES);
+
+HL_PRIM void HL_NAME(free_loaded_mesh)(int id) {
+    freeLoadedMesh(id);
+}
+DEFINE_PRIM(_VOID, free_loaded_mesh, _I32);
+
+HL_PRIM int HL_NAME(open_nmesh)(vstring* path) {
+    return openNMesh(hl_to_utf8(path->bytes));
+}
+DEFINE_PRIM(_I32, open_nmesh, _STRING);
+
+HL_PRIM int HL_NAME(open_nmesh_data)(vbyte* data, int size) {
+    return openNMeshData((const char*)data, size);
+}
+DEFINE_PRIM(_I32, open_nmesh_data, _BYTES _I32);
+
+HL_PRIM int HL_NAME(nmesh_part_count)(int id) {
+    return getNMeshPartCount(id);
+}
+DEFINE_PRIM(_I32, nmesh_part_count, _I32);
+
+HL_PRIM void HL_NAME(nmesh_part_info)(int id, int part, vbyte* out) {
+    getNMeshPartInfo(id, part, (int*)out);
+}
+DEFINE_PRIM(_VOID, nmesh_part_info, _I32 _I32 _BYTES);
+
+HL_PRIM vbyte* HL_NAME(nmesh_part_stream)(int id, int part, int stream) {
+    return (vbyte*)getNMeshStream(id, part, stream);
+}
+DEFINE_PRIM(_BYTES, nmesh_part_stream, _I32 _I32 _I32);
+
+HL_PRIM vbyte* HL_NAME(nmesh_part_graphic)(int id, int part) {
+    std::string graphic = getNMeshGraphic(id, part);
+    vbyte* out = hl_alloc_bytes((int)graphic.size() + 1);
+    memcpy(out, graphic.c_str(), graphic.size() + 1);
+    return out;
+}
+DEFINE_PRIM(_BYTES, nmesh_part_graphic, _I32 _I32);
+
+HL_PRIM void HL_NAME(close_nmesh)(int id) {
+    closeNMesh(id);
+}
+DEFINE_PRIM(_VOID, close_nmesh, _I32);
+
+HL_PRIM void HL_NAME(optimize_mesh_part)(vbyte* positions, vbyte* normals, vbyte* uvs, int uvCount, int vertexCount, vbyte* indices,
+    int indexCount, float tolerance, vbyte* outPositions, vbyte* outNormals, vbyte* outUvs, vbyte* outIndices, vbyte* outCounts) {
+    optimizeMeshPart((const float*)positions, (const float*)normals, (const float*)uvs, uvCount, vertexCount, (const unsigned*)indices,
+        indexCount, tolerance, (float*)outPositions, (float*)outNormals, (float*)outUvs, (unsigned*)outIndices, (int*)outCounts);
+}
+DEFINE_PRIM(_VOID, optimize_mesh_part, _BYTES _BYTES _BYTES _I32 _I32 _BYTES _I32 _F32 _BYTES _BYTES _BYTES _BYTES _BYTES);
+
+HL_PRIM int HL_NAME(simplify_mesh)(vbyte* positions, int vertexCount, vbyte* indices, int indexCount, int targetIndexCount, float maxError,
+    vbyte* outIndices, vbyte* outError) {
+    return simplifyMesh((const float*)positions, vertexCount, (const unsigned*)indices, indexCount, targetIndexCount, maxError,
+        (unsigned*)outIndices, (float*)outError);
+}
+DEFINE_PRIM(_I32, simplify_mesh, _BYTES _I32 _BYTES _I32 _I32 _F32 _BYTES _BYTES);
+
+HL_PRIM int HL_NAME(create_raster_texture)(vbyte* pixels, int width, int height, int format, bool premultiplied) {
+    return createRasterTexture(pixels, width, height, format, premultiplied);
+}
+DEFINE_PRIM(_I32, create_raster_texture, _BYTES _I32 _I32 _I32 _BOOL);
+
+HL_PRIM void HL_NAME(dispose_raster_texture)(int id) {
+    disposeRasterTexture(id);
+}
+DEFINE_PRIM(_VOID, dispose_raster_texture, _I32);
+
+HL_PRIM bool HL_NAME(raster_texture_translucent)(int id, int x, int y, int width, int height) {
+    return isRasterTextureTranslucent(id, x, y, width, height);
+}
+DEFINE_PRIM(_BOOL, raster_texture_translucent, _I32 _I32 _I32 _I32 _I32);
+
+HL_PRIM int HL_NAME(new_rasterizer)(_NO_ARG) {
+    return createRasterizer();
+}
+DEFINE_PRIM(_I32, new_rasterizer, _NO_ARG);
+
+HL_PRIM void HL_NAME(dispose_rasterizer)(int id) {
+    disposeRasterizer(id);
+}
+DEFINE_PRIM(_VOID, dispose_rasterizer, _I32);
+
+HL_PRIM void HL_NAME(begin_raster)(int id, int width, int height, int clearColor) {
+    beginRaster(id, width, height, (uint32_t)clearColor);
+}
+DEFINE_PRIM(_VOID, begin_raster, _I32 _I32 _I32 _I32);
+
+HL_PRIM void HL_NAME(submit_raster)(int id, vbyte* verts, vbyte* depth, vbyte* uvt, int vertexCount, int textureID, bool repeat, bool smooth,
+    int blend, bool translucent, double offsetX, double offsetY) {
+    submitRaster(id, (const float*)verts, (const float*)depth, (const float*)uvt, vertexCount, textureID, repeat, smooth, blend, translucent,
+        (float)offsetX, (float)offsetY);
+}
+DEFINE_PRIM(_VOID, submit_raster, _I32 _BYTES _BYTES _BYTES _I32 _I32 _BOOL _BOOL _I32 _BOOL _F64 _F64);
+
+HL_PRIM void HL_NAME(finish_raster)(int id, vbyte* out, int format) {
+    finishRaster(id, out, format);
+}
+DEFINE_PRIM(_VOID, finish_raster, _I32 _BYTES _I32);
+
+HL_PRIM int HL_NAME(new_framebuffer)(int width, int height) {
+    return createFramebuffer(width, height);
+}
+DEFINE_PRIM(_I32, new_framebuffer, _I32 _I32);
+
+HL_PRIM void HL_NAME(dispose_framebuffer)(int id) {
+    disposeFramebuffer(id);
+}
+DEFINE_PRIM(_VOID, dispose_framebuffer, _I32);
+
+HL_PRIM void HL_NAME(reset_framebuffer)(int id, int width, int height) {
+    resetFramebuffer(id, width, height);
+}
+DEFINE_PRIM(_VOID, reset_framebuffer, _I32 _I32 _I32);
+
+HL_PRIM void HL_NAME(add_framebuffer_sample)(int id, int x, int y, double r, double g, double b) {
+    addFramebufferSample(id, x, y, (float)r, (float)g, (float)b);
+}
+DEFINE_PRIM(_VOID, add_framebuffer_sample, _I32 _I32 _I32 _F64 _F64 _F64);
+
+HL_PRIM int HL_NAME(framebuffer_sample_count)(int id, int x, int y) {
+    return getFramebufferSampleCount(id, x, y);
+}
+DEFINE_PRIM(_I32, framebuffer_sample_count, _I32 _I32 _I32);
+
+HL_PRIM double HL_NAME(resolve_framebuffer)(int id, vbyte* out, int fillRadius) {
+    return resolveFramebuffer(id, (float*)out, fillRadius);
+}
+DEFINE_PRIM(_F64, resolve_framebuffer, _I32 _BYTES _I32);
+
+HL_PRIM int HL_NAME(update_framebuffer_convergence)(int id, double targetError, int minSamples, int maxSamples, int stride,
+    vbyte* outTileSamples) {
+    return updateFramebufferConvergence(id, (float)targetError, minSamples, maxSamples, stride, outTileSamples);
+}
+DEFINE_PRIM(_I32, update_framebuffer_convergence, _I32 _F64 _I32 _I32 _I32 _BYTES);
+
+HL_PRIM void HL_NAME(add_framebuffer_features)(int id, int x, int y, double albedoR, double albedoG, double albedoB, double normalX,
+    double normalY, double normalZ, double depth, int geomID) {
+    addFramebufferFeatures(id, x, y, (float)albedoR, (float)albedoG, (float)albedoB, (float)normalX, (float)normalY, (float)normalZ,
+        (float)depth, geomID);
+}
+DEFINE_PRIM(_VOID, add_framebuffer_features, _I32 _I32 _I32 _F64 _F64 _F64 _F64 _F64 _F64 _F64 _I32);
+
+HL_PRIM int HL_NAME(reproject_framebuffer)(int id, vbyte* fromCamera, vbyte* toCamera, int maxHistory) {
+    return reprojectFramebuffer(id, (const float*)fromCamera, (const float*)toCamera, maxHistory);
+}
+DEFINE_PRIM(_I32, reproject_framebuffer, _I32 _BYTES _BYTES _I32);
+
+HL_PRIM bool HL_NAME(is_denoiser_available)(int mode) {
+    return isDenoiserAvailable(mode);
+}
+DEFINE_PRIM(_BOOL, is_denoiser_available, _I32);
+
+HL_PRIM int HL_NAME(denoise_framebuffer)(int id, vbyte* color, vbyte* out, int mode, int iterations, double sigmaColor, double sigmaNormal,
+    double sigmaDepth) {
+    return denoiseFramebuffer(id, (const float*)color, (float*)out, mode, iterations, (float)sigmaColor, (float)sigmaNormal, (float)sigmaDepth);
+}
+DEFINE_PRIM(_I32, denoise_framebuffer, _I32 _BYTES _BYTES _I32 _I32 _F64 _F64 _F64);
+
+HL_PRIM void HL_NAME(tonemap_frame)(vbyte* in, int width, int height, vbyte* out, int format, int op, double exposure, bool srgb) {
+    tonemapFrame((const float*)in, width, height, (unsigned char*)out, format, op, (float)exposure, srgb);
+}
+DEFINE_PRIM(_VOID, tonemap_frame, _BYTES _I32 _I32 _BYTES _I32 _I32 _F64 _BOOL);
+
+HL_PRIM int HL_NAME(new_tile_scheduler)(int width, int height, int workers) {
+    return createTileScheduler(width, height, workers);
+}
+DEFINE_PRIM(_I32, new_tile_scheduler, _I32 _I32 _I32);
+
+// waits for the workers, they might be blocked in acquire_tile
+HL_PRIM void HL_NAME(dispose_tile_scheduler)(int id) {
+    hl_blocking(true);
+    disposeTileScheduler(id);
+    hl_blocking(false);
+}
+DEFINE_PRIM(_VOID, dispose_tile_scheduler, _I32);
+
+HL_PRIM int HL_NAME(tile_scheduler_workers)(int id) {
+    return getTileSchedulerWorkers(id);
+}
+DEFINE_PRIM(_I32, tile_scheduler_workers, _I32);
+
+HL_PRIM int HL_NAME(restart_tile_scheduler)(int id, int width, int height, int order, double focusX, double focusY) {
+    return restartTileScheduler(id, width, height, order, (float)focusX, (float)focusY);
+}
+DEFINE_PRIM(_I32, restart_tile_scheduler, _I32 _I32 _I32 _I32 _F64 _F64);
+
+HL_PRIM void HL_NAME(cancel_tile_scheduler)(int id) {
+    cancelTileScheduler(id);
+}
+DEFINE_PRIM(_VOID, cancel_tile_scheduler, _I32);
+
+HL_PRIM void HL_NAME(wait_tile_scheduler_idle)(int id) {
+    hl_blocking(true);
+    waitTileSchedulerIdle(id);
+    hl_blocking(false);
+}
+DEFINE_PRIM(_VOID, wait_tile_scheduler_idle, _I32);
+
+// blocking threads must tell the GC, or a collection would wait on them forever
+HL_PRIM int HL_NAME(acquire_tile)(int id, int worker) {
+    hl_blocking(true);
+    int tile = acquireTile(id, worker);
+    hl_blocking(false);
+    return tile;
+}
+DEFINE_PRIM(_I32, acquire_tile, _I32 _I32);
+
+HL_PRIM bool HL_NAME(is_tile_current)(int id, int worker) {
+    return isTileCurrent(id, worker);
+}
+DEFINE_PRIM(_BOOL, is_tile_current, _I32 _I32);
+
+HL_PRIM int HL_NAME(finish_tile)(int id, int worker) {
+    return finishTile(id, worker);
+}
+DEFINE_PRIM(_I32, finish_tile, _I32 _I32);
+
+HL_PRIM int HL_NAME(tile_scheduler_pending)(int id) {
+    return getTileSchedulerPending(id);
+}
+DEFINE_PRIM(_I32, tile_scheduler_pending, _I32);
+
+HL_PRIM int HL_NAME(new_radiance_cache)() {
+    return createRadianceCache();
+}
+DEFINE_PRIM(_I32, new_radiance_cache, _NO_ARG);
+
+HL_PRIM void HL_NAME(dispose_radiance_cache)(int id) {
+    disposeRadianceCache(id);
+}
+DEFINE_PRIM(_VOID, dispose_radiance_cache, _I32);
+
+HL_PRIM void HL_NAME(reset_radiance_cache)(int id, int raytracerID, int capacity, int cells, int minSamples, int maxSamples) {
+    hl_blocking(true);
+    resetRadianceCache(id, raytracerID, capacity, cells, minSamples, maxSamples);
+    hl_blocking(false);
+}
+DEFINE_PRIM(_VOID, reset_radiance_cache, _I32 _I32 _I32 _I32 _I32 _I32);
+
+HL_PRIM int HL_NAME(radiance_cache_size)(int id) {
+    return getRadianceCacheSize(id);
+}
+DEFINE_PRIM(_I32, radiance_cache_size, _I32);
+
+HL_PRIM int HL_NAME(new_probe_grid)() {
+    return createProbeGrid();
+}
+DEFINE_PRIM(_I32, new_probe_grid, _NO_ARG);
+
+HL_PRIM void HL_NAME(dispose_probe_grid)(int id) {
+    disposeProbeGrid(id);
+}
+DEFINE_PRIM(_VOID, dispose_probe_grid, _I32);
+
+HL_PRIM int HL_NAME(reset_probe_grid)(int id, int raytracerID, int resolution) {
+    return resetProbeGrid(id, raytracerID, resolution);
+}
+DEFINE_PRIM(_I32, reset_probe_grid, _I32 _I32 _I32);
+
+HL_PRIM int HL_NAME(update_probe_grid)(int id, int raytracerID, int materialsID, int probeCount, int raysPerProbe, int maxRays, double skyR,
+    double skyG, double skyB, int cacheID, int bounces) {
+    hl_blocking(true);
+    int refined = updateProbeGrid(id, raytracerID, materialsID, probeCount, raysPerProbe, maxRays, (float)skyR, (float)skyG, (float)skyB, cacheID,
+        bounces);
+    hl_blocking(false);
+    return refined;
+}
+DEFINE_PRIM(_I32, update_probe_grid, _I32 _I32 _I32 _I32 _I32 _I32 _F64 _F64 _F64 _I32 _I32);
+
+HL_PRIM bool HL_NAME(sample_probe_grid)(int id, double x, double y, double z, double normalX, double normalY, double normalZ, vbyte* out) {
+    return sampleProbeGrid(id, (float)x, (float)y, (float)z, (float)normalX, (float)normalY, (float)normalZ, (float*)out);
+}
+DEFINE_PRIM(_BOOL, sample_probe_grid, _I32 _F64 _F64 _F64 _F64 _F64 _F64 _BYTES);
+
 HL_PRIM void HL_NAME(init_opengl)(_NO_ARG) {
 	initOpenGL();
 }
@@ -5,12 +5,12 @@ import flixel.text.FlxText;
 import flixel.util.FlxColor;
 import haxe.Timer;
 import nebula.mesh.*;
+import nebula.mesh.MeshPart.CullMode;
 import nebula.view.*;
 import nebula.view.renderers.*;
 import nebula.view.renderers.Raytracer.FloatColor;
 import openfl.Vector;
 import openfl.geom.Vector3D;
-import sys.thread.Thread;
 
 using StringTools;
 
@@ -269,6 +269,8 @@ class PlayState extends FlxState
 	{
 		var part = new MeshPart(new Vector<Vector3D>(), new Vector<Int>(), new Vector<Float>(), new Vector<Vector3D>(), '');
 		part.color = color;
+		// the triangles below wind counter clockwise on screen when seen from outside
+		part.cullMode = CullMode.CW;
 
 		for (lat in 0...latSteps + 1)
 		{
@@ -314,7 +316,8 @@ class PlayState extends FlxState
 			}
 		}
 
-		return part;
+		// the poles and the seam repeat vertices and the pole triangles have no area
+		return MeshOptimizer.optimizePart(part);
 	}
 
 	function makeQuad(x:Float, y:Float, z:Float, sizeX:Float, sizeY:Float, color:Int, plane:Plane, backFace:Bool = false):MeshPart
@@ -444,24 +447,15 @@ class PlayState extends FlxState
 
 	var renderText = '';
 	var lastRenderTime:Float = 0;
+	var renderStart:Float = 0;
+	var wasRendering:Bool = false;
 
-	public function render(res:Int, threaded:Bool)
+	// the tracer's own threads do the work, moving again cancels it
+	public function render(res:Int)
 	{
 		cpuRaytracer.giRes = res;
-		var start = Timer.stamp();
-		if (threaded)
-		{
-			Thread.create(() ->
-			{
-				cpuRaytracer.renderScene();
-				lastRenderTime = Timer.stamp() - start;
-			});
-		}
-		else
-		{
-			cpuRaytracer.renderScene();
-			lastRenderTime = Timer.stamp() - start;
-		}
+		renderStart = Timer.stamp();
+		cpuRaytracer.renderScene();
 	}
 
 	override public function update(elapsed:Float):Void
@@ -469,14 +463,18 @@ class PlayState extends FlxState
 		super.update(elapsed);
 		if (separated)
 		{
+			if (wasRendering && !cpuRaytracer.rendering)
+				lastRenderTime = Timer.stamp() - renderStart;
+			wasRendering = cpuRaytracer.rendering;
 			controls.text = controls.text.substr(0, controls.text.length - renderText.length);
 			renderText = cpuRaytracer.rendering ? 'Rendering... ${Math.round(cpuRaytracer.prog / cpuRaytracer.maxProg * 100)}%' : lastRenderTime != 0 ? 'Last Render Time: ${formatTimeVerbose(lastRenderTime)}' : '';
+			if (aqm && cpuRaytracer.adaptiveSampling)
+				renderText += cpuRaytracer.converged ? '\nConverged' : '\nConverged: ${Math.round(cpuRaytracer.convergence * 100)}%';
 			controls.text += renderText;
-			var threaded = true;
 			if (FlxG.keys.justPressed.ENTER && !aqm)
 			{
 				cpuRaytracer.globalIllum.visible = true;
-				render(1, threaded);
+				render(1);
 			}
 			if (FlxG.keys.justPressed.ESCAPE)
 				cpuRaytracer.globalIllum.visible = false;
@@ -489,35 +487,25 @@ class PlayState extends FlxState
 				if (FlxG.keys.pressed.W || FlxG.keys.pressed.S || FlxG.keys.pressed.A || FlxG.keys.pressed.D || FlxG.keys.pressed.SPACE
 					|| FlxG.keys.pressed.SHIFT || FlxG.mouse.pressed)
 				{
-					render(30, threaded);
-				}
-				if (!cpuRaytracer.rendering && cpuRaytracer.giRes > 5)
-				{
-					cpuRaytracer.giRes--;
-					render(cpuRaytracer.giRes, threaded);
+					// moving resets the frame, it's traced sparsely first and refined from there without starting over
+					render(cpuRaytracer.giRes);
 				}
 			}
 		}
 
-		if (FlxG.keys.justPressed.R && !cpuRaytracer.rendering)
+		// a running render is cancelled by these, passes read giRes when they start
+		if (FlxG.keys.justPressed.R)
 			FlxG.switchState(() -> new PlayState(!separated));
-		else if (FlxG.keys.justPressed.R && cpuRaytracer.rendering)
-			trace('Rendering, please wait for it to finish before switching modes.');
-		if (FlxG.keys.justPressed.MINUS && !cpuRaytracer.rendering && !aqm)
+		if (FlxG.keys.justPressed.MINUS && !aqm)
 			cpuRaytracer.giRes -= 1;
-		else if (FlxG.keys.justPressed.MINUS && cpuRaytracer.rendering && !aqm)
-			trace('Rendering, please wait for it to finish before changing resolution.');
-		if (FlxG.keys.justPressed.PLUS && !cpuRaytracer.rendering && !aqm)
+		if (FlxG.keys.justPressed.PLUS && !aqm)
 			cpuRaytracer.giRes += 1;
-		else if (FlxG.keys.justPressed.PLUS && cpuRaytracer.rendering && !aqm)
-			trace('Rendering, please wait for it to finish before changing resolution.');
 		if (FlxG.keys.justPressed.BACKSLASH)
 			aqm = !aqm;
 
 		if (FlxG.keys.justPressed.J)
 			scene = cast(cast(scene, Int) + 1) % maxScenes;
 
-		view.canMove = !cpuRaytracer.rendering;
 		cpuRaytracer.clearFrame = !aqm;
 	}
 }
@@ -733,6 +721,8 @@ class PlayState extends FlxState
 	{
 		var part = new MeshPart(new Vector<Vector3D>(), new Vector<Int>(), new Vector<Float>(), new Vector<Vector3D>(), '');
 		part.color = color;
+		// the triangles below wind counter clockwise on screen when seen from outside
+		part.cullMode = CullMode.CW;
 
 		for (lat in 0...latSteps + 1)
 		{
@@ -778,7 +768,8 @@ class PlayState extends FlxState
 			}
 		}
 
-		return part;
+		// the poles and the seam repeat vertices and the pole triangles have no area
+		return MeshOptimizer.optimizePart(part);
 	}
 
 	function makeQuad(x:Float, y:Float, z:Float, sizeX:Float, sizeY:Float, color:Int, plane:Plane, backFace:Bool = false):MeshPart
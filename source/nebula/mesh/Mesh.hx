@@ -1,18 +1,111 @@
 package nebula.mesh;
 
+import nebula.mesh.buffers.VertexBuffer;
+import nebulatracer.RasterizerExt;
+
+/**
+ * A mesh part after its mesh's transform, cached by `Mesh.updateWorldSpace`.
+ */
+class WorldSpacePart
+{
+	public var part(default, null):MeshPart;
+
+	/**
+	 * World space positions, packed float32 x, y, z.
+	 */
+	public var vertices(default, null):VertexBuffer = new VertexBuffer();
+
+	/**
+	 * World space bounding sphere, the radius is -1 if the part has no vertices.
+	 */
+	public var centerX(default, null):Float = 0;
+
+	public var centerY(default, null):Float = 0;
+	public var centerZ(default, null):Float = 0;
+	public var radius(default, null):Float = -1;
+
+	/**
+	 * The largest scale of the mesh, local distances (like LOD errors) times this are at most as long in world space.
+	 */
+	public var scale(default, null):Float = 1;
+
+	/**
+	 * Goes up every time the world space data is recomputed.
+	 */
+	public var version(default, null):Int = 0;
+
+	var partGeneration:Int = -1;
+	var transformVersion:Int = -1;
+
+	public function new(part:MeshPart)
+	{
+		this.part = part;
+	}
+
+	@:allow(nebula.mesh.Mesh)
+	function update(mesh:Mesh, transform:ProjectionTransform, scratch:hl.Bytes):Bool
+	{
+		var generation = part.generation;
+		if (generation == partGeneration && mesh.transformVersion == transformVersion)
+			return false;
+		partGeneration = generation;
+		transformVersion = mesh.transformVersion;
+		version++;
+
+		var bounds = part.bounds;
+		var count = part.vertices.length;
+		vertices.resize(count);
+		if (bounds.empty)
+		{
+			radius = -1;
+			return true;
+		}
+
+		transform.pivotX = bounds.centroidX;
+		transform.pivotY = bounds.centroidY;
+		transform.pivotZ = bounds.centroidZ;
+		RasterizerExt.transformMeshPart(transform, part.vertices.bytes, count, vertices.bytes);
+		vertices.markDirty();
+
+		scratch.setF32(0, bounds.centerX);
+		scratch.setF32(4, bounds.centerY);
+		scratch.setF32(8, bounds.centerZ);
+		RasterizerExt.transformMeshPart(transform, scratch, 1, scratch);
+		centerX = scratch.getF32(0);
+		centerY = scratch.getF32(4);
+		centerZ = scratch.getF32(8);
+		scale = Math.max(Math.abs(mesh.scaleX), Math.max(Math.abs(mesh.scaleY), Math.abs(mesh.scaleZ)));
+		radius = bounds.radius * scale;
+		return true;
+	}
+}
+
 class Mesh
 {
-	public var x:Float = 0;
-	public var y:Float = 0;
-	public var z:Float = 0;
-	public var pitch:Float = 0;
-	public var yaw:Float = 0;
-	public var roll:Float = 0;
-	public var scaleX:Float = 1;
-	public var scaleY:Float = 1;
-	public var scaleZ:Float = 1;
+	public var x(default, set):Float = 0;
+	public var y(default, set):Float = 0;
+	public var z(default, set):Float = 0;
+	public var pitch(default, set):Float = 0;
+	public var yaw(default, set):Float = 0;
+	public var roll(default, set):Float = 0;
+	public var scaleX(default, set):Float = 1;
+	public var scaleY(default, set):Float = 1;
+	public var scaleZ(default, set):Float = 1;
 	public var meshParts:Array<MeshPart> = [];
 
+	/**
+	 * Goes up every time the position, rotation or scale changes.
+	 */
+	public var transformVersion(default, null):Int = 0;
+
+	/**
+	 * The world space data of every part, in the same order as `meshParts`. Refresh it with `updateWorldSpace`.
+	 */
+	public var worldParts(default, null):Array<WorldSpacePart> = [];
+
+	static var worldTransform:ProjectionTransform = new ProjectionTransform();
+	static var worldScratch:hl.Bytes = new hl.Bytes(16);
+
 	public function new(x:Float, y:Float, z:Float, meshParts:Array<MeshPart>)
 	{
 		this.x = x;
@@ -21,4 +114,100 @@ class Mesh
 		if (meshParts != null)
 			this.meshParts = meshParts;
 	}
+
+	/**
+	 * Brings `worldParts` up to date. Only parts whose vertices or this mesh's transform changed get transformed again.
+	 * @return Whether anything was recomputed.
+	 */
+	public function updateWorldSpace():Bool
+	{
+		var transform = worldTransform;
+		transform.meshX = x;
+		transform.meshY = y;
+		transform.meshZ = z;
+		transform.meshYaw = yaw;
+		transform.meshPitch = pitch;
+		transform.meshRoll = roll;
+		transform.scaleX = scaleX;
+		transform.scaleY = scaleY;
+		transform.scaleZ = scaleZ;
+
+		var changed = worldParts.length != meshParts.length;
+		worldParts.resize(meshParts.length);
+		for (i in 0...meshParts.length)
+		{
+			var world = worldParts[i];
+			if (world == null || world.part != meshParts[i])
+			{
+				world = new WorldSpacePart(meshParts[i]);
+				worldParts[i] = world;
+			}
+			if (world.update(this, transform, worldScratch))
+				changed = true;
+		}
+		return changed;
+	}
+
+	function set_x(val:Float):Float
+	{
+		if (val != x)
+			transformVersion++;
+		return x = val;
+	}
+
+	function set_y(val:Float):Float
+	{
+		if (val != y)
+			transformVersion++;
+		return y = val;
+	}
+
+	function set_z(val:Float):Float
+	{
+		if (val != z)
+			transformVersion++;
+		return z = val;
+	}
+
+	function set_pitch(val:Float):Float
+	{
+		if (val != pitch)
+			transformVersion++;
+		return pitch = val;
+	}
+
+	function set_yaw(val:Float):Float
+	{
+		if (val != yaw)
+			transformVersion++;
+		return yaw = val;
+	}
+
+	function set_roll(val:Float):Float
+	{
+		if (val != roll)
+			transformVersion++;
+		return roll = val;
+	}
+
+	function set_scaleX(val:Float):Float
+	{
+		if (val != scaleX)
+			transformVersion++;
+		return scaleX = val;
+	}
+
+	function set_scaleY(val:Float):Float
+	{
+		if (val != scaleY)
+			transformVersion++;
+		return scaleY = val;
+	}
+
+	function set_scaleZ(val:Float):Float
+	{
+		if (val != scaleZ)
+			transformVersion++;
+		return scaleZ = val;
+	}
 }
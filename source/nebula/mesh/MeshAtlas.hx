@@ -0,0 +1,194 @@
+package nebula.mesh;
+
+import flixel.graphics.FlxGraphic;
+import openfl.display.BitmapData;
+import openfl.geom.Point;
+import openfl.geom.Rectangle;
+
+/**
+ * Where a graphic ended up in a `MeshAtlas` page. UVs map into it with `uv * scale + offset`.
+ */
+class AtlasRegion
+{
+	public var page(default, null):AtlasPage;
+	public var offsetU(default, null):Float;
+	public var offsetV(default, null):Float;
+	public var scaleU(default, null):Float;
+	public var scaleV(default, null):Float;
+
+	public function new(page:AtlasPage, offsetU:Float, offsetV:Float, scaleU:Float, scaleV:Float)
+	{
+		this.page = page;
+		this.offsetU = offsetU;
+		this.offsetV = offsetV;
+		this.scaleU = scaleU;
+		this.scaleV = scaleV;
+	}
+
+	/**
+	 * Whether this region is a single color, any UV maps to the same texel.
+	 */
+	public var solid(get, never):Bool;
+
+	inline function get_solid():Bool
+		return scaleU == 0 && scaleV == 0;
+}
+
+/**
+ * One atlas texture, filled shelf by shelf: regions go left to right and a new shelf starts under the tallest one.
+ */
+class AtlasPage
+{
+	public var bitmap(default, null):BitmapData;
+	public var graphic(default, null):FlxGraphic;
+	public var size(default, null):Int;
+
+	var shelfX:Int = 0;
+	var shelfY:Int = 0;
+	var shelfHeight:Int = 0;
+
+	public function new(size:Int)
+	{
+		this.size = size;
+		bitmap = new BitmapData(size, size, true, 0);
+		graphic = FlxGraphic.fromBitmapData(bitmap, true);
+		graphic.persist = true;
+		graphic.destroyOnNoUse = false;
+	}
+
+	/**
+	 * Finds space for a `width` x `height` block.
+	 * @return The top left corner, or null if the page is full.
+	 */
+	public function allocate(width:Int, height:Int):Point
+	{
+		if (shelfX + width > size)
+		{
+			shelfY += shelfHeight;
+			shelfX = 0;
+			shelfHeight = 0;
+		}
+		if (width > size || shelfY + height > size)
+			return null;
+		var pos = new Point(shelfX, shelfY);
+		shelfX += width;
+		if (height > shelfHeight)
+			shelfHeight = height;
+		return pos;
+	}
+}
+
+/**
+ * Packs mesh graphics into shared pages so parts with different graphics can still be drawn together,
+ * and every renderer uploads a handful of pages instead of one texture per part.
+ * 
+ * Graphics are deduplicated by key, so every part of the same color or image shares one region.
+ */
+class MeshAtlas
+{
+	public static inline var PAGE_SIZE:Int = 2048;
+
+	/**
+	 * Graphics bigger than this on either side keep their own texture.
+	 */
+	public static inline var MAX_REGION_SIZE:Int = 1024;
+
+	/**
+	 * Border around every region, filled with its edge pixels so smoothing doesn't pick up the neighbours.
+	 */
+	public static inline var PADDING:Int = 2;
+
+	public static var pages(default, null):Array<AtlasPage> = [];
+
+	static var regions:Map<String, AtlasRegion> = new Map();
+
+	/**
+	 * Adds a solid color, every UV of a part using it maps to the center of the block.
+	 */
+	public static function addColor(color:Int):AtlasRegion
+	{
+		var key = 'color:$color';
+		var region = regions.get(key);
+		if (region != null)
+			return region;
+
+		var size = PADDING * 2 + 1;
+		var page = null;
+		var pos = null;
+		for (candidate in pages)
+		{
+			pos = candidate.allocate(size, size);
+			if (pos != null)
+			{
+				page = candidate;
+				break;
+			}
+		}
+		if (page == null)
+		{
+			page = new AtlasPage(PAGE_SIZE);
+			pages.push(page);
+			pos = page.allocate(size, size);
+		}
+
+		page.bitmap.fillRect(new Rectangle(pos.x, pos.y, size, size), color);
+		region = new AtlasRegion(page, (pos.x + PADDING + 0.5) / page.size, (pos.y + PADDING + 0.5) / page.size, 0, 0);
+		regions.set(key, region);
+		return region;
+	}
+
+	/**
+	 * Copies `bitmap` into the atlas.
+	 * @param key Identifies the graphic, usually its path.
+	 * @return The region, or null if the bitmap is too big for the atlas.
+	 */
+	public static function addBitmap(key:String, bitmap:BitmapData):AtlasRegion
+	{
+		var region = regions.get(key);
+		if (region != null)
+			return region;
+		if (bitmap == null || bitmap.width > MAX_REGION_SIZE || bitmap.height > MAX_REGION_SIZE)
+			return null;
+
+		var width = bitmap.width;
+		var height = bitmap.height;
+		var page = null;
+		var pos = null;
+		for (candidate in pages)
+		{
+			pos = candidate.allocate(width + PADDING * 2, height + PADDING * 2);
+			if (pos != null)
+			{
+				page = candidate;
+				break;
+			}
+		}
+		if (page == null)
+		{
+			page = new AtlasPage(PAGE_SIZE);
+			pages.push(page);
+			pos = page.allocate(width + PADDING * 2, height + PADDING * 2);
+		}
+
+		var x = Std.int(pos.x) + PADDING;
+		var y = Std.int(pos.y) + PADDING;
+		var target = page.bitmap;
+		target.copyPixels(bitmap, bitmap.rect, new Point(x, y));
+
+		// stretch the edges into the padding, rows first so the columns pick up the corners
+		for (i in 1...PADDING + 1)
+		{
+			target.copyPixels(bitmap, new Rectangle(0, 0, width, 1), new Point(x, y - i));
+			target.copyPixels(bitmap, new Rectangle(0, height - 1, width, 1), new Point(x, y + height - 1 + i));
+		}
+		for (i in 1...PADDING + 1)
+		{
+			target.copyPixels(target, new Rectangle(x, y - PADDING, 1, height + PADDING * 2), new Point(x - i, y - PADDING));
+			target.copyPixels(target, new Rectangle(x + width - 1, y - PADDING, 1, height + PADDING * 2), new Point(x + width - 1 + i, y - PADDING));
+		}
+
+		region = new AtlasRegion(page, x / page.size, y / page.size, width / page.size, height / page.size);
+		regions.set(key, region);
+		return region;
+	}
+}
@@ -0,0 +1,119 @@
+package nebula.mesh;
+
+import nebula.mesh.buffers.VertexBuffer;
+
+/**
+ * Local space bounds of a mesh part: an axis aligned box and a sphere around its center.
+ */
+class MeshBounds
+{
+	public var minX:Float = 0;
+	public var minY:Float = 0;
+	public var minZ:Float = 0;
+	public var maxX:Float = 0;
+	public var maxY:Float = 0;
+	public var maxZ:Float = 0;
+
+	public var centerX:Float = 0;
+	public var centerY:Float = 0;
+	public var centerZ:Float = 0;
+
+	/**
+	 * Average of all vertices, parts rotate and scale around it.
+	 */
+	public var centroidX:Float = 0;
+
+	public var centroidY:Float = 0;
+	public var centroidZ:Float = 0;
+
+	/**
+	 * Radius of the bounding sphere around the center, -1 if there are no vertices.
+	 */
+	public var radius:Float = -1;
+
+	public var empty(get, never):Bool;
+
+	inline function get_empty():Bool
+		return radius < 0;
+
+	public function new() {}
+
+	/**
+	 * Reads 13 float32 (min xyz, max xyz, center xyz, radius, centroid xyz), the bounds block of a `.nmesh` part.
+	 */
+	public function readFrom(bytes:hl.Bytes, pos:Int)
+	{
+		minX = bytes.getF32(pos);
+		minY = bytes.getF32(pos + 4);
+		minZ = bytes.getF32(pos + 8);
+		maxX = bytes.getF32(pos + 12);
+		maxY = bytes.getF32(pos + 16);
+		maxZ = bytes.getF32(pos + 20);
+		centerX = bytes.getF32(pos + 24);
+		centerY = bytes.getF32(pos + 28);
+		centerZ = bytes.getF32(pos + 32);
+		radius = bytes.getF32(pos + 36);
+		centroidX = bytes.getF32(pos + 40);
+		centroidY = bytes.getF32(pos + 44);
+		centroidZ = bytes.getF32(pos + 48);
+	}
+
+	public function update(vertices:VertexBuffer)
+	{
+		var count = vertices.length;
+		if (count == 0)
+		{
+			minX = minY = minZ = maxX = maxY = maxZ = 0;
+			centerX = centerY = centerZ = 0;
+			centroidX = centroidY = centroidZ = 0;
+			radius = -1;
+			return;
+		}
+
+		minX = minY = minZ = Math.POSITIVE_INFINITY;
+		maxX = maxY = maxZ = Math.NEGATIVE_INFINITY;
+		var sumX = 0.0;
+		var sumY = 0.0;
+		var sumZ = 0.0;
+		for (i in 0...count)
+		{
+			var x = vertices.getX(i);
+			var y = vertices.getY(i);
+			var z = vertices.getZ(i);
+			sumX += x;
+			sumY += y;
+			sumZ += z;
+			if (x < minX)
+				minX = x;
+			if (x > maxX)
+				maxX = x;
+			if (y < minY)
+				minY = y;
+			if (y > maxY)
+				maxY = y;
+			if (z < minZ)
+				minZ = z;
+			if (z > maxZ)
+				maxZ = z;
+		}
+		centroidX = sumX / count;
+		centroidY = sumY / count;
+		centroidZ = sumZ / count;
+		centerX = (minX + maxX) * 0.5;
+		centerY = (minY + maxY) * 0.5;
+		centerZ = (minZ + maxZ) * 0.5;
+
+		// tighter than half the box diagonal
+		var radiusSq = 0.0;
+		for (i in 0...count)
+		{
+			var dx = vertices.getX(i) - centerX;
+			var dy = vertices.getY(i) - centerY;
+			var dz = vertices.getZ(i) - centerZ;
+			var distSq = dx * dx + dy * dy + dz * dz;
+			if (distSq > radiusSq)
+				radiusSq = distSq;
+		}
+		radius = Math.sqrt(radiusSq);
+	}
+}
@@ -0,0 +1,28 @@
+package nebula.mesh;
+
+import nebula.mesh.buffers.IndexBuffer;
+
+/**
+ * A simplified level of a `MeshPart`, made by `MeshSimplifier`.
+ * It only has its own indices, they point into the part's vertices (and uvs and normals).
+ */
+class MeshLOD
+{
+	public var indices(default, null):IndexBuffer;
+
+	/**
+	 * How far, in the part's local units, this level's surface is from the full detail one at most.
+	 */
+	public var error(default, null):Float;
+
+	public var triangleCount(get, never):Int;
+
+	public function new(indices:IndexBuffer, error:Float)
+	{
+		this.indices = indices;
+		this.error = error;
+	}
+
+	inline function get_triangleCount():Int
+		return Std.int(indices.length / 3);
+}
@@ -0,0 +1,68 @@
+package nebula.mesh;
+
+import nebula.mesh.buffers.*;
+import nebulatracer.MeshIOExt;
+
+/**
+ * Cleans up mesh parts with nebulatracer, meant to run once when a mesh is imported or converted.
+ * 
+ * - Vertices closer than `tolerance` are welded, as long as their normals and uvs match so seams are kept.
+ * - Triangles left with a repeated vertex or (practically) no area are dropped.
+ * - Triangles are reordered for the vertex cache and vertices are stored in the order they're first used, unused vertices are dropped.
+ * 
+ * The part gets new, smaller buffers. Both the rasterizer and Embree's BVH builder end up reading them mostly in order.
+ */
+class MeshOptimizer
+{
+	/**
+	 * The default weld distance, small enough to only merge vertices that were meant to be the same.
+	 */
+	public static inline var DEFAULT_TOLERANCE:Float = 0.00001;
+
+	static var counts:hl.Bytes = new hl.Bytes(12);
+
+	public static function optimizeMesh(mesh:Mesh, tolerance:Float = DEFAULT_TOLERANCE):Mesh
+	{
+		for (part in mesh.meshParts)
+			optimizePart(part, tolerance);
+		return mesh;
+	}
+
+	/**
+	 * @param tolerance How far apart (on each axis) vertices can be to get welded, 0 only welds exact copies.
+	 */
+	public static function optimizePart(part:MeshPart, tolerance:Float = DEFAULT_TOLERANCE):MeshPart
+	{
+		var vertexCount = part.vertices.length;
+		var indexCount = part.indices.length;
+		if (vertexCount == 0 || indexCount < 3)
+			return part;
+
+		// normals that aren't per vertex (like a single face normal) are left alone
+		var hasNormals = part.normals.length == vertexCount;
+		var hasUvs = part.uvt.length > 0;
+		var vertices = new VertexBuffer(vertexCount);
+		var normals = hasNormals ? new VertexBuffer(vertexCount) : null;
+		var uvt = hasUvs ? new FloatBuffer(Std.int(Math.max(part.uvt.length, vertexCount * 2))) : null;
+		var indices = new IndexBuffer(indexCount);
+		MeshIOExt.optimizeMeshPart(part.vertices.bytes, hasNormals ? part.normals.bytes : null, hasUvs ? part.uvt.bytes : null, part.uvt.length,
+			vertexCount, part.indices.bytes, indexCount, tolerance, vertices.bytes, hasNormals ? normals.bytes : null, hasUvs ? uvt.bytes : null,
+			indices.bytes, counts);
+
+		vertices.resize(counts.getI32(0));
+		indices.resize(counts.getI32(4));
+		part.vertices = vertices;
+		part.indices = indices;
+		if (hasNormals)
+		{
+			normals.resize(counts.getI32(0));
+			part.normals = normals;
+		}
+		if (hasUvs)
+		{
+			uvt.resize(counts.getI32(8));
+			part.uvt = uvt;
+		}
+		return part;
+	}
+}
@@ -2,20 +2,53 @@ package nebula.mesh;
 
 import flixel.graphics.FlxGraphic;
 import lime.utils.Log;
+import nebula.mesh.MeshAtlas.AtlasRegion;
+import nebula.mesh.buffers.*;
 import nebula.view.renderers.Raytracer.FloatColor;
 import nebula.view.renderers.Raytracer.Light;
-import openfl.Vector;
 import openfl.display.BitmapData;
 import openfl.display.BlendMode;
-import openfl.geom.Vector3D;
 import sys.FileSystem;
 
+/**
+ * Which triangles get dropped before drawing, by their winding on screen.
+ */
+enum abstract CullMode(Int)
+{
+	var NONE = 0;
+
+	/**
+	 * Drops triangles that appear clockwise on screen.
+	 */
+	var CW = 1;
+
+	/**
+	 * Drops triangles that appear counter clockwise on screen.
+	 */
+	var CCW = 2;
+}
+
 class MeshPart
 {
-	public var vertices:Vector<Vector3D> = new Vector<Vector3D>();
-	public var indices:Vector<Int> = new Vector<Int>();
-	public var uvt:Vector<Float> = new Vector<Float>();
-	public var normals:Vector<Vector3D> = new Vector<Vector3D>();
+	/**
+	 * Positions, stored as packed float32 x, y, z. Passed to nebulatracer without conversion, the raytracer copies a part when it's uploaded.
+	 */
+	public var vertices(default, set):VertexBuffer = new VertexBuffer();
+
+	public var indices(default, set):IndexBuffer = new IndexBuffer();
+	public var uvt(default, set):FloatBuffer = new FloatBuffer();
+	public var normals(default, set):VertexBuffer = new VertexBuffer();
+
+	/**
+	 * Goes up every time the geometry of this part changes, renderers compare it against the generation they last saw
+	 * to know if they have to look at this part again.
+	 * 
+	 * Writing to the buffers or assigning new ones bumps it, if you write to their `bytes` directly call `markDirty` yourself.
+	 */
+	public var generation(get, never):Int;
+
+	var _generation:Int = 0;
+
 	public var useColor:Bool = false;
 	public var color(default, set):Int = 0xFFFFFFFF;
 	public var _color:FloatColor = new FloatColor(0, 0, 0);
@@ -28,10 +61,46 @@ class MeshPart
 			isEmitter:Bool
 		};
 
+	public function markDirty()
+		_generation++;
+
+	inline function get_generation():Int
+		return _generation + vertices.generation + indices.generation + uvt.generation + normals.generation;
+
+	// the replaced buffer's generation is folded in so the total never goes back down
+	function set_vertices(val:VertexBuffer):VertexBuffer
+	{
+		_generation += vertices.generation + 1;
+		vertices = val == null ? new VertexBuffer() : val;
+		return vertices;
+	}
+
+	function set_indices(val:IndexBuffer):IndexBuffer
+	{
+		_generation += indices.generation + 1;
+		indices = val == null ? new IndexBuffer() : val;
+		return indices;
+	}
+
+	function set_uvt(val:FloatBuffer):FloatBuffer
+	{
+		_generation += uvt.generation + 1;
+		uvt = val == null ? new FloatBuffer() : val;
+		return uvt;
+	}
+
+	function set_normals(val:VertexBuffer):VertexBuffer
+	{
+		_generation += normals.generation + 1;
+		normals = val == null ? new VertexBuffer() : val;
+		return normals;
+	}
+
 	function set_color(val:Int):Int
 	{
 		this.color = val;
-		_graphic = FlxGraphic.fromBitmapData(new BitmapData(1, 1, true, val));
+		atlasRegion = MeshAtlas.addColor(val);
+		_graphic = atlasRegion.page.graphic;
 		_color = FloatColor.fromFlxColor(val);
 		return val;
 	}
@@ -39,17 +108,51 @@ class MeshPart
 	function set_graphic(val:String):String
 	{
 		this.graphic = val;
+		var bitmap:BitmapData;
+		var key = val;
 		if (!FileSystem.exists(val))
 		{
 			Log.warn('Failed to load mesh graphic from path: ${val}');
-			_graphic = FlxGraphic.fromBitmapData(FlixelIcon.getIcon());
+			bitmap = FlixelIcon.getIcon();
+			key = '__flixelicon';
 		}
 		else
-			_graphic = FlxGraphic.fromBitmapData(BitmapData.fromFile(val));
+			bitmap = BitmapData.fromFile(val);
 
+		_graphic = FlxGraphic.fromBitmapData(bitmap);
+		atlasRegion = MeshAtlas.addBitmap(key, bitmap);
 		return val;
 	}
 
+	/**
+	 * Whether renderers should draw this part from its atlas region.
+	 * Repeating textures can only come from the atlas while every UV stays within 0-1.
+	 */
+	public function usesAtlas():Bool
+	{
+		if (atlasRegion == null)
+			return false;
+		return atlasRegion.solid || !repeat || uvsInUnitRange();
+	}
+
+	function uvsInUnitRange():Bool
+	{
+		if (_uvRangeGeneration != uvt.generation)
+		{
+			_uvRangeGeneration = uvt.generation;
+			_uvsInUnitRange = true;
+			for (uv in uvt)
+			{
+				if (uv < 0 || uv > 1)
+				{
+					_uvsInUnitRange = false;
+					break;
+				}
+			}
+		}
+		return _uvsInUnitRange;
+	}
+
 	public function toString():String
 		return 'MeshPart: vertices: $vertices || indices: $indices || uvt: $uvt || graphic: $graphic';
 
@@ -57,10 +160,87 @@ class MeshPart
 	public var repeat:Bool = true;
 	public var blend:BlendMode = BlendMode.NORMAL;
 
+	/**
+	 * Back face culling, off by default since most meshes don't have consistent winding.
+	 */
+	public var cullMode:CullMode = NONE;
+
+	/**
+	 * Local space bounds of the vertices, only recomputed after the part changes.
+	 */
+	public var bounds(get, never):MeshBounds;
+
+	var _bounds:MeshBounds = new MeshBounds();
+	var _boundsGeneration:Int = -1;
+
+	/**
+	 * Uses precomputed bounds (e.g. from a `.nmesh`) until the part changes.
+	 */
+	public function presetBounds(bytes:hl.Bytes, pos:Int)
+	{
+		_bounds.readFrom(bytes, pos);
+		_boundsGeneration = generation;
+	}
+
+	function get_bounds():MeshBounds
+	{
+		var current = generation;
+		if (_boundsGeneration != current)
+		{
+			_bounds.update(vertices);
+			_boundsGeneration = current;
+		}
+		return _bounds;
+	}
+
+	/**
+	 * Simplified levels from finest to coarsest, see `MeshSimplifier`. They share this part's vertices
+	 * and are dropped once the part changes.
+	 */
+	public var lods(get, set):Array<MeshLOD>;
+
+	var _lods:Array<MeshLOD> = [];
+	var _lodGeneration:Int = -1;
+
+	function get_lods():Array<MeshLOD>
+	{
+		if (_lodGeneration != generation && _lods.length > 0)
+			_lods = [];
+		return _lods;
+	}
+
+	function set_lods(val:Array<MeshLOD>):Array<MeshLOD>
+	{
+		_lods = val == null ? [] : val;
+		_lodGeneration = generation;
+		return _lods;
+	}
+
+	/**
+	 * The indices of the coarsest level that's at most `error` (in local units) off, `indices` if none is.
+	 */
+	public function getLOD(error:Float):IndexBuffer
+	{
+		var lods = this.lods;
+		var i = lods.length - 1;
+		while (i >= 0 && lods[i].error > error)
+			i--;
+		return i >= 0 ? lods[i].indices : indices;
+	}
+
+	/**
+	 * Where this part's graphic lives in `MeshAtlas`, null if it didn't fit.
+	 */
+	public var atlasRegion(default, null):AtlasRegion;
+
 	@:allow(nebula.view.renderers.ViewRenderer)
+	@:allow(nebula.view.N3DView)
 	private var _graphic:FlxGraphic;
 
-	public function new(vertices:Vector<Vector3D>, indices:Vector<Int>, uvt:Vector<Float>, normals:Vector<Vector3D>, graphic:String, ?setGraphic:Bool = true)
+	var _uvRangeGeneration:Int = -1;
+	var _uvsInUnitRange:Bool = true;
+
+	public function new(vertices:VertexBuffer, indices:IndexBuffer, uvt:FloatBuffer, normals:VertexBuffer, graphic:String, ?setGraphic:Bool = true)
 	{
 		this.vertices = vertices;
 		this.indices = indices;
@@ -0,0 +1,54 @@
+package nebula.mesh;
+
+import nebula.mesh.buffers.IndexBuffer;
+import nebulatracer.MeshIOExt;
+
+/**
+ * Builds LOD chains with nebulatracer's quadric error simplifier.
+ * 
+ * Edges are collapsed onto existing vertices, so every level is only a new index buffer over the part's vertices.
+ * Open borders and uv/normal seams are kept in place, meshes made mostly of seams (like flat shaded ones) barely simplify.
+ */
+class MeshSimplifier
+{
+	/**
+	 * Parts with fewer triangles than this don't get a chain, it wouldn't save anything.
+	 */
+	public static inline var MIN_TRIANGLES:Int = 64;
+
+	static var errorOut:hl.Bytes = new hl.Bytes(4);
+
+	public static function buildMeshLODs(mesh:Mesh, maxLevels:Int = 4, ratio:Float = 0.5):Mesh
+	{
+		for (part in mesh.meshParts)
+			buildLODs(part, maxLevels, ratio);
+		return mesh;
+	}
+
+	/**
+	 * Fills `part.lods`, every level keeps about `ratio` of the triangles of the one before.
+	 * The chain stops early once a level can't be simplified much further or gets under `MIN_TRIANGLES`.
+	 */
+	public static function buildLODs(part:MeshPart, maxLevels:Int = 4, ratio:Float = 0.5):MeshPart
+	{
+		var lods:Array<MeshLOD> = [];
+		var indices = part.indices;
+		var error = 0.0;
+		while (lods.length < maxLevels && indices.length >= MIN_TRIANGLES * 3)
+		{
+			var target = Std.int(indices.length / 3 * ratio) * 3;
+			var simplified = new IndexBuffer(indices.length);
+			var count = MeshIOExt.simplifyMesh(part.vertices.bytes, part.vertices.length, indices.bytes, indices.length, target, Math.POSITIVE_INFINITY,
+				simplified.bytes, errorOut);
+			if (count > indices.length * 0.9)
+				break;
+			simplified.resize(count);
+			// each level is simplified from the previous one, so the errors add up
+			error += errorOut.getF32(0);
+			lods.push(new MeshLOD(simplified, error));
+			indices = simplified;
+		}
+		part.lods = lods;
+		return part;
+	}
+}
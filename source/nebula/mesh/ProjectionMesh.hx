@@ -1,15 +1,68 @@
 package nebula.mesh;
 
+import flixel.graphics.FlxGraphic;
+import nebula.mesh.MeshAtlas.AtlasRegion;
 import nebula.mesh.MeshPart;
-import openfl.Vector;
+import nebula.mesh.buffers.IndexBuffer;
 import openfl.geom.Vector3D;
 
-typedef ProjectionMesh =
+/**
+ * The screen space output of `N3DView`'s projection for one mesh part.
+ * 
+ * The projection writes into the native buffers (`screenVerts`, `screenUvt`, `screenIndices`, `screenDepth`).
+ */
+class ProjectionMesh
 {
-	var mesh:MeshPart;
-	var meshPos:Vector3D;
-	var verts:Vector<Float>;
-	var uvt:Vector<Float>;
-	var indices:Vector<Int>;
-	var camZ:Float;
+	public var mesh:MeshPart;
+
+	/**
+	 * The graphic to draw with, the atlas page if the part is drawn from `MeshAtlas`.
+	 * The projected UVs are already mapped into the part's region.
+	 */
+	public var graphic:FlxGraphic;
+
+	public var meshPos:Vector3D = new Vector3D();
+	public var camZ:Float = 0;
+
+	/**
+	 * The number of projected vertices, every 3 make a triangle.
+	 */
+	public var vertexCount:Int = 0;
+
+	public var screenVerts(default, null):hl.Bytes;
+	public var screenUvt(default, null):hl.Bytes;
+	public var screenIndices(default, null):hl.Bytes;
+
+	/**
+	 * 1/w of every vertex, used by the native rasterizer.
+	 */
+	public var screenDepth(default, null):hl.Bytes;
+
+	/**
+	 * How many vertices the native buffers can hold.
+	 */
+	public var capacity(default, null):Int = 0;
+
+	/**
+	 * What this projection was made from, `N3DView` reprojects only when one of these changes.
+	 */
+	public var worldVersion:Int = -1;
+
+	public var cameraVersion:Int = -1;
+	public var region:AtlasRegion;
+	public var cullMode:CullMode = NONE;
+	public var lodIndices:IndexBuffer;
+
+	public function new() {}
+
+	public function reserve(vertexCount:Int)
+	{
+		if (vertexCount <= capacity)
+			return;
+		capacity = Std.int(Math.max(vertexCount, capacity * 2));
+		screenVerts = new hl.Bytes(capacity * 2 * 4);
+		screenUvt = new hl.Bytes(capacity * 3 * 4);
+		screenIndices = new hl.Bytes(capacity * 4);
+		screenDepth = new hl.Bytes(capacity * 4);
+	}
 }
@@ -0,0 +1,76 @@
+package nebula.mesh.buffers;
+
+import openfl.Vector;
+
+/**
+ * A flat float32 buffer, used for UVs. Indexes like a `Vector<Float>`.
+ */
+@:forward(bytes, length, capacity, generation, reserve, resize, markDirty)
+abstract FloatBuffer(RawBuffer) from RawBuffer to RawBuffer
+{
+	public inline function new(length:Int = 0)
+	{
+		this = new RawBuffer(length);
+		this.resize(length);
+	}
+
+	@:arrayAccess inline function get(index:Int):Float
+		return this.getF32(index);
+
+	@:arrayAccess inline function set(index:Int, value:Float):Float
+	{
+		this.setF32(index, value);
+		return value;
+	}
+
+	public inline function push(value:Float):Int
+	{
+		this.pushF32(value);
+		return this.length;
+	}
+
+	public inline function iterator():FloatBufferIterator
+		return new FloatBufferIterator(this);
+
+	public inline function copy():FloatBuffer
+		return this.copy();
+
+	@:from static function fromVector(vector:Vector<Float>):FloatBuffer
+	{
+		var buffer = new FloatBuffer();
+		if (vector != null)
+		{
+			buffer.reserve(vector.length);
+			for (value in vector)
+				buffer.push(value);
+		}
+		return buffer;
+	}
+
+	@:from static function fromArray(array:Array<Float>):FloatBuffer
+	{
+		var buffer = new FloatBuffer();
+		if (array != null)
+		{
+			buffer.reserve(array.length);
+			for (value in array)
+				buffer.push(value);
+		}
+		return buffer;
+	}
+}
+
+private class FloatBufferIterator
+{
+	var buffer:RawBuffer;
+	var index:Int = 0;
+
+	public inline function new(buffer:RawBuffer)
+		this.buffer = buffer;
+
+	public inline function hasNext():Bool
+		return index < buffer.length;
+
+	public inline function next():Float
+		return buffer.getF32(index++);
+}
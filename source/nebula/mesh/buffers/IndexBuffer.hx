@@ -0,0 +1,76 @@
+package nebula.mesh.buffers;
+
+import openfl.Vector;
+
+/**
+ * A flat int32 buffer of triangle indices. Indexes like a `Vector<Int>`.
+ */
+@:forward(bytes, length, capacity, generation, reserve, resize, markDirty)
+abstract IndexBuffer(RawBuffer) from RawBuffer to RawBuffer
+{
+	public inline function new(length:Int = 0)
+	{
+		this = new RawBuffer(length);
+		this.resize(length);
+	}
+
+	@:arrayAccess inline function get(index:Int):Int
+		return this.getI32(index);
+
+	@:arrayAccess inline function set(index:Int, value:Int):Int
+	{
+		this.setI32(index, value);
+		return value;
+	}
+
+	public inline function push(value:Int):Int
+	{
+		this.pushI32(value);
+		return this.length;
+	}
+
+	public inline function iterator():IndexBufferIterator
+		return new IndexBufferIterator(this);
+
+	public inline function copy():IndexBuffer
+		return this.copy();
+
+	@:from static function fromVector(vector:Vector<Int>):IndexBuffer
+	{
+		var buffer = new IndexBuffer();
+		if (vector != null)
+		{
+			buffer.reserve(vector.length);
+			for (value in vector)
+				buffer.push(value);
+		}
+		return buffer;
+	}
+
+	@:from static function fromArray(array:Array<Int>):IndexBuffer
+	{
+		var buffer = new IndexBuffer();
+		if (array != null)
+		{
+			buffer.reserve(array.length);
+			for (value in array)
+				buffer.push(value);
+		}
+		return buffer;
+	}
+}
+
+private class IndexBufferIterator
+{
+	var buffer:RawBuffer;
+	var index:Int = 0;
+
+	public inline function new(buffer:RawBuffer)
+		this.buffer = buffer;
+
+	public inline function hasNext():Bool
+		return index < buffer.length;
+
+	public inline function next():Int
+		return buffer.getI32(index++);
+}
@@ -0,0 +1,153 @@
+package nebula.mesh.buffers;
+
+/**
+ * A growable, contiguous block of 4 byte elements.
+ * This is the storage behind `FloatBuffer`, `VertexBuffer` and `IndexBuffer`, `bytes` is passed as is to nebulatracer's calls
+ * (which copy what they keep).
+ * 
+ * `bytes` gets reallocated when the buffer grows, so don't hold on to it across pushes.
+ * 
+ * A buffer made with `wrap` reads memory it doesn't own (like a memory mapped file) and copies it on the first write.
+ */
+class RawBuffer
+{
+	public var bytes(default, null):hl.Bytes;
+
+	/**
+	 * The number of elements in the buffer.
+	 */
+	public var length(default, null):Int = 0;
+
+	public var capacity(default, null):Int = 0;
+
+	/**
+	 * Bumped on every write, used to tell if the data changed without looking at it.
+	 */
+	public var generation(default, null):Int = 0;
+
+	/**
+	 * Whether `bytes` is memory this buffer doesn't own, see `wrap`.
+	 */
+	public var external(default, null):Bool = false;
+
+	public function new(capacity:Int = 0)
+	{
+		this.capacity = capacity;
+		bytes = new hl.Bytes(capacity << 2);
+	}
+
+	/**
+	 * Wraps `length` elements at `bytes` without copying them.
+	 * The memory has to stay valid while the buffer uses it.
+	 * Don't write to `bytes` of a wrapped buffer directly, use the setters so it gets copied first.
+	 */
+	public static function wrap(bytes:hl.Bytes, length:Int):RawBuffer
+	{
+		var buffer = new RawBuffer(0);
+		buffer.bytes = bytes;
+		buffer.length = length;
+		buffer.capacity = length;
+		buffer.external = true;
+		return buffer;
+	}
+
+	// wrapped memory may be read only, take a copy before writing to it
+	function detach()
+	{
+		var owned = new hl.Bytes(length << 2);
+		owned.blit(0, bytes, 0, length << 2);
+		bytes = owned;
+		capacity = length;
+		external = false;
+	}
+
+	public inline function getF32(index:Int):Float
+		return bytes.getF32(index << 2);
+
+	public inline function setF32(index:Int, value:Float)
+	{
+		if (external)
+			detach();
+		if (index >= length)
+			resize(index + 1);
+		bytes.setF32(index << 2, value);
+		generation++;
+	}
+
+	public inline function getI32(index:Int):Int
+		return bytes.getI32(index << 2);
+
+	public inline function setI32(index:Int, value:Int)
+	{
+		if (external)
+			detach();
+		if (index >= length)
+			resize(index + 1);
+		bytes.setI32(index << 2, value);
+		generation++;
+	}
+
+	public inline function pushF32(value:Float)
+	{
+		if (length == capacity)
+			reserve(length + 1);
+		bytes.setF32(length << 2, value);
+		length++;
+		generation++;
+	}
+
+	public inline function pushI32(value:Int)
+	{
+		if (length == capacity)
+			reserve(length + 1);
+		bytes.setI32(length << 2, value);
+		length++;
+		generation++;
+	}
+
+	/**
+	 * Makes sure the buffer can hold `count` elements without reallocating.
+	 */
+	public function reserve(count:Int)
+	{
+		if (count <= capacity)
+			return;
+		external = false;
+		var newCapacity = capacity < 4 ? 4 : capacity;
+		while (newCapacity < count)
+			newCapacity *= 2;
+		var grown = new hl.Bytes(newCapacity << 2);
+		grown.blit(0, bytes, 0, length << 2);
+		bytes = grown;
+		capacity = newCapacity;
+	}
+
+	/**
+	 * Sets the number of elements, new elements are zeroed.
+	 */
+	public function resize(count:Int)
+	{
+		reserve(count);
+		if (count > length)
+			bytes.fill(length << 2, (count - length) << 2, 0);
+		length = count;
+		generation++;
+	}
+
+	/**
+	 * Call this after writing to `bytes` directly.
+	 */
+	public inline function markDirty()
+		generation++;
+
+	public function copy():RawBuffer
+	{
+		var copied = new RawBuffer(length);
+		copied.bytes.blit(0, bytes, 0, length << 2);
+		copied.length = length;
+		return copied;
+	}
+
+	public function toString():String
+		return 'RawBuffer($length)';
+}
@@ -0,0 +1,118 @@
+package nebula.mesh.buffers;
+
+import openfl.Vector;
+import openfl.geom.Vector3D;
+
+/**
+ * Packed float32 x, y, z triples, used for positions and normals.
+ * 
+ * Indexing returns a new `Vector3D` so old code keeps working, hot paths should use `getX`/`getY`/`getZ` and `setXYZ` instead.
+ */
+@:forward(bytes, capacity, generation, markDirty)
+abstract VertexBuffer(RawBuffer) from RawBuffer to RawBuffer
+{
+	/**
+	 * The number of vertices in the buffer.
+	 */
+	public var length(get, never):Int;
+
+	public inline function new(length:Int = 0)
+	{
+		this = new RawBuffer(length * 3);
+		this.resize(length * 3);
+	}
+
+	inline function get_length():Int
+		return Std.int(this.length / 3);
+
+	public inline function getX(index:Int):Float
+		return this.getF32(index * 3);
+
+	public inline function getY(index:Int):Float
+		return this.getF32(index * 3 + 1);
+
+	public inline function getZ(index:Int):Float
+		return this.getF32(index * 3 + 2);
+
+	public inline function setXYZ(index:Int, x:Float, y:Float, z:Float)
+	{
+		this.setF32(index * 3, x);
+		this.setF32(index * 3 + 1, y);
+		this.setF32(index * 3 + 2, z);
+	}
+
+	public inline function pushXYZ(x:Float, y:Float, z:Float):Int
+	{
+		this.pushF32(x);
+		this.pushF32(y);
+		this.pushF32(z);
+		return length;
+	}
+
+	@:arrayAccess inline function get(index:Int):Vector3D
+		return new Vector3D(getX(index), getY(index), getZ(index));
+
+	@:arrayAccess inline function set(index:Int, vertex:Vector3D):Vector3D
+	{
+		setXYZ(index, vertex.x, vertex.y, vertex.z);
+		return vertex;
+	}
+
+	public inline function push(vertex:Vector3D):Int
+		return pushXYZ(vertex.x, vertex.y, vertex.z);
+
+	public inline function reserve(count:Int)
+		this.reserve(count * 3);
+
+	public inline function resize(count:Int)
+		this.resize(count * 3);
+
+	public inline function iterator():VertexBufferIterator
+		return new VertexBufferIterator(this);
+
+	public inline function copy():VertexBuffer
+		return this.copy();
+
+	@:from static function fromVector(vector:Vector<Vector3D>):VertexBuffer
+	{
+		var buffer = new VertexBuffer();
+		if (vector != null)
+		{
+			buffer.reserve(vector.length);
+			for (vertex in vector)
+				buffer.push(vertex);
+		}
+		return buffer;
+	}
+
+	@:from static function fromArray(array:Array<Vector3D>):VertexBuffer
+	{
+		var buffer = new VertexBuffer();
+		if (array != null)
+		{
+			buffer.reserve(array.length);
+			for (vertex in array)
+				buffer.push(vertex);
+		}
+		return buffer;
+	}
+}
+
+private class VertexBufferIterator
+{
+	var buffer:RawBuffer;
+	var index:Int = 0;
+
+	public inline function new(buffer:RawBuffer)
+		this.buffer = buffer;
+
+	public inline function hasNext():Bool
+		return index < buffer.length;
+
+	public inline function next():Vector3D
+	{
+		var vertex = new Vector3D(buffer.getF32(index), buffer.getF32(index + 1), buffer.getF32(index + 2));
+		index += 3;
+		return vertex;
+	}
+}
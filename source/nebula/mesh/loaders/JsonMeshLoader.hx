@@ -3,10 +3,9 @@ package nebula.mesh.loaders;
 import haxe.Json;
 import lime.utils.Log;
 import nebula.mesh.MeshPart;
+import nebula.mesh.buffers.*;
 import nebula.mesh.datatypes.MeshJson;
 import nebula.mesh.loaders.MeshLoader.MeshData;
-import openfl.Vector;
-import openfl.geom.Vector3D;
 import sys.io.File;
 
 class JsonMeshLoader implements MeshLoader
@@ -22,17 +21,14 @@ class JsonMeshLoader implements MeshLoader
 			var meshParts:Array<MeshPart> = [];
 			for (meshPart in json.meshParts)
 			{
-				var vertices:Vector<Vector3D> = new Vector<Vector3D>();
+				var vertices = new VertexBuffer();
+				vertices.reserve(meshPart.vertices.length);
 				for (vertex in meshPart.vertices)
-					vertices.push(new Vector3D(vertex.x, vertex.y, vertex.z, vertex.w));
-				var indices:Vector<Int> = new Vector<Int>();
-				for (index in meshPart.indices)
-					indices.push(index);
-				var uvt:Vector<Float> = new Vector<Float>();
-				for (uv in meshPart.uvt)
-					uvt.push(uv);
+					vertices.pushXYZ(vertex.x, vertex.y, vertex.z);
+				var indices:IndexBuffer = meshPart.indices;
+				var uvt:FloatBuffer = meshPart.uvt;
 
-				meshParts.push(new MeshPart(vertices, indices, uvt, meshPart.graphic));
+				meshParts.push(new MeshPart(vertices, indices, uvt, null, meshPart.graphic));
 			}
 			return new Mesh(0, 0, 0, meshParts);
 		}
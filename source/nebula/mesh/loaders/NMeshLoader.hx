@@ -0,0 +1,121 @@
+package nebula.mesh.loaders;
+
+import haxe.ds.ObjectMap;
+import haxe.io.Bytes;
+import lime.utils.Log;
+import nebula.mesh.buffers.*;
+import nebula.mesh.loaders.MeshLoader.MeshData;
+import nebula.mesh.savers.NMeshSaver;
+import nebulatracer.MeshIOExt;
+
+/**
+ * Loads `.nmesh` files (see `NMeshSaver` for the layout).
+ * 
+ * The file is memory mapped and the part buffers read its streams in place, nothing is parsed or copied on load.
+ * A buffer only gets its own copy once it's written to, and the raytracer copies a part when it's uploaded.
+ * The file stays mapped as long as the mesh uses it, call `NMeshLoader.close` once the mesh is thrown away.
+ * LODs aren't stored in the file, turn `generateLODs` on to build them with `MeshSimplifier` on load (it's slow for big meshes).
+ */
+class NMeshLoader implements MeshLoader
+{
+	public var generateLODs:Bool = false;
+
+	static var openFiles:ObjectMap<Mesh, Int> = new ObjectMap();
+
+	public function new() {}
+
+	/**
+	 * Unmaps the file behind a mesh loaded by this loader. Buffers of the mesh that weren't written to still read the file,
+	 * so the mesh can't be used afterwards.
+	 */
+	public static function close(mesh:Mesh)
+	{
+		if (!openFiles.exists(mesh))
+			return;
+		MeshIOExt.closeNMesh(openFiles.get(mesh));
+		openFiles.remove(mesh);
+	}
+
+	/**
+	 * @param meshData The contents of a `.nmesh` as `haxe.io.Bytes`, they get copied once into aligned memory.
+	 */
+	public function loadMesh(meshData:MeshData, ?manageError:Bool = true):Mesh
+	{
+		try
+		{
+			var bytes:Bytes = cast meshData;
+			var id = MeshIOExt.openNMeshData(bytes.getData(), bytes.length);
+			if (id == -1)
+				throw 'Not a valid NMESH';
+			return readNMesh(id);
+		}
+		catch (e)
+		{
+			if (manageError)
+				Log.error('Error loading mesh from NMESH: ${e.message}\n${e.stack.toString()}');
+			return null;
+		}
+	}
+
+	public function loadMeshFromFile(path:String, ?manageError:Bool = true):Mesh
+	{
+		try
+		{
+			var id = MeshIOExt.openNMesh(path);
+			if (id == -1)
+				throw 'Could not open the file or it is not a valid NMESH';
+			return readNMesh(id);
+		}
+		catch (e)
+		{
+			if (manageError)
+				Log.error('Error loading mesh from NMESH at path ($path): ${e.message}\n${e.stack.toString()}');
+			return null;
+		}
+	}
+
+	function readNMesh(id:Int):Mesh
+	{
+		try
+		{
+			var mesh = readParts(id);
+			openFiles.set(mesh, id);
+			return mesh;
+		}
+		catch (e)
+		{
+			MeshIOExt.closeNMesh(id);
+			throw e;
+		}
+	}
+
+	function readParts(id:Int):Mesh
+	{
+		var info = new hl.Bytes(5 * 4 + NMeshSaver.BOUNDS_SIZE);
+		var meshParts:Array<MeshPart> = [];
+		for (i in 0...MeshIOExt.getNMeshPartCount(id))
+		{
+			MeshIOExt.getNMeshPartInfo(id, i, info);
+			var vertexCount = info.getI32(0);
+			var indexCount = info.getI32(4);
+			var uvCount = info.getI32(8);
+			var flags = info.getI32(12);
+
+			var vertices:VertexBuffer = RawBuffer.wrap(MeshIOExt.getNMeshStream(id, i, 0), vertexCount * 3);
+			var normals:VertexBuffer = flags & NMeshSaver.HAS_NORMALS != 0 ? RawBuffer.wrap(MeshIOExt.getNMeshStream(id, i, 1), vertexCount * 3) : null;
+			var uvt:FloatBuffer = RawBuffer.wrap(MeshIOExt.getNMeshStream(id, i, 2), uvCount);
+			var indices:IndexBuffer = RawBuffer.wrap(MeshIOExt.getNMeshStream(id, i, 3), indexCount);
+
+			var graphic = MeshIOExt.getNMeshGraphic(id, i);
+			var part = new MeshPart(vertices, indices, uvt, normals, graphic, graphic != '');
+			if (flags & NMeshSaver.HAS_COLOR != 0)
+				part.color = info.getI32(16);
+			if (flags & NMeshSaver.HAS_BOUNDS != 0)
+				part.presetBounds(info, 20);
+			if (generateLODs)
+				MeshSimplifier.buildLODs(part);
+			meshParts.push(part);
+		}
+		return new Mesh(0, 0, 0, meshParts);
+	}
+}
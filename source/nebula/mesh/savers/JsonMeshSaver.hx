@@ -15,12 +15,12 @@ class JsonMeshSaver implements MeshSaver
 		for (meshPart in mesh.meshParts)
 		{
 			var vertices:Array<Vec3D> = [];
-			for (vertex in meshPart.vertices)
+			for (i in 0...meshPart.vertices.length)
 				vertices.push({
-					x: vertex.x,
-					y: vertex.y,
-					z: vertex.z,
-					w: vertex.w
+					x: meshPart.vertices.getX(i),
+					y: meshPart.vertices.getY(i),
+					z: meshPart.vertices.getZ(i),
+					w: 0
 				});
 			var indices:Array<Int> = [];
 			for (index in meshPart.indices)
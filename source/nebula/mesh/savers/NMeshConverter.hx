@@ -0,0 +1,53 @@
+package nebula.mesh.savers;
+
+import lime.utils.Log;
+import nebula.mesh.loaders.JsonMeshLoader;
+import nebula.mesh.loaders.MeshLoader;
+import nebula.mesh.loaders.OBJMeshLoader;
+
+/**
+ * Converts meshes to `.nmesh` ahead of time, so loading them at runtime is just a memory map.
+ * Meshes go through `MeshOptimizer` first unless `optimize` is false.
+ */
+class NMeshConverter
+{
+	/**
+	 * Converts an OBJ (and its mtllib) to `.nmesh`.
+	 * @return Whether the conversion worked.
+	 */
+	public static function fromOBJ(objPath:String, nmeshPath:String, ?optimize:Bool = true, ?manageError:Bool = true):Bool
+	{
+		var loader = new OBJMeshLoader();
+		// optimized once below instead, and LODs aren't saved
+		loader.optimize = false;
+		loader.generateLODs = false;
+		return convert(loader, objPath, nmeshPath, optimize, manageError);
+	}
+
+	/**
+	 * Converts a mesh saved by `JsonMeshSaver` to `.nmesh`.
+	 * @return Whether the conversion worked.
+	 */
+	public static function fromJson(jsonPath:String, nmeshPath:String, ?optimize:Bool = true, ?manageError:Bool = true):Bool
+		return convert(new JsonMeshLoader(), jsonPath, nmeshPath, optimize, manageError);
+
+	static function convert(loader:MeshLoader, path:String, nmeshPath:String, optimize:Bool, manageError:Bool):Bool
+	{
+		var mesh = loader.loadMeshFromFile(path, manageError);
+		if (mesh == null)
+			return false;
+		if (optimize)
+			MeshOptimizer.optimizeMesh(mesh);
+		try
+		{
+			sys.io.File.saveBytes(nmeshPath, new NMeshSaver().encodeMesh(mesh));
+			return true;
+		}
+		catch (e)
+		{
+			if (manageError)
+				Log.error('Error converting ($path) to NMESH at path ($nmeshPath): ${e.message}\n${e.stack.toString()}');
+			return false;
+		}
+	}
+}
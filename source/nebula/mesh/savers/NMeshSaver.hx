@@ -0,0 +1,143 @@
+package nebula.mesh.savers;
+
+import haxe.io.Bytes;
+import lime.utils.Log;
+import sys.io.File;
+
+/**
+ * Saves meshes as `.nmesh`, nebulatracer's binary mesh format. Load them with `NMeshLoader`.
+ * 
+ * Layout (little endian, version 1):
+ * - Header (32 bytes): `NMSH`, version, part count, reserved, part table offset (u64), file size (u64)
+ * - Part table, 72 bytes per part: vertex count, index count, uv count, flags, then u64 offsets of the position, normal, uv,
+ *   index and bounds streams and of the graphic path, the graphic path length and an ARGB color
+ * - The streams: float32 positions and normals (x, y, z), float32 uvs, uint32 indices, 13 float32 of bounds
+ *   (min, max, center, radius, centroid) and the UTF-8 graphic path.
+ * 
+ * Every stream starts on a 16 byte boundary, so the loader can wrap it in place.
+ */
+class NMeshSaver implements MeshSaver
+{
+	public static inline var VERSION:Int = 1;
+	public static inline var HEADER_SIZE:Int = 32;
+	public static inline var PART_ENTRY_SIZE:Int = 72;
+	public static inline var HAS_NORMALS:Int = 1;
+	public static inline var HAS_BOUNDS:Int = 2;
+	public static inline var HAS_COLOR:Int = 4;
+	public static inline var BOUNDS_SIZE:Int = 13 * 4;
+
+	public function new() {}
+
+	public function encodeMesh(mesh:Mesh):Bytes
+	{
+		var parts = mesh.meshParts;
+		var graphics = [for (part in parts) Bytes.ofString(part.graphic == null ? '' : part.graphic)];
+
+		// lay out every stream first so the file can be written in one go
+		var size = HEADER_SIZE + parts.length * PART_ENTRY_SIZE;
+		var offsets:Array<Array<Int>> = [];
+		for (i in 0...parts.length)
+		{
+			var part = parts[i];
+			var vertexCount = part.vertices.length;
+			var hasNormals = part.normals.length == vertexCount && vertexCount > 0;
+			var partOffsets = [];
+			for (stream in [
+				vertexCount * 12,
+				hasNormals ? vertexCount * 12 : -1,
+				part.uvt.length * 4,
+				part.indices.length * 4,
+				part.bounds.empty ? -1 : BOUNDS_SIZE
+			])
+			{
+				if (stream < 0)
+				{
+					partOffsets.push(0);
+					continue;
+				}
+				size = align(size);
+				partOffsets.push(size);
+				size += stream;
+			}
+			partOffsets.push(size);
+			size += graphics[i].length;
+			offsets.push(partOffsets);
+		}
+
+		var out = Bytes.alloc(size);
+		out.fill(0, size, 0);
+		var data:hl.Bytes = out.getData();
+		out.blit(0, Bytes.ofString('NMSH'), 0, 4);
+		out.setInt32(4, VERSION);
+		out.setInt32(8, parts.length);
+		out.setInt32(12, 0);
+		writeOffset(out, 16, HEADER_SIZE);
+		writeOffset(out, 24, size);
+
+		for (i in 0...parts.length)
+		{
+			var part = parts[i];
+			var partOffsets = offsets[i];
+			var entry = HEADER_SIZE + i * PART_ENTRY_SIZE;
+			var vertexCount = part.vertices.length;
+			var flags = 0;
+			if (partOffsets[1] != 0)
+				flags |= HAS_NORMALS;
+			if (partOffsets[4] != 0)
+				flags |= HAS_BOUNDS;
+			if (part.graphic == null || part.graphic == '')
+				flags |= HAS_COLOR;
+
+			out.setInt32(entry, vertexCount);
+			out.setInt32(entry + 4, part.indices.length);
+			out.setInt32(entry + 8, part.uvt.length);
+			out.setInt32(entry + 12, flags);
+			for (j in 0...6)
+				writeOffset(out, entry + 16 + j * 8, partOffsets[j]);
+			out.setInt32(entry + 64, graphics[i].length);
+			out.setInt32(entry + 68, part.color);
+
+			data.blit(partOffsets[0], part.vertices.bytes, 0, vertexCount * 12);
+			if (flags & HAS_NORMALS != 0)
+				data.blit(partOffsets[1], part.normals.bytes, 0, vertexCount * 12);
+			data.blit(partOffsets[2], part.uvt.bytes, 0, part.uvt.length * 4);
+			data.blit(partOffsets[3], part.indices.bytes, 0, part.indices.length * 4);
+			if (flags & HAS_BOUNDS != 0)
+			{
+				var b = part.bounds;
+				var pos = partOffsets[4];
+				for (value in [
+					b.minX, b.minY, b.minZ, b.maxX, b.maxY, b.maxZ, b.centerX, b.centerY, b.centerZ, b.radius, b.centroidX, b.centroidY, b.centroidZ
+				])
+				{
+					out.setFloat(pos, value);
+					pos += 4;
+				}
+			}
+			out.blit(partOffsets[5], graphics[i], 0, graphics[i].length);
+		}
+		return out;
+	}
+
+	public function saveMesh(mesh:Mesh, path:String, ?manageError:Bool = true)
+	{
+		try
+		{
+			File.saveBytes(path, encodeMesh(mesh));
+		}
+		catch (e)
+		{
+			if (manageError)
+				Log.error('Error saving mesh to NMESH at path ($path): ${e.message}\n${e.stack.toString()}');
+		}
+	}
+
+	static inline function align(offset:Int):Int
+		return (offset + 15) & ~15;
+
+	static inline function writeOffset(out:Bytes, pos:Int, offset:Int)
+	{
+		out.setInt32(pos, offset);
+		out.setInt32(pos + 4, 0);
+	}
+}
@@ -2,10 +2,28 @@ package nebula.tonemapper;
 
 import flixel.math.FlxMath;
 import flixel.util.FlxColor;
+import nebula.utils.BitmapDataHelper;
 import nebula.view.renderers.Raytracer.FloatColor;
+import nebulatracer.FramebufferExt;
+import openfl.display.BitmapData;
 
-class ACESTonemapper implements Tonemapper
+class ACESTonemapper implements BatchTonemapper
 {
+	/**
+	 * Native operator id, must match `TONEMAP_ACES` in nebulatracer.cpp.
+	 */
+	static inline var OPERATOR:Int = 1;
+
+	/**
+	 * Colors are multiplied by this before mapping.
+	 */
+	public var exposure:Float = 1;
+
+	/**
+	 * Encodes the output as sRGB instead of writing the mapped values as they are.
+	 */
+	public var srgb:Bool = false;
+
 	public function new() {}
 
 	// my brain melted
@@ -19,16 +37,27 @@ class ACESTonemapper implements Tonemapper
 		return Math.min(1.0, Math.max(0.0, (x * (a * x + b)) / (x * (c * x + d) + e)));
 	}
 
+	inline function encode(x:Float):Float
+		return srgb ? (x <= 0.0031308 ? x * 12.92 : 1.055 * Math.pow(x, 1 / 2.4) - 0.055) : x;
+
 	public function map(color:FloatColor):FlxColor
 	{
-		var r = acesTonemap(color.red);
-		var g = acesTonemap(color.green);
-		var b = acesTonemap(color.blue);
+		var r = encode(acesTonemap(color.red * exposure));
+		var g = encode(acesTonemap(color.green * exposure));
+		var b = encode(acesTonemap(color.blue * exposure));
 
+		// rounded to the nearest byte, same as mapFrame
 		var finalColor:FlxColor = 0x000000;
-		finalColor.red = Std.int(r * 255);
-		finalColor.green = Std.int(g * 255);
-		finalColor.blue = Std.int(b * 255);
+		finalColor.red = Std.int(r * 255 + 0.5);
+		finalColor.green = Std.int(g * 255 + 0.5);
+		finalColor.blue = Std.int(b * 255 + 0.5);
 		return finalColor;
 	}
+
+	public function mapFrame(color:hl.Bytes, width:Int, height:Int, bitmap:BitmapData)
+	{
+		FramebufferExt.tonemapFrame(color, width, height, BitmapDataHelper.getPixelBytes(bitmap), BitmapDataHelper.getPixelFormat(bitmap), OPERATOR,
+			exposure, srgb);
+		BitmapDataHelper.markDirty(bitmap);
+	}
 }
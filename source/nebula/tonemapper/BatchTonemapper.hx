@@ -0,0 +1,14 @@
+package nebula.tonemapper;
+
+import openfl.display.BitmapData;
+
+/**
+ * A tonemapper that can also map a whole frame at once, natively.
+ */
+interface BatchTonemapper extends Tonemapper
+{
+	/**
+	 * Tonemaps `color` (float32 r, g, b per pixel, `width * height` of them) straight into the pixels of `bitmap`.
+	 */
+	public function mapFrame(color:hl.Bytes, width:Int, height:Int, bitmap:BitmapData):Void;
+}
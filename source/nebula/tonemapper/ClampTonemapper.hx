@@ -1,21 +1,50 @@
 package nebula.tonemapper;
 
 import flixel.util.FlxColor;
+import nebula.utils.BitmapDataHelper;
 import nebula.view.renderers.Raytracer.FloatColor;
+import nebulatracer.FramebufferExt;
+import openfl.display.BitmapData;
 
 /**
  * This is the default tonemapper, this tonemapper isn't reccomended for use as it won't look the best in most cases.
  */
-class ClampTonemapper implements Tonemapper
+class ClampTonemapper implements BatchTonemapper
 {
+	/**
+	 * Native operator id, must match `TONEMAP_CLAMP` in nebulatracer.cpp.
+	 */
+	static inline var OPERATOR:Int = 0;
+
+	/**
+	 * Colors are multiplied by this before mapping.
+	 */
+	public var exposure:Float = 1;
+
+	/**
+	 * Encodes the output as sRGB instead of writing the mapped values as they are.
+	 */
+	public var srgb:Bool = false;
+
 	public function new() {}
 
+	inline function encode(x:Float):Float
+		return srgb ? (x <= 0.0031308 ? x * 12.92 : 1.055 * Math.pow(x, 1 / 2.4) - 0.055) : x;
+
 	public function map(color:FloatColor):FlxColor
 	{
+		// rounded to the nearest byte, same as mapFrame
 		var finalColor:FlxColor = 0x000000;
-		finalColor.red = cast Math.min(255, Math.max(0, color.red * 255));
-		finalColor.green = cast Math.min(255, Math.max(0, color.green * 255));
-		finalColor.blue = cast Math.min(255, Math.max(0, color.blue * 255));
+		finalColor.red = Std.int(encode(Math.min(1, Math.max(0, color.red * exposure))) * 255 + 0.5);
+		finalColor.green = Std.int(encode(Math.min(1, Math.max(0, color.green * exposure))) * 255 + 0.5);
+		finalColor.blue = Std.int(encode(Math.min(1, Math.max(0, color.blue * exposure))) * 255 + 0.5);
 		return finalColor;
 	}
+
+	public function mapFrame(color:hl.Bytes, width:Int, height:Int, bitmap:BitmapData)
+	{
+		FramebufferExt.tonemapFrame(color, width, height, BitmapDataHelper.getPixelBytes(bitmap), BitmapDataHelper.getPixelFormat(bitmap), OPERATOR,
+			exposure, srgb);
+		BitmapDataHelper.markDirty(bitmap);
+	}
 }
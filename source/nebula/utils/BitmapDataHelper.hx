@@ -0,0 +1,40 @@
+package nebula.utils;
+
+import openfl.display.BitmapData;
+
+/**
+ * Direct access to the pixels of a `BitmapData`, for native code that reads or writes them in place.
+ */
+class BitmapDataHelper
+{
+	/**
+	 * The pixels of `bitmap` in memory, 4 bytes per pixel in the format given by `getPixelFormat`.
+	 * Returns null if the bitmap has no image in memory (e.g. after `disposeImage`).
+	 */
+	public static function getPixelBytes(bitmap:BitmapData):hl.Bytes
+	{
+		if (bitmap == null || bitmap.image == null)
+			return null;
+		var data = bitmap.image.buffer.data;
+		var bytes:hl.Bytes = data.buffer.getData();
+		return bytes.offset(data.byteOffset);
+	}
+
+	/**
+	 * The lime `PixelFormat` of `bitmap`'s pixels, as an Int for the native side.
+	 */
+	public static function getPixelFormat(bitmap:BitmapData):Int
+		return cast bitmap.image.buffer.format;
+
+	public static function isPremultiplied(bitmap:BitmapData):Bool
+		return bitmap.image.buffer.premultiplied;
+
+	/**
+	 * Call after writing to the pixels directly, so the bitmap gets uploaded again.
+	 */
+	public static function markDirty(bitmap:BitmapData)
+	{
+		bitmap.image.dirty = true;
+		bitmap.image.version++;
+	}
+}
@@ -1,35 +1,19 @@
 package nebula.view;
 
 import flixel.*;
+import haxe.ds.ObjectMap;
 import lime.utils.Log;
 import nebula.mesh.*;
+import nebula.mesh.Mesh.WorldSpacePart;
+import nebula.mesh.buffers.IndexBuffer;
 import nebula.view.renderers.ViewRenderer;
-import openfl.Vector;
-import openfl.geom.Vector3D;
-import sys.thread.Thread;
-
-typedef ClippingVertex =
-{
-	var pos:Vector3D;
-	var u:Float;
-	var v:Float;
-	var invZ:Float;
-	var meshPart:MeshPart;
-}
-
-typedef TransformedMesh =
-{
-	var mesh:MeshPart;
-	var verts:Vector<Float>;
-	var indices:Vector<Int>;
-}
+import nebulatracer.RasterizerExt;
 
 class N3DView extends FlxBasic
 {
 	public var renderer:ViewRenderer;
 	public var render:Bool = true;
 	public var meshes:Array<Mesh> = [];
-	public var camSpaceTris:Array<Array<ClippingVertex>> = [];
 	public var fov:Float;
 	public var nearPlane:Float = 1;
 	public var farPlane:Float = 100000;
@@ -45,6 +29,27 @@ class N3DView extends FlxBasic
 	public var projectedMeshes:Array<ProjectionMesh> = [];
 	public var canMove:Bool = true;
 
+	/**
+	 * How many pixels a part's LOD may be off by on screen, the coarsest level within this is drawn. 0 always draws full detail.
+	 */
+	public var lodThreshold:Float = 1;
+
+	/**
+	 * Goes up every time the camera moves, turns or its projection changes.
+	 */
+	public var cameraVersion(default, null):Int = 0;
+
+	var projectionTransform:ProjectionTransform = new ProjectionTransform();
+	// projections are cached per world space part and only redone when the part, its mesh or the camera changed
+	var projectionCache:ObjectMap<WorldSpacePart, ProjectionMesh> = new ObjectMap();
+	var previousProjectionCache:ObjectMap<WorldSpacePart, ProjectionMesh> = new ObjectMap();
+	var lastCamera:Array<Float> = [for (i in 0...11) Math.NaN];
+	var projectionBatch:Int = -1;
+	var frameParts:Array<ProjectionMesh> = [];
+	var queuedParts:Array<ProjectionMesh> = [];
+	var projectionCounts:hl.Bytes;
+	var projectionCountCapacity:Int = 0;
+
 	public function new(width:Int, height:Int, renderer:Class<ViewRenderer>, fov:Float = 70, aspect:Float = 0, nearPlane:Float = 0.1, farPlane:Float = 100000)
 	{
 		super();
@@ -64,27 +69,6 @@ class N3DView extends FlxBasic
 		meshes.push(mesh);
 	}
 
-	function project(v:Vector3D):Vector<Float>
-	{
-		var x = v.x, y = v.y, z = v.z;
-
-		var projectionMatrix = this.projectionMatrix;
-		var px = x * projectionMatrix[0] + y * projectionMatrix[4] + z * projectionMatrix[8] + projectionMatrix[12];
-		var py = x * projectionMatrix[1] + y * projectionMatrix[5] + z * projectionMatrix[9] + projectionMatrix[13];
-		var pz = x * projectionMatrix[2] + y * projectionMatrix[6] + z * projectionMatrix[10] + projectionMatrix[14];
-		var pw = x * projectionMatrix[3] + y * projectionMatrix[7] + z * projectionMatrix[11] + projectionMatrix[15];
-
-		px /= pw;
-		py /= pw;
-		pz /= pw;
-
-		// Convert NDC to screen space
-		var sx = (px + 1) * 0.5 * width;
-		var sy = (py + 1) * 0.5 * height;
-
-		return new Vector(4, false, [sx, sy, pz, pw]);
-	}
-
 	function get_projectionMatrix():Array<Float>
 	{
 		var fovRadians = fov * Math.PI / 180;
@@ -99,39 +83,8 @@ class N3DView extends FlxBasic
 		];
 	}
 
-	function applyRotation(v:Vector3D, yaw:Float, pitch:Float, roll:Float):Vector3D
-	{
-		var x = v.x;
-		var y = v.y;
-		var z = v.z;
-
-		// yaw (y axis)
-		var cosy = Math.cos(yaw);
-		var siny = Math.sin(yaw);
-		var x1 = x * cosy - z * siny;
-		var z1 = x * siny + z * cosy;
-		var y1 = y;
-
-		// pitch (x axis)
-		var cosp = Math.cos(pitch);
-		var sinp = Math.sin(pitch);
-		var y2 = y1 * cosp - z1 * sinp;
-		var z2 = y1 * sinp + z1 * cosp;
-		var x2 = x1;
-
-		// roll (z axis)
-		var cosr = Math.cos(roll);
-		var sinr = Math.sin(roll);
-		var x3 = x2 * cosr - y2 * sinr;
-		var y3 = x2 * sinr + y2 * cosr;
-		var z3 = z2;
-
-		return new Vector3D(x3, y3, z3);
-	}
-
 	override public function update(elapsed:Float)
 	{
-		camSpaceTris = [];
 		super.update(elapsed);
 
 		if (canMove)
@@ -205,153 +158,173 @@ class N3DView extends FlxBasic
 		}
 
 		// --- projection ---
-		projectedMeshes = [];
+		projectedMeshes.resize(0);
+		frameParts.resize(0);
+		queuedParts.resize(0);
+		if (projectionBatch == -1)
+			projectionBatch = RasterizerExt.newProjectionBatch();
+
+		var transform = projectionTransform;
+		if (cameraChanged())
+		{
+			transform.camX = camX;
+			transform.camY = camY;
+			transform.camZ = camZ;
+			transform.camYaw = camYaw;
+			transform.camPitch = camPitch;
+			transform.fov = fov;
+			transform.aspect = aspect;
+			transform.nearPlane = nearPlane;
+			transform.farPlane = farPlane;
+			transform.width = width;
+			transform.height = height;
+			cameraVersion++;
+		}
+
+		var cosYaw = Math.cos(-camYaw);
+		var sinYaw = Math.sin(-camYaw);
+		var cosPitch = Math.cos(-camPitch);
+		var sinPitch = Math.sin(-camPitch);
+
+		// parts are projected from their cached world space vertices, so the model transform is always identity
+		var cache = projectionCache;
+		projectionCache = previousProjectionCache;
+		previousProjectionCache = cache;
+		projectionCache.clear();
 
 		for (mesh in meshes)
 		{
-			for (meshPart in mesh.meshParts)
+			mesh.updateWorldSpace();
+			for (world in mesh.worldParts)
 			{
-				var cx = 0.0;
-				var cy = 0.0;
-				var cz = 0.0;
-				for (v in meshPart.vertices)
+				if (world.radius < 0)
+					continue;
+				var meshPart = world.part;
+
+				var pm = previousProjectionCache.get(world);
+				if (pm == null)
+					pm = new ProjectionMesh();
+				projectionCache.set(world, pm);
+
+				var region = meshPart.usesAtlas() ? meshPart.atlasRegion : null;
+				var graphic = region != null ? region.page.graphic : meshPart._graphic;
+				var indices = selectLOD(world);
+
+				// nothing this part's projection depends on changed, reuse last frame's output
+				if (pm.worldVersion == world.version && pm.cameraVersion == cameraVersion && pm.region == region && pm.graphic == graphic
+					&& pm.cullMode == meshPart.cullMode && pm.lodIndices == indices)
+				{
+					frameParts.push(pm);
+					continue;
+				}
+				pm.worldVersion = world.version;
+				pm.cameraVersion = cameraVersion;
+				pm.region = region;
+				pm.graphic = graphic;
+				pm.cullMode = meshPart.cullMode;
+				pm.lodIndices = indices;
+
+				// camera space depth of the center, only used for sorting
+				var relX = world.centerX - camX;
+				var relY = world.centerY - camY;
+				var relZ = world.centerZ - camZ;
+				var z1 = relX * sinYaw + relZ * cosYaw;
+				pm.camZ = relY * sinPitch + z1 * cosPitch;
+				pm.mesh = meshPart;
+				pm.meshPos.setTo(mesh.x, mesh.y, mesh.z);
+
+				transform.boundsX = world.centerX;
+				transform.boundsY = world.centerY;
+				transform.boundsZ = world.centerZ;
+				transform.boundsRadius = world.radius;
+				transform.cullMode = cast meshPart.cullMode;
+				if (region != null)
 				{
-					cx += v.x;
-					cy += v.y;
-					cz += v.z;
+					transform.uvScaleU = region.scaleU;
+					transform.uvScaleV = region.scaleV;
+					transform.uvOffsetU = region.offsetU;
+					transform.uvOffsetV = region.offsetV;
 				}
-				cx /= meshPart.vertices.length;
-				cy /= meshPart.vertices.length;
-				cz /= meshPart.vertices.length;
-
-				var centerWorld = new Vector3D(cx + mesh.x, cy + mesh.y, cz + mesh.z);
-				var relCenter = new Vector3D(centerWorld.x - camX, centerWorld.y - camY, centerWorld.z - camZ);
-				var camSpaceCenter = applyRotation(relCenter, -camYaw, -camPitch, 0);
-
-				var pm:ProjectionMesh = {
-					mesh: meshPart,
-					meshPos: new Vector3D(mesh.x, mesh.y, mesh.z),
-					verts: new Vector<Float>(),
-					uvt: new Vector<Float>(),
-					indices: new Vector<Int>(),
-					camZ: camSpaceCenter.z
-				};
-
-				var indices = meshPart.indices;
-				var verts = meshPart.vertices;
-
-				for (i in 0...cast indices.length / 3)
+				else
 				{
-					var idx0 = indices[i * 3];
-					var idx1 = indices[i * 3 + 1];
-					var idx2 = indices[i * 3 + 2];
-
-					var local0 = new Vector3D(verts[idx0].x - cx, verts[idx0].y - cy, verts[idx0].z - cz);
-					var local1 = new Vector3D(verts[idx1].x - cx, verts[idx1].y - cy, verts[idx1].z - cz);
-					var local2 = new Vector3D(verts[idx2].x - cx, verts[idx2].y - cy, verts[idx2].z - cz);
-
-					local0.x *= mesh.scaleX;
-					local0.y *= mesh.scaleY;
-					local0.z *= mesh.scaleZ;
-
-					local1.x *= mesh.scaleX;
-					local1.y *= mesh.scaleY;
-					local1.z *= mesh.scaleZ;
-
-					local2.x *= mesh.scaleX;
-					local2.y *= mesh.scaleY;
-					local2.z *= mesh.scaleZ;
-
-					// rotate local by mesh rotation
-					var rotated0 = applyRotation(local0, mesh.yaw, mesh.pitch, mesh.roll);
-					var rotated1 = applyRotation(local1, mesh.yaw, mesh.pitch, mesh.roll);
-					var rotated2 = applyRotation(local2, mesh.yaw, mesh.pitch, mesh.roll);
-
-					// move back to mesh position in world space
-					rotated0.x += cx + mesh.x;
-					rotated0.y += cy + mesh.y;
-					rotated0.z += cz + mesh.z;
-
-					rotated1.x += cx + mesh.x;
-					rotated1.y += cy + mesh.y;
-					rotated1.z += cz + mesh.z;
-
-					rotated2.x += cx + mesh.x;
-					rotated2.y += cy + mesh.y;
-					rotated2.z += cz + mesh.z;
-
-					// transform to camera space: translate by inverse camera position
-					var rel0 = new Vector3D(rotated0.x - camX, rotated0.y - camY, rotated0.z - camZ);
-					var rel1 = new Vector3D(rotated1.x - camX, rotated1.y - camY, rotated1.z - camZ);
-					var rel2 = new Vector3D(rotated2.x - camX, rotated2.y - camY, rotated2.z - camZ);
-
-					// rotate by inverse camera rotation
-					var camSpace0 = applyRotation(rel0, -camYaw, -camPitch, 0);
-					var camSpace1 = applyRotation(rel1, -camYaw, -camPitch, 0);
-					var camSpace2 = applyRotation(rel2, -camYaw, -camPitch, 0);
-
-					var v0:ClippingVertex = {
-						pos: new Vector3D(camSpace0.x, camSpace0.y, camSpace0.z, 1),
-						u: meshPart.uvt[idx0 * 2],
-						v: meshPart.uvt[idx0 * 2 + 1],
-						invZ: 1 / -camSpace0.z,
-						meshPart: meshPart
-					};
-					var v1:ClippingVertex = {
-						pos: new Vector3D(camSpace1.x, camSpace1.y, camSpace1.z, 1),
-						u: meshPart.uvt[idx1 * 2],
-						v: meshPart.uvt[idx1 * 2 + 1],
-						invZ: 1 / -camSpace1.z,
-						meshPart: meshPart
-					};
-					var v2:ClippingVertex = {
-						pos: new Vector3D(camSpace2.x, camSpace2.y, camSpace2.z, 1),
-						u: meshPart.uvt[idx2 * 2],
-						v: meshPart.uvt[idx2 * 2 + 1],
-						invZ: 1 / -camSpace2.z,
-						meshPart: meshPart
-					};
-
-					var triangle = [v0, v1, v2];
-					camSpaceTris.push(triangle);
-					var skip = false;
-					for (i in 0...3) // URGENT: implement proper vertex clipping
-					{
-						var projected = project(triangle[i].pos);
-						if (triangle[i].pos.z > -50 || projected[3] < 0.01)
-						{
-							skip = true;
-							break;
-						}
-					}
-					if (skip)
-						continue;
-
-					var baseIdx = Std.int(pm.verts.length / 2);
-					for (i in 0...3)
-					{
-						var cv:ClippingVertex = triangle[i];
-						if (cv.pos.z > -nearPlane)
-							cv.pos.z = -nearPlane - 0.001;
-						var p = project(cv.pos);
-
-						pm.verts.push(p[0]);
-						pm.verts.push(p[1]);
-						pm.uvt.push(cv.u);
-						pm.uvt.push(cv.v);
-						pm.uvt.push(1);
-
-						pm.indices.push(baseIdx + i);
-					}
+					transform.uvScaleU = 1;
+					transform.uvScaleV = 1;
+					transform.uvOffsetU = 0;
+					transform.uvOffsetV = 0;
 				}
 
-				projectedMeshes.push(pm);
+				var verts = world.vertices;
+				// clipping can turn one triangle into three
+				pm.reserve(indices.length * 3);
+				RasterizerExt.queueProjection(projectionBatch, transform, verts.bytes, verts.length, indices.bytes, indices.length, meshPart.uvt.bytes,
+					meshPart.uvt.length, pm.screenVerts, pm.screenUvt, pm.screenIndices, pm.screenDepth);
+				queuedParts.push(pm);
+				frameParts.push(pm);
+			}
+		}
+
+		// every queued part is projected in parallel, each one writes into its own buffers
+		if (queuedParts.length > 0)
+		{
+			if (queuedParts.length > projectionCountCapacity)
+			{
+				projectionCountCapacity = queuedParts.length * 2;
+				projectionCounts = new hl.Bytes(projectionCountCapacity * 4);
 			}
+			RasterizerExt.runProjectionBatch(projectionBatch, projectionCounts);
+			for (i in 0...queuedParts.length)
+				queuedParts[i].vertexCount = projectionCounts.getI32(i << 2);
 		}
+
+		// nothing written means the part was culled or clipped away
+		for (pm in frameParts)
+			if (pm.vertexCount > 0)
+				projectedMeshes.push(pm);
 		if (render)
 			renderView(elapsed);
 	}
 
+	// the coarsest LOD whose error, projected at the part's nearest point, stays under lodThreshold pixels
+	function selectLOD(world:WorldSpacePart):IndexBuffer
+	{
+		var part = world.part;
+		if (lodThreshold <= 0 || part.lods.length == 0)
+			return part.indices;
+		var dx = world.centerX - camX;
+		var dy = world.centerY - camY;
+		var dz = world.centerZ - camZ;
+		var distance = Math.max(Math.sqrt(dx * dx + dy * dy + dz * dz) - world.radius, nearPlane);
+		var pixelsPerUnit = height * 0.5 / Math.tan(fov * Math.PI / 360);
+		return part.getLOD(lodThreshold * distance / (pixelsPerUnit * world.scale));
+	}
+
+	// compared against full precision copies, the transform only keeps float32
+	function cameraChanged():Bool
+	{
+		var state = lastCamera;
+		var current = [camX, camY, camZ, camYaw, camPitch, fov, aspect, nearPlane, farPlane, width, height];
+		var changed = false;
+		for (i in 0...current.length)
+		{
+			if (state[i] != current[i])
+			{
+				state[i] = current[i];
+				changed = true;
+			}
+		}
+		return changed;
+	}
+
+	override public function destroy()
+	{
+		super.destroy();
+		if (projectionBatch != -1)
+		{
+			RasterizerExt.disposeProjectionBatch(projectionBatch);
+			projectionBatch = -1;
+		}
+	}
+
 	public function renderView(elapsed:Float)
 	{
 		if (renderer != null)
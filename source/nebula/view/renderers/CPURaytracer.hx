@@ -5,12 +5,43 @@ import flixel.FlxSprite;
 import lime.utils.Log;
 import nebula.mesh.MeshPart;
 import nebula.tonemapper.*;
+import nebula.utils.BitmapDataHelper;
 import nebula.utils.Vec3DHelper;
 import nebula.view.renderers.Raytracer.FloatColor;
+import nebulatracer.NebulaFramebuffer;
+import nebulatracer.NebulaFramebuffer.DenoiserMode;
+import nebulatracer.NebulaProbeGrid;
+import nebulatracer.NebulaRadianceCache;
+import nebulatracer.NebulaTileScheduler;
+import nebulatracer.NebulaTileScheduler.TileOrder;
+import nebulatracer.NebulaTracer;
 import nebulatracer.NebulaTracer.Ray;
 import nebulatracer.RaytracerExt.TraceResult;
 import openfl.geom.Rectangle;
 import openfl.geom.Vector3D;
+import sys.thread.Thread;
+
+/**
+ * What `CPURaytracer.traceRay` found. `normal`, `depth` and `geomID` are only set on hits, `albedo` is the hit surface's color.
+ */
+typedef TraceSample =
+{
+	var hit:Bool;
+	var color:FloatColor;
+	@:optional var geomID:Int;
+	@:optional var albedo:FloatColor;
+	@:optional var normal:Vector3D;
+	@:optional var depth:Float;
+}
+
+/**
+ * The point `CPURaytracer` traces outwards from.
+ */
+enum abstract TileFocus(Int)
+{
+	var CENTER = 0;
+	var MOUSE = 1;
+}
 
 class CPURaytracer extends Raytracer
 {
@@ -19,21 +50,199 @@ class CPURaytracer extends Raytracer
 	public var skyColor:FloatColor = new FloatColor(0, 0, 0);
 	public var globalIllum:FlxSprite;
 	public var clearFrame:Bool = true;
+	/**
+	 * How many times the light reaching the probes bounced. At 1 what a probe ray hits only gives its color, above that it's lit by
+	 * a path through `radianceCache` that stops at the first vertex already cached, so every bounce past the first is nearly free.
+	 */
 	public var numBounces:Int = 1;
 	public var giSamples:Int = 32;
 	public var bounceLightRandomness = 0.1;
 	public var shadowsRandomness = 0.1;
 
-	override public function new(view:N3DView)
+	/**
+	 * Every traced sample is added in here and the frame shows the running mean.
+	 * It's reset when `sceneVersion` changes, or on every `renderScene` if `clearFrame` is on (see `temporal` for camera moves).
+	 */
+	public var framebuffer(default, null):NebulaFramebuffer;
+
+	/**
+	 * Spends samples where the image is still noisy while accumulating (`clearFrame` off).
+	 * Tiles whose relative error drops to `targetError` stop being traced, noisier ones get up to `maxSamplesPerFrame` samples per pixel.
+	 */
+	public var adaptiveSampling:Bool = true;
+
+	public var targetError:Float = 0.02;
+	public var minSamples:Int = 4;
+	public var maxSamplesPerFrame:Int = 4;
+
+	/**
+	 * How much of the screen reached `targetError`, from 0 to 1. Only updated with `adaptiveSampling`.
+	 */
+	public var convergence(default, null):Float = 0;
+
+	/**
+	 * Whether every tile reached `targetError`, nothing gets traced until the scene changes.
+	 */
+	public var converged(get, never):Bool;
+
+	/**
+	 * Cleans up the accumulated frame before it's tonemapped, so previews at a few samples per pixel look acceptable.
+	 * `OIDN` falls back to `ATROUS` when nebulatracer wasn't built with it.
+	 */
+	public var denoiser:DenoiserMode = ATROUS;
+
+	/**
+	 * How many à-trous passes the `ATROUS` denoiser runs, each one doubles how far it reaches.
+	 */
+	public var denoiseIterations:Int = 5;
+
+	/**
+	 * Hands the screen's tiles out to the tracing threads. The frame is traced in passes, one tile each,
+	 * and a camera or scene change cancels the running pass right away instead of waiting for it.
+	 */
+	public var scheduler(default, null):NebulaTileScheduler;
+
+	/**
+	 * How many threads trace tiles, 0 uses one per hardware thread but one. Only read by the constructor.
+	 */
+	public var threadCount(default, null):Int;
+
+	/**
+	 * How many passes over the screen finished since the frame was last reset.
+	 */
+	public var passes(default, null):Int = 0;
+
+	/**
+	 * The order tiles are traced in, `SPIRAL` goes outwards from `focus` so the part of the screen looked at shows up first.
+	 */
+	public var tileOrder:TileOrder = SPIRAL;
+
+	public var focus:TileFocus = CENTER;
+
+	/**
+	 * Tiles within this many pixels of `focus` get `focusSamples` samples per pixel in the first pass after a reset,
+	 * the rest of the screen catches up in the passes after it.
+	 */
+	public var focusRadius:Float = 96;
+
+	public var focusSamples:Int = 2;
+
+	/**
+	 * While accumulating, a reset frame is traced sparsely first and refined pass by pass instead of all at once.
+	 * The first pass traces one pixel per tile and every pass after it doubles that, in Bayer order so each step fills
+	 * the gaps evenly. The frame shown is rebuilt from every sample so far. Once every pixel has one, passes go back to `giRes`.
+	 */
+	public var progressive:Bool = true;
+
+	/**
+	 * When only the camera moved, the accumulated frame is reprojected to the new camera instead of thrown away,
+	 * fresh samples blend into what's still visible and only disoccluded pixels start over.
+	 * A pixel keeps at most `historySamples` samples of history so the new ones take over quickly.
+	 */
+	public var temporal:Bool = true;
+
+	public var historySamples:Int = 8;
+
+	/**
+	 * Reads bounce light from `probes` instead of tracing 32 hemisphere rays at every hit.
+	 * Points whose probes weren't traced yet fall back to the rays.
+	 */
+	public var probeLighting:Bool = true;
+
+	/**
+	 * Light probes over the scene bounds, refined a batch per `update` on the native worker threads.
+	 */
+	public var probes(default, null):NebulaProbeGrid;
+
+	/**
+	 * How many probes go along the longest side of the scene, read when the grid is reset.
+	 */
+	public var probeResolution:Int = 16;
+
+	/**
+	 * Every `update` traces `probeRays` rays from each of the next `probesPerUpdate` probes, until all of them have `probeMaxRays`.
+	 */
+	public var probesPerUpdate:Int = 256;
+
+	public var probeRays:Int = 32;
+	public var probeMaxRays:Int = 1024;
+
+	/**
+	 * Whether the probes start over when the geometry, a material, a light or `skyColor` changed. Off keeps the old lighting.
+	 */
+	public var probeRefresh:Bool = true;
+
+	/**
+	 * The light leaving the scene's surfaces, cached for the probes' paths when `numBounces` is above 1. It starts over with the probes.
+	 */
+	public var radianceCache(default, null):NebulaRadianceCache;
+
+	/**
+	 * How many surface points `radianceCache` holds, and how many of its cells go along the longest side of the scene.
+	 * Both are read when it's reset.
+	 */
+	public var radianceCacheSize:Int = 1 << 18;
+
+	public var radianceCacheCells:Int = 256;
+
+	static inline var TILE_PIXELS:Int = NebulaFramebuffer.TILE_SIZE * NebulaFramebuffer.TILE_SIZE;
+
+	// Bayer rank of every pixel of a tile, lower ranks get refined first and any prefix of them is spread evenly
+	static var refinementRanks:Array<Int> = buildRefinementRanks();
+
+	// ranks queued since the last reset, and the ones whose pass finished
+	var refinedRanks:Int = 0;
+	var coveredRanks:Int = 0;
+	var passRankStart:Int = 0;
+	var passRankEnd:Int = TILE_PIXELS;
+	var passFocusX:Float = 0;
+	var passFocusY:Float = 0;
+	var passFocusBoost:Bool = false;
+	var passGiRes:Int = 1;
+	var passAdaptive:Bool = false;
+	var passFeatures:Bool = false;
+	var workersStarted:Bool = false;
+	var resolved:hl.Bytes;
+	var denoised:hl.Bytes;
+	var tileSamples:hl.Bytes;
+	var accumulatedVersion:Int = -1;
+	// the camera the frame is traced with (x, y, z, yaw, pitch, fov as float32), and the content and camera versions it belongs to
+	var tracedCamera:hl.Bytes = new hl.Bytes(24);
+	var nextCamera:hl.Bytes = new hl.Bytes(24);
+	var tracedContentVersion:Int = -1;
+	var tracedCameraVersion:Int = -1;
+	// what the probes were traced with
+	var probeContentVersion:Int = -1;
+	var probeSky:Array<Float> = [];
+	var probeBounces:Int = 1;
+	// what sampleProbes writes into, one per worker plus one for traceRay calls from outside them
+	var probeScratch:Array<hl.Bytes> = [];
+	var presented:Bool = false;
+
+	override public function new(view:N3DView, threadCount:Int = 0)
 	{
 		super(view);
+		this.threadCount = threadCount;
 		globalIllum = new FlxSprite();
 		globalIllum.makeGraphic(view.width, view.height, tonemapper.map(skyColor));
 		globalIllum.pixels.fillRect(new Rectangle(0, 0, view.width, view.height), tonemapper.map(skyColor));
 		FlxG.state.add(globalIllum);
+		framebuffer = new NebulaFramebuffer(view.width, view.height);
+		resolved = new hl.Bytes(view.width * view.height * 12);
+		denoised = new hl.Bytes(view.width * view.height * 12);
+		tileSamples = new hl.Bytes(framebuffer.tilesX * framebuffer.tilesY);
+		scheduler = new NebulaTileScheduler(view.width, view.height, threadCount);
+		for (i in 0...scheduler.workerCount + 1)
+			probeScratch.push(new hl.Bytes(12));
 	}
 
-	public function traceRay(ray:Ray):{hit:Bool, color:FloatColor}
+	inline function get_converged():Bool
+		return convergence >= 1;
+
+	/**
+	 * @param worker The tracing worker calling this, -1 from anywhere else.
+	 */
+	public function traceRay(ray:Ray, worker:Int = -1):TraceSample
 	{
 		var color:FloatColor = new FloatColor(0, 0, 0);
 		var res:TraceResult = raytracer.traceRay(ray);
@@ -41,6 +250,7 @@ class CPURaytracer extends Raytracer
 		{
 			var part = geom[res.geomID];
 			var hitPos = Vec3DHelper.add(ray.pos, Vec3DHelper.multiplyScalar(ray.dir, res.distance));
+			var normal = getTriangleNormal(part, res.primID);
 			if (part.raytracingProperties.isEmitter)
 				color = part._color;
 			else
@@ -83,37 +293,49 @@ class CPURaytracer extends Raytracer
 					color = FloatColor.addColor(color, FloatColor.lerpColor(baseDarkened, light.color, lightIntensity));
 				}
 			}
-			var hemisphereSamples = generateHemisphereSamples(32);
-
-			var colors = [];
-			for (sample in hemisphereSamples)
+			var probeLight = probeLighting ? sampleProbes(hitPos, normal, worker) : null;
+			if (probeLight != null)
+				color = new FloatColor(color.red + probeLight.getF32(0), color.green + probeLight.getF32(4), color.blue + probeLight.getF32(8));
+			else
 			{
-				var normal = getTriangleNormal(part, res.primID);
-				var sampleDir = alignSampleToNormal(sample, normal);
+				var hemisphereSamples = generateHemisphereSamples(32);
+				var bounceTracer = getBounceTracer();
 
-				var bounceRay:Ray = {
-					pos: Vec3DHelper.add(hitPos, Vec3DHelper.multiplyScalar(sampleDir, 0.001)),
-					dir: sampleDir
-				};
-
-				var bounceRes = raytracer.traceRay(bounceRay);
-				if (bounceRes.hit)
-				{
-					var bouncePart = geom[bounceRes.geomID];
-					colors.push(bouncePart._color);
-				}
-				else
+				var colors = [];
+				for (sample in hemisphereSamples)
 				{
-					var ndotl = Math.max(0, Vec3DHelper.dot(sampleDir, normal));
-					var envLight = FloatColor.multiplyFloat(skyColor, ndotl * 0.3);
-					colors.push(envLight);
+					var sampleDir = alignSampleToNormal(sample, normal);
+
+					var bounceRay:Ray = {
+						pos: Vec3DHelper.add(hitPos, Vec3DHelper.multiplyScalar(sampleDir, 0.001)),
+						dir: sampleDir
+					};
+
+					var bounceRes = bounceTracer.traceRay(bounceRay);
+					if (bounceRes.hit)
+					{
+						var bouncePart = geom[bounceRes.geomID];
+						colors.push(bouncePart._color);
+					}
+					else
+					{
+						var ndotl = Math.max(0, Vec3DHelper.dot(sampleDir, normal));
+						var envLight = FloatColor.multiplyFloat(skyColor, ndotl * 0.3);
+						colors.push(envLight);
+					}
 				}
-			}
 
-			var bounceLight = averageColors(colors);
-			color = FloatColor.addColor(color, bounceLight);
+				color = FloatColor.addColor(color, averageColors(colors));
+			}
 
-			return {hit: true, color: color};
+			return {
+				hit: true,
+				color: color,
+				geomID: res.geomID,
+				albedo: part._color,
+				normal: normal,
+				depth: res.distance
+			};
 		}
 		else
 		{
@@ -121,6 +343,53 @@ class CPURaytracer extends Raytracer
 		}
 	}
 
+	inline function getBounceTracer():NebulaTracer
+		return coarseBounces && coarseTracer != null ? coarseTracer : raytracer;
+
+	// the worker's scratch holding r, g, b as float32, null if no probe around the point was traced yet
+	function sampleProbes(pos:Vector3D, normal:Vector3D, worker:Int):hl.Bytes
+	{
+		var grid = probes;
+		if (grid == null)
+			return null;
+		var out = probeScratch[worker == -1 ? probeScratch.length - 1 : worker];
+		if (!grid.sample(pos.x, pos.y, pos.z, normal.x, normal.y, normal.z, out))
+			return null;
+		return out;
+	}
+
+	// resets the probes and the cache when what they saw changed, runs on the main thread with no pass tracing the scene's edits
+	function syncProbes()
+	{
+		if (!probeLighting)
+			return;
+		if (probes == null)
+			probes = new NebulaProbeGrid();
+		var skyChanged = probeSky.length == 0 || probeSky[0] != skyColor.red || probeSky[1] != skyColor.green || probeSky[2] != skyColor.blue;
+		var stale = probeRefresh && (probeContentVersion != contentVersion || skyChanged);
+		if (probeContentVersion != -1 && !stale && probeBounces == numBounces)
+			return;
+		probes.reset(getBounceTracer(), probeResolution);
+		if (numBounces > 1)
+		{
+			if (radianceCache == null)
+				radianceCache = new NebulaRadianceCache();
+			radianceCache.reset(getBounceTracer(), radianceCacheSize, radianceCacheCells);
+		}
+		probeContentVersion = contentVersion;
+		probeSky = [skyColor.red, skyColor.green, skyColor.blue];
+		probeBounces = numBounces;
+	}
+
+	// rays that miss see the sky the same way the hemisphere rays do
+	function updateProbes()
+	{
+		if (!probeLighting || probes == null || probes.converged)
+			return;
+		probes.update(getBounceTracer(), raytracer, probesPerUpdate, probeRays, probeMaxRays, skyColor.red * 0.3, skyColor.green * 0.3,
+			skyColor.blue * 0.3, radianceCache, probeBounces);
+	}
+
 	function generateHemisphereSamples(num:Int):Array<Vector3D>
 	{
 		var samples = new Array<Vector3D>();
@@ -160,14 +429,15 @@ class CPURaytracer extends Raytracer
 		var i1 = part.indices[primID * 3 + 1];
 		var i2 = part.indices[primID * 3 + 2];
 
-		var v0 = part.vertices[i0];
-		var v1 = part.vertices[i1];
-		var v2 = part.vertices[i2];
-
-		var edge1 = Vec3DHelper.subtract(v1, v0);
-		var edge2 = Vec3DHelper.subtract(v2, v0);
+		var verts = part.vertices;
+		var e1x = verts.getX(i1) - verts.getX(i0);
+		var e1y = verts.getY(i1) - verts.getY(i0);
+		var e1z = verts.getZ(i1) - verts.getZ(i0);
+		var e2x = verts.getX(i2) - verts.getX(i0);
+		var e2y = verts.getY(i2) - verts.getY(i0);
+		var e2z = verts.getZ(i2) - verts.getZ(i0);
 
-		var normal = Vec3DHelper.cross(edge1, edge2);
+		var normal = new Vector3D(e1y * e2z - e1z * e2y, e1z * e2x - e1x * e2z, e1x * e2y - e1y * e2x);
 		return Vec3DHelper.normalize(normal);
 	}
 
@@ -221,9 +491,11 @@ class CPURaytracer extends Raytracer
 		return delta / max;
 	}
 
+	// traces from the camera the frame was reset with, the view's may already have moved on while a pass finishes
 	public function pixelToWorld(x:Float, y:Float):Ray
 	{
-		final fov = view.fov;
+		final camera = tracedCamera;
+		final fov = camera.getF32(20);
 		final aspectRatio = view.width / view.height;
 
 		var ndcX = (2 * x) / view.width - 1;
@@ -239,8 +511,8 @@ class CPURaytracer extends Raytracer
 		var dir = new Vector3D(camX, camY, camZ);
 		dir.normalize();
 
-		var yaw = view.camYaw;
-		var pitch = view.camPitch;
+		var yaw = camera.getF32(12);
+		var pitch = camera.getF32(16);
 
 		// --- Apply Pitch (X axis) ---
 		var cosPitch = Math.cos(pitch);
@@ -261,7 +533,7 @@ class CPURaytracer extends Raytracer
 		dir.normalize();
 
 		var ray:Ray = {
-			pos: new Vector3D(view.camX, view.camY, view.camZ),
+			pos: new Vector3D(camera.getF32(0), camera.getF32(4), camera.getF32(8)),
 			dir: dir
 		};
 		return ray;
@@ -285,49 +557,321 @@ class CPURaytracer extends Raytracer
 		return Vec3DHelper.normalize(worldSample);
 	}
 
-	override public function update(elapsed:Float)
+	/**
+	 * Syncs the scene and restarts tracing from scratch if anything changed (or every time with `clearFrame`),
+	 * otherwise starts another pass if none is running. Tracing happens on the scheduler's threads, this never waits for a frame.
+	 */
+	override public function renderScene()
 	{
-		super.update(elapsed);
-		if (clearFrame)
+		syncScene();
+		syncProbes();
+		if (accumulatedVersion != sceneVersion || clearFrame && !rendering)
+			restart();
+		else if (!rendering)
+			startPass();
+	}
+
+	// nothing may be traced while the scene changes under it
+	override function beforeSceneEdit()
+	{
+		scheduler.cancel();
+		scheduler.waitIdle();
+		rendering = false;
+	}
+
+	function restart()
+	{
+		scheduler.cancel();
+		scheduler.waitIdle();
+		resetFrame();
+		accumulatedVersion = sceneVersion;
+		passes = 0;
+		refinedRanks = 0;
+		coveredRanks = 0;
+		presented = false;
+		startPass();
+	}
+
+	// reprojects the frame if only the camera moved since it was traced, clears it otherwise
+	function resetFrame()
+	{
+		nextCamera.setF32(0, view.camX);
+		nextCamera.setF32(4, view.camY);
+		nextCamera.setF32(8, view.camZ);
+		nextCamera.setF32(12, view.camYaw);
+		nextCamera.setF32(16, view.camPitch);
+		nextCamera.setF32(20, view.fov);
+		if (temporal && tracedContentVersion == contentVersion && tracedCameraVersion != view.cameraVersion)
+			framebuffer.reproject(tracedCamera, nextCamera, historySamples);
+		else
+			framebuffer.reset();
+		var camera = tracedCamera;
+		tracedCamera = nextCamera;
+		nextCamera = camera;
+		tracedContentVersion = contentVersion;
+		tracedCameraVersion = view.cameraVersion;
+	}
+
+	// queues every tile once, the settings are read here so changing them never affects a pass halfway
+	function startPass()
+	{
+		startWorkers();
+		var refining = progressive && !clearFrame && refinedRanks < TILE_PIXELS;
+		passGiRes = refining ? 1 : Std.int(Math.max(1, giRes));
+		passAdaptive = adaptiveSampling && !clearFrame && !refining;
+		// reprojection needs the depth and geomID of every pixel
+		passFeatures = denoiser != NONE || temporal;
+		if (refining)
+		{
+			passRankStart = refinedRanks;
+			passRankEnd = Std.int(Math.max(1, refinedRanks * 2));
+			refinedRanks = passRankEnd;
+		}
+		else
+		{
+			passRankStart = 0;
+			passRankEnd = TILE_PIXELS;
+			coveredRanks = TILE_PIXELS;
+		}
+		if (passAdaptive)
+		{
+			convergence = framebuffer.updateConvergence(targetError, minSamples, maxSamplesPerFrame, passGiRes, tileSamples) / (framebuffer.tilesX * framebuffer.tilesY);
+			if (converged)
+			{
+				rendering = false;
+				return;
+			}
+		}
+		if (focus == MOUSE)
+		{
+			var mouse = FlxG.mouse.getScreenPosition(this);
+			passFocusX = Math.max(0, Math.min(view.width - 1, mouse.x));
+			passFocusY = Math.max(0, Math.min(view.height - 1, mouse.y));
+			mouse.put();
+		}
+		else
+		{
+			passFocusX = view.width / 2;
+			passFocusY = view.height / 2;
+		}
+		passFocusBoost = passes == 0 && focusSamples > 1;
+		prog = 0;
+		maxProg = scheduler.tilesX * scheduler.tilesY;
+		rendering = true;
+		scheduler.restart(tileOrder, passFocusX, passFocusY);
+	}
+
+	function startWorkers()
+	{
+		if (workersStarted)
+			return;
+		workersStarted = true;
+		for (worker in 0...scheduler.workerCount)
+			Thread.create(() -> workerLoop(worker));
+	}
+
+	function workerLoop(worker:Int)
+	{
+		var tile = scheduler.acquire(worker);
+		while (tile != -1)
 		{
-			globalIllum.pixels.lock();
-			globalIllum.pixels.fillRect(new Rectangle(0, 0, view.width, view.height), tonemapper.map(skyColor));
-			globalIllum.pixels.unlock();
+			try
+			{
+				traceTile(tile, worker);
+			}
+			catch (e)
+			{
+				Log.throwErrors = false;
+				Log.error('Error tracing tile $tile: ${e.toString()}');
+				Log.throwErrors = true;
+			}
+			scheduler.finish(worker);
+			tile = scheduler.acquire(worker);
 		}
-		var colors = [];
+	}
+
+	function traceTile(tile:Int, worker:Int)
+	{
+		var samples = passAdaptive ? tileSamples.getUI8(tile) : 1;
+		if (samples == 0)
+			return;
+		var size = NebulaFramebuffer.TILE_SIZE;
+		var x0 = (tile % scheduler.tilesX) * size;
+		var y0 = Std.int(tile / scheduler.tilesX) * size;
+		var x1 = Std.int(Math.min(x0 + size, view.width));
+		var y1 = Std.int(Math.min(y0 + size, view.height));
+		if (passFocusBoost)
+		{
+			// distance from the focus point to the nearest pixel of the tile
+			var dx = Math.max(0, Math.max(x0 - passFocusX, passFocusX - x1));
+			var dy = Math.max(0, Math.max(y0 - passFocusY, passFocusY - y1));
+			if (dx * dx + dy * dy <= focusRadius * focusRadius)
+				samples = Std.int(Math.max(samples, focusSamples));
+		}
+		for (y in y0...y1)
 		{
-			for (y in 0...view.height)
+			if (y % passGiRes != 0)
+				continue;
+			var rankRow = (y - y0) * size;
+			for (x in x0...x1)
 			{
-				if (y % giRes != 0)
+				if (x % passGiRes != 0)
+					continue;
+				var rank = refinementRanks[rankRow + x - x0];
+				if (rank < passRankStart || rank >= passRankEnd)
 					continue;
+				// checked every pixel, a cancelled tile is dropped within one pixel's worth of rays
+				if (!scheduler.isCurrent(worker))
+					return;
+				for (i in 0...samples)
+					tracePixel(x, y, worker);
+			}
+		}
+	}
 
-				for (x in 0...view.width)
-				{
-					if (x % giRes != 0)
-						continue;
+	function tracePixel(x:Int, y:Int, worker:Int)
+	{
+		var ray = pixelToWorld(x, y);
+		var res:TraceSample = {hit: false, color: skyColor};
+		try
+		{
+			res = traceRay(ray, worker);
+		}
+		catch (e)
+		{
+			Log.throwErrors = false;
+			Log.error('Error tracing ray at (x, y)[$x, $y]: ${e.toString()}');
+			Log.throwErrors = true;
+		}
+		// features go first, they drop reprojected history that turns out to be another surface
+		if (passFeatures)
+		{
+			if (res.hit)
+				framebuffer.addFeatures(x, y, res.albedo.red, res.albedo.green, res.albedo.blue, res.normal.x, res.normal.y, res.normal.z, res.depth,
+					res.geomID);
+			else
+				framebuffer.addFeatures(x, y, 1, 1, 1, 0, 0, 0, 0, -1);
+		}
+		var color = res.color;
+		framebuffer.addSample(x, y, color.red, color.green, color.blue);
+	}
 
-					var ray = pixelToWorld(x, y);
-					var res:{hit:Bool, color:FloatColor} = {hit: false, color: skyColor};
-					try
-					{
-						res = traceRay(ray);
-					}
-					catch (e)
-					{
-						Log.throwErrors = false;
-						Log.error('Error tracing ray at (x, y)[$x, $y]: ${e.toString()}');
-						Log.throwErrors = true;
-					}
-					var color = res.color;
-					var finalColor = tonemapper.map(color);
-					finalColor.alpha = 255;
-					globalIllum.pixels.lock();
-					globalIllum.pixels.fillRect(new Rectangle(x, y, giRes, giRes), finalColor);
-					globalIllum.pixels.unlock();
-					prog++;
+	override public function update(elapsed:Float)
+	{
+		super.update(elapsed);
+		// samples from a moved camera can't be mixed with the ones already in the frame, they're reprojected or cleared first
+		if (rendering && view.cameraVersion != lastCameraVersion)
+			renderScene();
+
+		updateProbes();
+		var wasRendering = rendering;
+		if (rendering)
+		{
+			var pending = scheduler.pending;
+			prog = maxProg - pending;
+			if (pending == 0)
+			{
+				rendering = false;
+				passes++;
+				coveredRanks = Std.int(Math.max(coveredRanks, passRankEnd));
+				// accumulating keeps refining until it converges (forever without adaptive sampling)
+				if (!clearFrame && accumulatedVersion == sceneVersion)
+					startPass();
+			}
+		}
+		// a finished frame doesn't change, it only needs showing once
+		if (wasRendering || !presented)
+		{
+			presentFrame();
+			presented = true;
+		}
+	}
+
+	// how far apart the samples traced so far can be, the gaps are blended over that distance
+	function getFillRadius():Int
+	{
+		if (coveredRanks < TILE_PIXELS)
+			return Math.ceil(NebulaFramebuffer.TILE_SIZE / Math.sqrt(Math.max(1, coveredRanks)));
+		return passGiRes > 1 ? passGiRes : 0;
+	}
+
+	static function buildRefinementRanks():Array<Int>
+	{
+		var size = NebulaFramebuffer.TILE_SIZE;
+		var bits = 0;
+		while ((1 << bits) < size)
+			bits++;
+		var ranks = [];
+		for (y in 0...size)
+		{
+			for (x in 0...size)
+			{
+				// the 2x2 Bayer pattern of every bit, the lowest bit is the coarsest level so it's the most significant digit
+				var rank = 0;
+				for (bit in 0...bits)
+				{
+					var xBit = (x >> bit) & 1;
+					var yBit = (y >> bit) & 1;
+					rank |= (((xBit ^ yBit) << 1) | yBit) << (2 * (bits - 1 - bit));
 				}
+				ranks.push(rank);
 			}
 		}
-		rendering = false;
+		return ranks;
+	}
+
+	override public function destroy()
+	{
+		// releases the workers, they stop once their tile is handed back
+		scheduler.dispose();
+		framebuffer.dispose();
+		if (probes != null)
+			probes.dispose();
+		if (radianceCache != null)
+			radianceCache.dispose();
+		super.destroy();
+	}
+
+	/**
+	 * Tonemaps the running mean of `framebuffer` into `globalIllum`. The mean goes through `denoiser` first.
+	 * A `BatchTonemapper` writes the whole frame natively straight into the bitmap's memory,
+	 * others are mapped pixel by pixel with one lock for the whole frame.
+	 */
+	function presentFrame()
+	{
+		var pixels = globalIllum.pixels;
+		if (framebuffer.resolve(resolved, getFillRadius()) == 0)
+		{
+			pixels.fillRect(new Rectangle(0, 0, view.width, view.height), tonemapper.map(skyColor));
+			return;
+		}
+		var frame = resolved;
+		if (denoiser != NONE)
+		{
+			framebuffer.denoise(resolved, denoised, denoiser, denoiseIterations);
+			frame = denoised;
+		}
+		if (Std.isOfType(tonemapper, BatchTonemapper) && BitmapDataHelper.getPixelBytes(pixels) != null)
+		{
+			(cast tonemapper : BatchTonemapper).mapFrame(frame, view.width, view.height, pixels);
+			return;
+		}
+		pixels.lock();
+		var color = new FloatColor(0, 0, 0);
+		var pos = 0;
+		for (y in 0...view.height)
+		{
+			for (x in 0...view.width)
+			{
+				color.red = frame.getF32(pos);
+				color.green = frame.getF32(pos + 4);
+				color.blue = frame.getF32(pos + 8);
+				pos += 12;
+				var finalColor = tonemapper.map(color);
+				finalColor.alpha = 255;
+				pixels.setPixel32(x, y, finalColor);
+			}
+		}
+		pixels.unlock();
 	}
 }
@@ -3,18 +3,129 @@ package nebula.view.renderers;
 import flixel.*;
 import flixel.graphics.FlxGraphic;
 import flixel.math.FlxPoint;
-import nebula.mesh.Mesh;
+import haxe.ds.ObjectMap;
+import nebula.mesh.MeshAtlas.AtlasRegion;
 import nebula.mesh.ProjectionMesh;
-import nebula.view.N3DView.ClippingVertex;
-import openfl.display.Bitmap;
+import nebula.utils.BitmapDataHelper;
+import nebulatracer.NebulaRasterizer;
+import openfl.Vector;
 import openfl.display.BitmapData;
+import openfl.display.BlendMode;
+
+/**
+ * Projected mesh parts that share a graphic and draw state, drawn with one `drawTriangles` call.
+ */
+private class TriangleBatch
+{
+	public var graphic:FlxGraphic;
+	public var blend:BlendMode;
+	public var repeat:Bool;
+	public var smooth:Bool;
+	public var verts:Vector<Float> = new Vector<Float>();
+	public var uvt:Vector<Float> = new Vector<Float>();
+	public var indices:Vector<Int> = new Vector<Int>();
+	public var vertexCount:Int = 0;
+
+	// screen bounds of everything in the batch
+	public var minX:Float;
+	public var minY:Float;
+	public var maxX:Float;
+	public var maxY:Float;
+
+	public function new() {}
+
+	public function reset(graphic:FlxGraphic, blend:BlendMode, repeat:Bool, smooth:Bool)
+	{
+		this.graphic = graphic;
+		this.blend = blend;
+		this.repeat = repeat;
+		this.smooth = smooth;
+		verts.length = 0;
+		uvt.length = 0;
+		indices.length = 0;
+		vertexCount = 0;
+		minX = minY = Math.POSITIVE_INFINITY;
+		maxX = maxY = Math.NEGATIVE_INFINITY;
+	}
+
+	public inline function matches(graphic:FlxGraphic, blend:BlendMode, repeat:Bool, smooth:Bool):Bool
+		return this.graphic == graphic && this.blend == blend && this.repeat == repeat && this.smooth == smooth;
+
+	public inline function overlaps(minX:Float, minY:Float, maxX:Float, maxY:Float):Bool
+		return minX <= this.maxX && maxX >= this.minX && minY <= this.maxY && maxY >= this.minY;
+
+	/**
+	 * Appends a projected mesh part, baking its screen offset into the vertices.
+	 */
+	public function add(pm:ProjectionMesh, minX:Float, minY:Float, maxX:Float, maxY:Float)
+	{
+		var offsetX = pm.meshPos.x;
+		var offsetY = pm.meshPos.y;
+		var screenVerts = pm.screenVerts;
+		var screenUvt = pm.screenUvt;
+		var v = verts.length;
+		var u = uvt.length;
+		verts.length = v + pm.vertexCount * 2;
+		uvt.length = u + pm.vertexCount * 3;
+		for (i in 0...pm.vertexCount)
+		{
+			verts[v + i * 2] = screenVerts.getF32(i << 3) + offsetX;
+			verts[v + i * 2 + 1] = screenVerts.getF32((i << 3) + 4) + offsetY;
+		}
+		for (i in 0...pm.vertexCount * 3)
+			uvt[u + i] = screenUvt.getF32(i << 2);
+		var first = indices.length;
+		indices.length = first + pm.vertexCount;
+		for (i in 0...pm.vertexCount)
+			indices[first + i] = vertexCount + i;
+		vertexCount += pm.vertexCount;
+
+		if (minX < this.minX)
+			this.minX = minX;
+		if (minY < this.minY)
+			this.minY = minY;
+		if (maxX > this.maxX)
+			this.maxX = maxX;
+		if (maxY > this.maxY)
+			this.maxY = maxY;
+	}
+}
 
 class FlxCameraRenderer extends FlxCamera implements ViewRenderer
 {
+	/**
+	 * How many frames a texture can go unused before it's removed from the native rasterizer.
+	 */
+	public static inline var TEXTURE_LIFETIME:Int = 120;
+
 	public var view:N3DView;
 	public var bg:FlxSprite;
 
-	public var buffers:Map<String, BitmapData> = new Map();
+	/**
+	 * Draws with nebulatracer's tiled z-buffer rasterizer, which has per-pixel depth and uses every core.
+	 * Parts with another `blend` than `NORMAL` or partly transparent texels in their graphic (or atlas region) are blended
+	 * after the opaque ones, back to front and hidden by what's in front of them. ADD, MULTIPLY, SCREEN, SUBTRACT, LIGHTEN,
+	 * DARKEN and DIFFERENCE are supported, other blend modes are drawn as `NORMAL`.
+	 * If false, mesh parts are sorted by depth and drawn back to front with `drawTriangles`.
+	 */
+	public var nativeRasterizer:Bool = true;
+
+	/**
+	 * How many `drawTriangles` calls the last frame took, when not using the native rasterizer.
+	 */
+	public var drawCalls(default, null):Int = 0;
+
+	var batches:Array<TriangleBatch> = [];
+	var batchPool:Array<TriangleBatch> = [];
+	var origin:FlxPoint = FlxPoint.get();
+	var rasterizer:NebulaRasterizer;
+	var frame:FlxSprite;
+	var textures:ObjectMap<FlxGraphic, Int> = new ObjectMap();
+	var textureLastUsed:ObjectMap<FlxGraphic, Int> = new ObjectMap();
+	var textureVersions:ObjectMap<FlxGraphic, Int> = new ObjectMap();
+	var translucentTextures:ObjectMap<FlxGraphic, Bool> = new ObjectMap();
+	var translucentRegions:ObjectMap<AtlasRegion, Bool> = new ObjectMap();
+	var frameCount:Int = 0;
 
 	public function new(view:N3DView)
 	{
@@ -26,12 +137,6 @@ class FlxCameraRenderer extends FlxCamera implements ViewRenderer
 		bg.camera = this;
 	}
 
-	function processBuffers(screenSpaceMeshes:Array<ProjectionMesh>, camSpaceVerts:Array<Array<ClippingVertex>>, meshes:Array<Mesh>)
-	{
-		// ------- Depth buffer ------- //
-		var depthBuffer = new BitmapData(view.width, view.height, true, 0xFF000000);
-	}
-
 	public var rendering = false;
 
 	public function renderScene() {} // nothing draws when i put it in here, i have to overwrite draw myself.
@@ -39,29 +144,196 @@ class FlxCameraRenderer extends FlxCamera implements ViewRenderer
 	override public function draw()
 	{
 		super.draw();
-		bg.draw();
 		if (!view.render)
+		{
+			bg.draw();
+			return;
+		}
+		if (nativeRasterizer)
+		{
+			drawNative();
 			return;
+		}
+		bg.draw();
+
 		var sortedMeshes = view.projectedMeshes.copy();
-		for (i in 0...sortedMeshes.length - 1)
+		sortedMeshes.sort((a, b) -> a.camZ < b.camZ ? -1 : (a.camZ > b.camZ ? 1 : 0));
+		batchMeshes(sortedMeshes);
+		drawCalls = batches.length;
+		for (batch in batches)
+			drawTriangles(batch.graphic, batch.verts, batch.indices, batch.uvt, null, origin, batch.blend, batch.repeat, batch.smooth);
+	}
+
+	/**
+	 * Merges the sorted meshes into as few batches as possible without changing what ends up on screen.
+	 * A mesh can join an earlier batch with the same state only if nothing drawn in between overlaps it on screen.
+	 */
+	function batchMeshes(sortedMeshes:Array<ProjectionMesh>)
+	{
+		for (batch in batches)
+			batchPool.push(batch);
+		batches.resize(0);
+
+		for (pm in sortedMeshes)
 		{
-			for (j in i + 1...sortedMeshes.length)
+			if (pm.vertexCount == 0)
+				continue;
+			var mesh = pm.mesh;
+
+			var minX = Math.POSITIVE_INFINITY;
+			var minY = Math.POSITIVE_INFINITY;
+			var maxX = Math.NEGATIVE_INFINITY;
+			var maxY = Math.NEGATIVE_INFINITY;
+			for (i in 0...pm.vertexCount)
 			{
-				if (sortedMeshes[i].camZ > sortedMeshes[j].camZ)
+				var x:Float = pm.screenVerts.getF32(i << 3);
+				var y:Float = pm.screenVerts.getF32((i << 3) + 4);
+				if (x < minX)
+					minX = x;
+				if (x > maxX)
+					maxX = x;
+				if (y < minY)
+					minY = y;
+				if (y > maxY)
+					maxY = y;
+			}
+			minX += pm.meshPos.x;
+			maxX += pm.meshPos.x;
+			minY += pm.meshPos.y;
+			maxY += pm.meshPos.y;
+
+			var target:TriangleBatch = null;
+			var i = batches.length - 1;
+			while (i >= 0)
+			{
+				var batch = batches[i];
+				if (batch.matches(pm.graphic, mesh.blend, mesh.repeat, mesh.smooth))
 				{
-					var temp = sortedMeshes[i];
-					sortedMeshes[i] = sortedMeshes[j];
-					sortedMeshes[j] = temp;
+					target = batch;
+					break;
 				}
+				if (batch.overlaps(minX, minY, maxX, maxY))
+					break;
+				i--;
+			}
+			if (target == null)
+			{
+				target = batchPool.length > 0 ? batchPool.pop() : new TriangleBatch();
+				target.reset(pm.graphic, mesh.blend, mesh.repeat, mesh.smooth);
+				batches.push(target);
 			}
+			target.add(pm, minX, minY, maxX, maxY);
 		}
-		processBuffers(sortedMeshes, view.camSpaceTris, view.meshes);
-		for (projectedMesh in sortedMeshes)
+	}
+
+	function drawNative()
+	{
+		if (rasterizer == null)
 		{
+			rasterizer = new NebulaRasterizer();
+			frame = new FlxSprite(0, 0);
+			frame.makeGraphic(view.width, view.height, 0xFF000000, true);
+			frame.camera = this;
+		}
+		frameCount++;
+
+		rasterizer.begin(view.width, view.height, 0xFF000000);
+		for (projectedMesh in view.projectedMeshes)
+		{
+			if (projectedMesh.vertexCount == 0)
+				continue;
 			var mesh = projectedMesh.mesh;
 			var meshPos = projectedMesh.meshPos;
-			drawTriangles(mesh._graphic, projectedMesh.verts, projectedMesh.indices, projectedMesh.uvt, null, new FlxPoint(meshPos.x, meshPos.y), mesh.blend,
-				mesh.repeat, mesh.smooth);
+			var texture = getTexture(projectedMesh.graphic);
+			rasterizer.submit(projectedMesh.screenVerts, projectedMesh.screenDepth, projectedMesh.screenUvt, projectedMesh.vertexCount, texture,
+				mesh.repeat, mesh.smooth, toRasterBlend(mesh.blend), isTranslucent(projectedMesh, texture), meshPos.x, meshPos.y);
+		}
+
+		// the whole frame is written straight into the sprite's pixels and uploaded once
+		var pixels = frame.pixels;
+		rasterizer.finish(BitmapDataHelper.getPixelBytes(pixels), BitmapDataHelper.getPixelFormat(pixels));
+		BitmapDataHelper.markDirty(pixels);
+		frame.draw();
+
+		if (frameCount % TEXTURE_LIFETIME == 0)
+			evictTextures();
+	}
+
+	function getTexture(graphic:FlxGraphic):Int
+	{
+		if (graphic == null || graphic.bitmap == null)
+			return -1;
+		textureLastUsed.set(graphic, frameCount);
+		var bitmap = graphic.bitmap;
+		var id = textures.get(graphic);
+		// atlas pages get written to as graphics are added
+		if (id != null && textureVersions.get(graphic) == bitmap.image.version)
+			return id;
+		if (id != null)
+			NebulaRasterizer.disposeTexture(id);
+
+		var pixels = BitmapDataHelper.getPixelBytes(bitmap);
+		if (pixels == null)
+			return -1;
+		id = NebulaRasterizer.createTexture(pixels, bitmap.width, bitmap.height, BitmapDataHelper.getPixelFormat(bitmap),
+			BitmapDataHelper.isPremultiplied(bitmap));
+		textures.set(graphic, id);
+		textureVersions.set(graphic, bitmap.image.version);
+		translucentTextures.set(graphic, NebulaRasterizer.isTextureTranslucent(id, 0, 0, bitmap.width, bitmap.height));
+		return id;
+	}
+
+	// atlas pages mix graphics, so only the part's own region is checked
+	function isTranslucent(pm:ProjectionMesh, texture:Int):Bool
+	{
+		if (texture == -1)
+			return false;
+		var region = pm.region;
+		if (region == null)
+			return translucentTextures.get(pm.graphic);
+		var translucent = translucentRegions.get(region);
+		if (translucent == null)
+		{
+			var size = region.page.size;
+			var x = Math.floor(region.offsetU * size);
+			var y = Math.floor(region.offsetV * size);
+			var width = Std.int(Math.max(1, Math.round(region.scaleU * size)));
+			var height = Std.int(Math.max(1, Math.round(region.scaleV * size)));
+			translucent = NebulaRasterizer.isTextureTranslucent(texture, x, y, width, height);
+			translucentRegions.set(region, translucent);
+		}
+		return translucent;
+	}
+
+	static function toRasterBlend(blend:BlendMode):RasterBlend
+	{
+		return switch (blend)
+		{
+			case ADD: RasterBlend.ADD;
+			case MULTIPLY: RasterBlend.MULTIPLY;
+			case SCREEN: RasterBlend.SCREEN;
+			case SUBTRACT: RasterBlend.SUBTRACT;
+			case LIGHTEN: RasterBlend.LIGHTEN;
+			case DARKEN: RasterBlend.DARKEN;
+			case DIFFERENCE: RasterBlend.DIFFERENCE;
+			default: RasterBlend.NORMAL;
+		}
+	}
+
+	// mesh parts make a new graphic whenever their color changes, so old ones have to be let go
+	function evictTextures()
+	{
+		var unused = [];
+		for (graphic in textures.keys())
+			if (frameCount - textureLastUsed.get(graphic) >= TEXTURE_LIFETIME)
+				unused.push(graphic);
+		for (graphic in unused)
+		{
+			NebulaRasterizer.disposeTexture(textures.get(graphic));
+			textures.remove(graphic);
+			textureLastUsed.remove(graphic);
+			textureVersions.remove(graphic);
+			translucentTextures.remove(graphic);
 		}
 	}
 
@@ -69,5 +341,18 @@ class FlxCameraRenderer extends FlxCamera implements ViewRenderer
 	{
 		super.destroy();
 		FlxG.cameras.remove(this);
+		origin.put();
+		if (rasterizer != null)
+		{
+			for (id in textures)
+				NebulaRasterizer.disposeTexture(id);
+			textures.clear();
+			textureLastUsed.clear();
+			textureVersions.clear();
+			translucentTextures.clear();
+			translucentRegions.clear();
+			rasterizer.dispose();
+			rasterizer = null;
+		}
 	}
 }
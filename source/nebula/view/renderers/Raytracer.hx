@@ -2,28 +2,12 @@ package nebula.view.renderers;
 
 import flixel.*;
 import flixel.util.FlxColor;
-import haxe.Json;
 import nebula.mesh.MeshPart;
+import nebula.mesh.buffers.IndexBuffer;
 import nebula.utils.Vec3DHelper;
 import nebulatracer.NebulaTracer;
 import openfl.geom.Vector3D;
 
-typedef Geometry =
-{
-	var geometry:Array<GeometryMesh>;
-}
-
-typedef GeometryMesh =
-{
-	var meshParts:Array<GeometryMeshPart>;
-}
-
-typedef GeometryMeshPart =
-{
-	var indices:Array<Int>;
-	var vertices:Array<Float>;
-}
-
 typedef Light =
 {
 	var pos:Vector3D;
@@ -39,9 +23,36 @@ class Raytracer implements ViewRenderer extends FlxCamera
 	public var maxProg:Int;
 	public var view:N3DView;
 	public var geom:Array<MeshPart> = [];
-	public var prevGeoms:Array<Array<MeshPart>> = [];
 	public var lights:Array<Light> = [];
 
+	/**
+	 * Whether bounce rays are traced against `coarseTracer`, a copy of the scene built from each part's coarsest LOD
+	 * within `coarseError` (local units). Bounce lighting is blurry anyway and doesn't need the detail.
+	 * The geomIDs match the full scene, so results index `geom` the same way.
+	 */
+	public var coarseBounces:Bool = false;
+
+	public var coarseError:Float = 1;
+	public var coarseTracer(default, null):NebulaTracer;
+
+	/**
+	 * Goes up every time the camera, the geometry, a material or a light changed, accumulated samples are stale after that.
+	 */
+	public var sceneVersion(default, null):Int = 0;
+
+	/**
+	 * Like `sceneVersion` but ignores the camera, only goes up when the geometry, a material or a light changed.
+	 */
+	public var contentVersion(default, null):Int = 0;
+
+	var lastCameraVersion:Int = -1;
+
+	// what each geomID slot held the last time the geometry was synced
+	var uploadedParts:Array<MeshPart> = [];
+	var uploadedGenerations:Array<Int> = [];
+	var uploadedCoarse:Array<IndexBuffer> = [];
+	var uploadedCoarseGenerations:Array<Int> = [];
+
 	public function new(view:N3DView)
 	{
 		super();
@@ -53,111 +64,98 @@ class Raytracer implements ViewRenderer extends FlxCamera
 		raytracer = new NebulaTracer();
 	}
 
-	function jsonifyGeom():String
+	/**
+	 * Uploads the mesh parts whose generation changed since the last sync, the tracer hashes them natively
+	 * and only re-uploads the ones whose content actually differs. Tracing is only stopped for a real upload.
+	 * @return Whether the BVH had to be rebuilt.
+	 */
+	function syncGeometry():Bool
 	{
-		var geometry:Geometry = {
-			geometry: []
+		var changed = uploadedParts.length != geom.length;
+		if (changed)
+		{
+			beforeSceneEdit();
+			raytracer.setMeshPartCount(geom.length);
 		}
-		for (mesh in view.meshes)
+		for (i in 0...geom.length)
 		{
-			var geometryMesh:GeometryMesh = {
-				meshParts: []
-			}
-			for (meshPart in mesh.meshParts)
+			var part = geom[i];
+			if (i < uploadedParts.length && uploadedParts[i] == part && uploadedGenerations[i] == part.generation)
+				continue;
+
+			var vertices = part.vertices;
+			var indices = part.indices;
+			if (!raytracer.meshPartMatches(i, vertices.bytes, vertices.length, indices.bytes, indices.length))
 			{
-				var indices = [];
-				for (index in meshPart.indices)
-					indices.push(index);
-				var vertices = [];
-				for (vertex in meshPart.vertices)
-				{
-					vertices.push(vertex.x);
-					vertices.push(vertex.y);
-					vertices.push(vertex.z);
-				}
-				var geometryMeshPart:GeometryMeshPart = {
-					indices: indices,
-					vertices: vertices
-				}
-				geometryMesh.meshParts.push(geometryMeshPart);
+				beforeSceneEdit();
+				// copied natively, the part can grow or edit its buffers without touching the BVH
+				if (raytracer.uploadMeshPart(i, vertices.bytes, vertices.length, indices.bytes, indices.length))
+					changed = true;
 			}
-			geometry.geometry.push(geometryMesh);
+			uploadedParts[i] = part;
+			uploadedGenerations[i] = part.generation;
 		}
-		return Json.stringify(geometry);
+		uploadedParts.resize(geom.length);
+		uploadedGenerations.resize(geom.length);
+
+		if (changed)
+			raytracer.rebuildBVH();
+		if (coarseBounces)
+			syncCoarseGeometry();
+		return changed;
 	}
 
-	function compareMeshParts(a:MeshPart, b:MeshPart):Float
+	/**
+	 * Same as `syncGeometry` for `coarseTracer`, it only needs the geometry since colors are read from `geom`.
+	 */
+	function syncCoarseGeometry():Bool
 	{
-		if (a.vertices.length != b.vertices.length || a.indices.length != b.indices.length)
-			return 1;
-
-		var vertexDiff:Float = 0;
-		for (i in 0...a.vertices.length)
+		if (coarseTracer == null)
+			coarseTracer = new NebulaTracer();
+		var changed = uploadedCoarse.length != geom.length;
+		if (changed)
 		{
-			final va = a.vertices[i];
-			final vb = b.vertices[i];
-			vertexDiff += Math.abs(va.x - vb.x) + Math.abs(va.y - vb.y) + Math.abs(va.z - vb.z);
+			beforeSceneEdit();
+			coarseTracer.setMeshPartCount(geom.length);
 		}
-		vertexDiff /= a.vertices.length;
-		var scaledVertexDiff = Math.min(vertexDiff / 10.0, 1.0);
-
-		var indexDiff:Int = 0;
-		for (i in 0...a.indices.length)
+		for (i in 0...geom.length)
 		{
-			if (a.indices[i] != b.indices[i])
-				indexDiff++;
-		}
-		var indexDiffRatio = indexDiff / a.indices.length;
-
-		var normalDiff:Float = 0;
-		for (i in 0...a.normals.length)
-		{
-			final na = a.normals[i];
-			final nb = b.normals[i];
-			normalDiff += Math.abs(na.x - nb.x) + Math.abs(na.y - nb.y) + Math.abs(na.z - nb.z);
-		}
-		normalDiff /= a.normals.length;
-		var scaledNormalDiff = Math.min(normalDiff / 10.0, 1.0);
-
-		var combined = 0.5 * scaledVertexDiff + 0.5 * indexDiffRatio + 0.5 * scaledNormalDiff;
-		return Math.min(combined, 1.0);
-	}
-
-	function compareGeoms(a:Array<MeshPart>, b:Array<MeshPart>):Float
-	{
-		if (a.length == 0 && b.length == 0)
-			return 0;
+			var part = geom[i];
+			var indices = part.getLOD(coarseError);
+			if (i < uploadedCoarse.length && uploadedCoarse[i] == indices && uploadedCoarseGenerations[i] == part.generation)
+				continue;
 
-		var total:Float = 0;
-		var maxCount:Int = cast Math.max(a.length, b.length);
-		for (i in 0...maxCount)
-		{
-			if (i >= a.length || i >= b.length)
+			var vertices = part.vertices;
+			if (!coarseTracer.meshPartMatches(i, vertices.bytes, vertices.length, indices.bytes, indices.length))
 			{
-				total += 1;
-				continue;
+				beforeSceneEdit();
+				if (coarseTracer.uploadMeshPart(i, vertices.bytes, vertices.length, indices.bytes, indices.length))
+					changed = true;
 			}
-
-			final partA = a[i];
-			final partB = b[i];
-
-			var diff = compareMeshParts(partA, partB);
-			if (diff >= 0.2)
-				total += diff;
+			uploadedCoarse[i] = indices;
+			uploadedCoarseGenerations[i] = part.generation;
 		}
+		uploadedCoarse.resize(geom.length);
+		uploadedCoarseGenerations.resize(geom.length);
 
-		return (total / maxCount) * 100;
+		if (changed)
+			coarseTracer.rebuildBVH();
+		return changed;
 	}
 
-	function deepCopyGeom(source:Array<MeshPart>):Array<MeshPart>
+	/**
+	 * Called right before anything the tracer reads gets edited. Renderers tracing on other threads stop them here.
+	 */
+	function beforeSceneEdit() {}
+
+	static function sameItems<T>(a:Array<T>, b:Array<T>):Bool
 	{
-		var out = [];
-		for (part in source)
-		{
-			var copied = new MeshPart(part.vertices.copy(), part.indices.copy(), part.uvt.copy(), part.normals.copy(), part.graphic, false);
-			out.push(copied);
-		}
-		return out;
+		if (a.length != b.length)
+			return false;
+		for (i in 0...a.length)
+			if (a[i] != b[i])
+				return false;
+		return true;
 	}
 
 	function reflect(dir:Vector3D, normal:Vector3D):Vector3D
@@ -190,6 +188,35 @@ class Raytracer implements ViewRenderer extends FlxCamera
 		return new FloatColor(rAvg, gAvg, bAvg);
 	}
 
+	/**
+	 * Pushes material and light edits to the raytracer, this never touches the geometry or the BVH.
+	 * @return Whether any material or light changed.
+	 */
+	function syncMaterials():Bool
+	{
+		raytracer.setMaterialCount(geom.length);
+		for (i in 0...geom.length)
+		{
+			var part = geom[i];
+			var props = part.raytracingProperties;
+			raytracer.setMaterial(i, part._color.red, part._color.green, part._color.blue, props.reflectiveness, props.emissiveness, props.isEmitter);
+		}
+
+		raytracer.setLightCount(lights.length);
+		for (i in 0...lights.length)
+		{
+			var light = lights[i];
+			raytracer.setLight(i, light.pos.x, light.pos.y, light.pos.z, light.color.red, light.color.green, light.color.blue, light.power,
+				geom.indexOf(light.meshPart));
+		}
+
+		if (raytracer.hasPendingChanges())
+			beforeSceneEdit();
+		var materialsChanged = raytracer.commitMaterials();
+		var lightsChanged = raytracer.commitLights();
+		return materialsChanged || lightsChanged;
+	}
+
 	public var rendering = false;
 
 	public function renderScene()
@@ -197,45 +224,46 @@ class Raytracer implements ViewRenderer extends FlxCamera
 		if (rendering)
 			return;
 		rendering = true;
-		geom = [];
-		lights = [];
+		syncScene();
+		prog = 0;
+	}
+
+	/**
+	 * Collects the view's mesh parts and lights and syncs them with the tracer.
+	 * `sceneVersion` goes up if they or the camera changed.
+	 */
+	function syncScene()
+	{
+		// built aside, tracing threads may be reading the current lists
+		var newGeom:Array<MeshPart> = [];
+		var newLights:Array<Light> = [];
 
 		for (mesh in view.meshes)
 		{
 			for (meshPart in mesh.meshParts)
 			{
-				geom.push(meshPart);
+				newGeom.push(meshPart);
 				if (meshPart.raytracingProperties.isEmitter)
-					lights = lights.concat(meshPart.raytracingProperties.lightPointers);
+					newLights = newLights.concat(meshPart.raytracingProperties.lightPointers);
 			}
 		}
 
-		if (prevGeoms.length != 0)
+		if (!sameItems(geom, newGeom) || !sameItems(lights, newLights))
 		{
-			if (geom != prevGeoms[prevGeoms.length - 1])
-			{
-				final oldGeom = prevGeoms[0];
-				final change = compareGeoms(oldGeom, geom);
-
-				if (change > 0)
-				{
-					raytracer.geometry = jsonifyGeom();
-					raytracer.rebuildBVH();
-				}
-
-				prevGeoms.shift(); // remove oldest
-			}
+			beforeSceneEdit();
+			geom = newGeom;
+			lights = newLights;
 		}
-		else
+
+		var geometryChanged = syncGeometry();
+		var materialsChanged = syncMaterials();
+		if (geometryChanged || materialsChanged)
+			contentVersion++;
+		if (geometryChanged || materialsChanged || view.cameraVersion != lastCameraVersion)
 		{
-			raytracer.geometry = jsonifyGeom();
-			raytracer.buildBVH();
+			lastCameraVersion = view.cameraVersion;
+			sceneVersion++;
 		}
-		// keep a history of the last 20 geoms to detect if theres a big enough change to rebuild the bvh
-		if (prevGeoms.length < 20)
-			prevGeoms.push(deepCopyGeom(geom));
-
-		prog = 0;
 	}
 }
 
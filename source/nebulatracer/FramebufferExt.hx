@@ -0,0 +1,47 @@
+package nebulatracer;
+
+import nebulatracer.native.Framebuffer;
+
+/**
+ * The native side of `NebulaFramebuffer`.
+ */
+class FramebufferExt
+{
+	public static function newFramebuffer(width:Int, height:Int):Int
+		return Framebuffer.new_framebuffer(width, height);
+
+	public static function disposeFramebuffer(id:Int)
+		Framebuffer.dispose_framebuffer(id);
+
+	public static function reset(id:Int, width:Int, height:Int)
+		Framebuffer.reset_framebuffer(id, width, height);
+
+	public static function addSample(id:Int, x:Int, y:Int, r:Float, g:Float, b:Float)
+		Framebuffer.add_framebuffer_sample(id, x, y, r, g, b);
+
+	public static function getSampleCount(id:Int, x:Int, y:Int):Int
+		return Framebuffer.framebuffer_sample_count(id, x, y);
+
+	public static function resolve(id:Int, out:hl.Bytes, fillRadius:Int):Float
+		return Framebuffer.resolve_framebuffer(id, out, fillRadius);
+
+	public static function updateConvergence(id:Int, targetError:Float, minSamples:Int, maxSamples:Int, stride:Int, outTileSamples:hl.Bytes):Int
+		return Framebuffer.update_framebuffer_convergence(id, targetError, minSamples, maxSamples, stride, outTileSamples);
+
+	public static function addFeatures(id:Int, x:Int, y:Int, albedoR:Float, albedoG:Float, albedoB:Float, normalX:Float, normalY:Float, normalZ:Float,
+			depth:Float, geomID:Int)
+		Framebuffer.add_framebuffer_features(id, x, y, albedoR, albedoG, albedoB, normalX, normalY, normalZ, depth, geomID);
+
+	public static function reproject(id:Int, fromCamera:hl.Bytes, toCamera:hl.Bytes, maxHistory:Int):Int
+		return Framebuffer.reproject_framebuffer(id, fromCamera, toCamera, maxHistory);
+
+	public static function isDenoiserAvailable(mode:Int):Bool
+		return Framebuffer.is_denoiser_available(mode);
+
+	public static function denoise(id:Int, color:hl.Bytes, out:hl.Bytes, mode:Int, iterations:Int, sigmaColor:Float, sigmaNormal:Float,
+			sigmaDepth:Float):Int
+		return Framebuffer.denoise_framebuffer(id, color, out, mode, iterations, sigmaColor, sigmaNormal, sigmaDepth);
+
+	public static function tonemapFrame(color:hl.Bytes, width:Int, height:Int, out:hl.Bytes, format:Int, op:Int, exposure:Float, srgb:Bool)
+		Framebuffer.tonemap_frame(color, width, height, out, format, op, exposure, srgb);
+}
@@ -0,0 +1,110 @@
+package nebulatracer;
+
+import nebulatracer.native.MeshIO;
+
+/**
+ * Native mesh loading. Loaders return the ID of a mesh held by nebulatracer,
+ * read its parts with `getPartCount`/`getPartInfo`/`copyPart` and `free` it once copied.
+ * 
+ * `.nmesh` files are memory mapped instead, their streams are used in place and stay valid until `closeNMesh`.
+ */
+class MeshIOExt
+{
+	/**
+	 * Memory maps an OBJ file (and its mtllib) and parses it on all cores.
+	 * @return The ID of the loaded mesh, or -1 if the file couldn't be opened.
+	 */
+	public static function loadOBJFile(path:String):Int
+		return MeshIO.load_obj_file(path);
+
+	/**
+	 * Parses OBJ and MTL data that's already in memory.
+	 * @param mtlData Can be null, the mtllib is then read from `dir`.
+	 * @param dir Where textures (and the mtllib) are looked up.
+	 */
+	public static function loadOBJData(objData:String, mtlData:String, dir:String):Int
+		return MeshIO.load_obj_data(objData, mtlData, dir);
+
+	public static function getPartCount(id:Int):Int
+		return MeshIO.loaded_part_count(id);
+
+	/**
+	 * Writes the vertex count, index count, whether the part has a color (0 or 1) and its ARGB color into `out` as int32.
+	 */
+	public static function getPartInfo(id:Int, part:Int, out:hl.Bytes)
+		MeshIO.loaded_part_info(id, part, out);
+
+	/**
+	 * The path of the part's texture, empty if it has none.
+	 */
+	public static function getPartTexture(id:Int, part:Int):String
+		return @:privateAccess String.fromUTF8(MeshIO.loaded_part_texture(id, part));
+
+	/**
+	 * Copies a part into buffers sized from `getPartInfo`: 3 float32 per vertex in `vertices`, 2 in `uvs` and int32 `indices`.
+	 */
+	public static function copyPart(id:Int, part:Int, vertices:hl.Bytes, uvs:hl.Bytes, indices:hl.Bytes)
+		MeshIO.copy_loaded_part(id, part, vertices, uvs, indices);
+
+	public static function free(id:Int)
+		MeshIO.free_loaded_mesh(id);
+
+	/**
+	 * Memory maps and validates a `.nmesh` file.
+	 * @return The ID of the file, or -1 if it couldn't be opened or isn't a valid `.nmesh`.
+	 */
+	public static function openNMesh(path:String):Int
+		return MeshIO.open_nmesh(path);
+
+	/**
+	 * Same as `openNMesh` for a `.nmesh` that's already in memory, the data is copied.
+	 */
+	public static function openNMeshData(data:hl.Bytes, size:Int):Int
+		return MeshIO.open_nmesh_data(data, size);
+
+	public static function getNMeshPartCount(id:Int):Int
+		return MeshIO.nmesh_part_count(id);
+
+	/**
+	 * Writes the vertex count, index count, uv count, flags and ARGB color as int32 into `out`,
+	 * followed by 13 float32 of bounds (min, max, center, radius, centroid) if the part has them. `out` needs 72 bytes.
+	 */
+	public static function getNMeshPartInfo(id:Int, part:Int, out:hl.Bytes)
+		MeshIO.nmesh_part_info(id, part, out);
+
+	/**
+	 * A stream of the part inside the mapped file: 0 positions, 1 normals (null if the part has none), 2 uvs, 3 indices.
+	 */
+	public static function getNMeshStream(id:Int, part:Int, stream:Int):hl.Bytes
+		return MeshIO.nmesh_part_stream(id, part, stream);
+
+	public static function getNMeshGraphic(id:Int, part:Int):String
+		return @:privateAccess String.fromUTF8(MeshIO.nmesh_part_graphic(id, part));
+
+	/**
+	 * Unmaps a `.nmesh`. Any buffer still wrapping its streams becomes invalid.
+	 */
+	public static function closeNMesh(id:Int)
+		MeshIO.close_nmesh(id);
+
+	/**
+	 * Welds, drops degenerate triangles and reorders a part for the vertex cache, see `nebula.mesh.MeshOptimizer`.
+	 * `normals` and `uvs` can be null. The outputs must be as large as the inputs (`outUvs` at least 2 floats per vertex),
+	 * the vertex, index and uv counts written are stored as int32 in `outCounts`.
+	 */
+	public static function optimizeMeshPart(positions:hl.Bytes, normals:hl.Bytes, uvs:hl.Bytes, uvCount:Int, vertexCount:Int, indices:hl.Bytes,
+			indexCount:Int, tolerance:Float, outPositions:hl.Bytes, outNormals:hl.Bytes, outUvs:hl.Bytes, outIndices:hl.Bytes, outCounts:hl.Bytes)
+		MeshIO.optimize_mesh_part(positions, normals, uvs, uvCount, vertexCount, indices, indexCount, tolerance, outPositions, outNormals, outUvs,
+			outIndices, outCounts);
+
+	/**
+	 * Collapses edges until at most `targetIndexCount` indices are left or the surface would move more than `maxError`,
+	 * see `nebula.mesh.MeshSimplifier`. The result indexes the same vertices.
+	 * @param outIndices As large as `indices`.
+	 * @param outError Gets how far (float32) the surface moved at most.
+	 * @return How many indices were written.
+	 */
+	public static function simplifyMesh(positions:hl.Bytes, vertexCount:Int, indices:hl.Bytes, indexCount:Int, targetIndexCount:Int, maxError:Float,
+			outIndices:hl.Bytes, outError:hl.Bytes):Int
+		return MeshIO.simplify_mesh(positions, vertexCount, indices, indexCount, targetIndexCount, maxError, outIndices, outError);
+}
@@ -0,0 +1,169 @@
+package nebulatracer;
+
+/**
+ * Which denoiser `NebulaFramebuffer.denoise` runs.
+ */
+enum abstract DenoiserMode(Int)
+{
+	var NONE = 0;
+
+	/**
+	 * An edge avoiding à-trous wavelet filter (SVGF style) guided by the albedo, normal and depth features. Always available.
+	 */
+	var ATROUS = 1;
+
+	/**
+	 * Intel Open Image Denoise on the CPU, only when nebulatracer was built with `NEBULATRACER_OIDN`.
+	 */
+	var OIDN = 2;
+}
+
+/**
+ * A float32 HDR accumulation buffer.
+ * 
+ * Every traced sample is added into its pixel with `addSample` and `resolve` gives the running mean,
+ * so the image keeps getting cleaner until `reset` is called (after the camera or the scene changed).
+ * 
+ * It also tracks how noisy every `TILE_SIZE` tile still is, `updateConvergence` tells how many samples each tile should get next.
+ * 
+ * What the primary rays hit can be added with `addFeatures`, `denoise` uses it to clean up a resolved frame without blurring edges.
+ * When only the camera moved, `reproject` keeps the samples it can still see instead of starting over.
+ * 
+ * You can run `dispose` to free up resources once this framebuffer isn't needed.
+ */
+class NebulaFramebuffer
+{
+	/**
+	 * Convergence is tracked per tile of this many pixels squared, must match `FRAMEBUFFER_TILE` in nebulatracer.cpp.
+	 */
+	public static inline var TILE_SIZE:Int = 16;
+
+	private var _ID:Int;
+
+	public var width(default, null):Int;
+	public var height(default, null):Int;
+	public var tilesX(get, never):Int;
+	public var tilesY(get, never):Int;
+
+	/**
+	 * Creates a new NebulaFramebuffer.
+	 */
+	public function new(width:Int, height:Int)
+	{
+		this.width = width;
+		this.height = height;
+		_ID = FramebufferExt.newFramebuffer(width, height);
+	}
+
+	/**
+	 * Throws away every sample, optionally resizing the buffer.
+	 */
+	public function reset(width:Int = -1, height:Int = -1)
+	{
+		if (width > 0)
+			this.width = width;
+		if (height > 0)
+			this.height = height;
+		FramebufferExt.reset(_ID, this.width, this.height);
+	}
+
+	/**
+	 * Adds an HDR sample to a pixel. Different threads may add samples at once as long as they never write the same pixel.
+	 */
+	public function addSample(x:Int, y:Int, red:Float, green:Float, blue:Float)
+	{
+		FramebufferExt.addSample(_ID, x, y, red, green, blue);
+	}
+
+	/**
+	 * How many samples a pixel has.
+	 */
+	public function getSampleCount(x:Int, y:Int):Int
+	{
+		return FramebufferExt.getSampleCount(_ID, x, y);
+	}
+
+	/**
+	 * Writes the mean of every pixel into `out` as float32 r, g, b (`width * height * 12` bytes).
+	 * Pixels without samples yet copy the nearest sampled one.
+	 * @param fillRadius Above 0, pixels without samples are blended from the sampled ones within this many pixels instead.
+	 * Around the spacing of the samples looks smooth.
+	 * @return The number of samples in the buffer.
+	 */
+	public function resolve(out:hl.Bytes, fillRadius:Int = 0):Float
+	{
+		return FramebufferExt.resolve(_ID, out, fillRadius);
+	}
+
+	/**
+	 * Works out how many samples per pixel every tile needs next from the noise of its pixels.
+	 * A converged tile (relative error at or under `targetError` and at least `minSamples` per sampled pixel) gets 0,
+	 * the others get 1 to `maxSamples`, more the noisier they are.
+	 * @param stride Only pixels on this grid get traced, a tile with one of them still unsampled isn't converged.
+	 * @param outTileSamples One byte per tile, row by row (`tilesX * tilesY` bytes).
+	 * @return How many tiles converged.
+	 */
+	public function updateConvergence(targetError:Float, minSamples:Int, maxSamples:Int, stride:Int, outTileSamples:hl.Bytes):Int
+	{
+		return FramebufferExt.updateConvergence(_ID, targetError, minSamples, maxSamples, stride, outTileSamples);
+	}
+
+	/**
+	 * Adds what the primary ray of a pixel hit, for `denoise` and `reproject`. Rays that hit nothing should pass an albedo of 1,
+	 * a zero normal and a `geomID` of -1. Add them before the pixel's sample, reprojected history is dropped if the geometry differs.
+	 */
+	public function addFeatures(x:Int, y:Int, albedoR:Float, albedoG:Float, albedoB:Float, normalX:Float, normalY:Float, normalZ:Float, depth:Float,
+			geomID:Int = -1)
+	{
+		FramebufferExt.addFeatures(_ID, x, y, albedoR, albedoG, albedoB, normalX, normalY, normalZ, depth, geomID);
+	}
+
+	/**
+	 * Moves the accumulated samples to where a new camera sees them. Pixels without features are cleared,
+	 * so are the ones nothing lands on (disoccluded) and the ones whose surface now faces away.
+	 * @param fromCamera The camera the samples were traced with, 6 float32s: x, y, z, yaw, pitch (radians) and fov (degrees).
+	 * @param toCamera The new camera, same layout.
+	 * @param maxHistory How many samples a pixel keeps at most, lower lets fresh samples take over faster.
+	 * @return How many pixels kept their history.
+	 */
+	public function reproject(fromCamera:hl.Bytes, toCamera:hl.Bytes, maxHistory:Int):Int
+	{
+		return FramebufferExt.reproject(_ID, fromCamera, toCamera, maxHistory);
+	}
+
+	/**
+	 * Denoises a frame written by `resolve` into `out` (same layout, can't be `color`).
+	 * @param iterations How many à-trous passes to run, each one doubles the filter's reach.
+	 * @param sigmaColor How many standard deviations of a pixel's noise its neighbours' luminance may be off by.
+	 * @param sigmaNormal The exponent on the cosine between normals, higher keeps creases sharper.
+	 * @param sigmaDepth How far off, relative to the pixel's depth, a neighbour's depth may be.
+	 * @return The mode that ran, `OIDN` falls back to `ATROUS` when it isn't available.
+	 */
+	public function denoise(color:hl.Bytes, out:hl.Bytes, mode:DenoiserMode, iterations:Int = 5, sigmaColor:Float = 4, sigmaNormal:Float = 128,
+			sigmaDepth:Float = 0.1):DenoiserMode
+	{
+		return cast FramebufferExt.denoise(_ID, color, out, cast mode, iterations, sigmaColor, sigmaNormal, sigmaDepth);
+	}
+
+	/**
+	 * Whether this build of nebulatracer has the denoiser `mode`.
+	 */
+	public static function isDenoiserAvailable(mode:DenoiserMode):Bool
+	{
+		return FramebufferExt.isDenoiserAvailable(cast mode);
+	}
+
+	inline function get_tilesX():Int
+		return Std.int((width + TILE_SIZE - 1) / TILE_SIZE);
+
+	inline function get_tilesY():Int
+		return Std.int((height + TILE_SIZE - 1) / TILE_SIZE);
+
+	/**
+	 * Disposes of this framebuffer. This framebuffer becomes unusable after running this.
+	 */
+	public function dispose()
+	{
+		FramebufferExt.disposeFramebuffer(_ID);
+	}
+}
@@ -0,0 +1,80 @@
+package nebulatracer;
+
+/**
+ * A grid of light probes spread over the bounds of a `NebulaTracer`'s scene, each one keeps the light arriving at it
+ * as L1 spherical harmonics.
+ * 
+ * `update` traces a batch of rays from the next few probes on the native worker threads, so the grid gets refined a little
+ * every frame until every probe has `maxRays`. `sample` then gives the diffuse light bouncing off any point of the scene
+ * for the cost of a lookup, blended from the 8 probes around it. Call `reset` after the geometry changed.
+ * 
+ * You can run `dispose` to free up resources once this grid isn't needed.
+ */
+class NebulaProbeGrid
+{
+	private var _ID:Int;
+
+	/**
+	 * How many probes the grid has, 0 until `reset` found a scene.
+	 */
+	public var probeCount(default, null):Int = 0;
+
+	/**
+	 * Whether every probe got `maxRays` rays, `update` does nothing until the next `reset`.
+	 */
+	public var converged(default, null):Bool = false;
+
+	/**
+	 * Creates a new NebulaProbeGrid, it's empty until `reset` is called.
+	 */
+	public function new()
+	{
+		_ID = ProbeGridExt.newProbeGrid();
+	}
+
+	/**
+	 * Spreads the probes over the bounds of `tracer`'s scene and throws away everything traced so far.
+	 * @param resolution How many probes go along the longest side of the bounds, the other sides get the same spacing.
+	 */
+	public function reset(tracer:NebulaTracer, resolution:Int)
+	{
+		probeCount = ProbeGridExt.reset(_ID, tracer._ID, resolution);
+		converged = false;
+	}
+
+	/**
+	 * Traces `raysPerProbe` more rays from each of the next `probes` probes, blocking until they're done.
+	 * @param tracer What the rays are traced against.
+	 * @param materials The tracer whose materials color what the rays hit, the geomIDs must match `tracer`'s.
+	 * @param skyR The light of the rays that hit nothing.
+	 * @param cache With more than 1 `bounces`, what the rays hit is lit by paths of up to `bounces - 1` more bounces through this cache
+	 * (and `materials`' lights). Otherwise it only gives its color.
+	 * @return How many probes were refined.
+	 */
+	public function update(tracer:NebulaTracer, materials:NebulaTracer, probes:Int, raysPerProbe:Int, maxRays:Int, skyR:Float, skyG:Float,
+			skyB:Float, ?cache:NebulaRadianceCache, bounces:Int = 1):Int
+	{
+		var refined = ProbeGridExt.update(_ID, tracer._ID, materials._ID, probes, raysPerProbe, maxRays, skyR, skyG, skyB,
+			cache != null ? cache._ID : -1, bounces);
+		converged = refined == 0;
+		return refined;
+	}
+
+	/**
+	 * Writes the diffuse light bouncing off a surface at the point facing `normal` into `out`, 3 float32s (r, g, b).
+	 * Safe to call from any thread, also while `update` runs.
+	 * @return False if none of the probes around the point were traced yet, `out` isn't touched then.
+	 */
+	public function sample(x:Float, y:Float, z:Float, normalX:Float, normalY:Float, normalZ:Float, out:hl.Bytes):Bool
+	{
+		return ProbeGridExt.sample(_ID, x, y, z, normalX, normalY, normalZ, out);
+	}
+
+	/**
+	 * Disposes of this grid. This grid becomes unusable after running this.
+	 */
+	public function dispose()
+	{
+		ProbeGridExt.disposeProbeGrid(_ID);
+	}
+}
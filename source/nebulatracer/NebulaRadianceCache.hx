@@ -0,0 +1,54 @@
+package nebulatracer;
+
+/**
+ * A spatial hash of the light leaving a scene's surfaces, keyed on the position (snapped to a cell), the normal
+ * and how many bounces of light are left, a vertex at the end of a path never stands in for one further up.
+ * 
+ * Paths traced through it (see `NebulaProbeGrid.update`) add what every vertex they reach sees, and end at the first
+ * vertex with `minSamples` already cached, reading it instead of tracing further. Once it filled in, light bounced
+ * any number of times costs about as much as a single bounce. Any number of threads can use it at once, it never locks.
+ * 
+ * Call `reset` before the first use and after the scene changed. You can run `dispose` to free up resources once this cache isn't needed.
+ */
+class NebulaRadianceCache
+{
+	@:allow(nebulatracer.NebulaProbeGrid)
+	private var _ID:Int;
+
+	/**
+	 * How many slots are taken, counting them walks the whole table.
+	 */
+	public var size(get, never):Int;
+
+	/**
+	 * Creates a new NebulaRadianceCache, it can't hold anything until `reset` is called.
+	 */
+	public function new()
+	{
+		_ID = RadianceCacheExt.newRadianceCache();
+	}
+
+	/**
+	 * Empties the cache. Nothing may trace through it meanwhile.
+	 * @param tracer The scene, the cells are sized from its bounds.
+	 * @param capacity How many vertices fit, rounded up to a power of two. Vertices that don't fit are traced uncached.
+	 * @param cells How many cells go along the longest side of the scene.
+	 * @param minSamples How many samples a vertex needs before paths end there.
+	 * @param maxSamples How many samples a vertex takes at most, it stops changing after that.
+	 */
+	public function reset(tracer:NebulaTracer, capacity:Int = 1 << 18, cells:Int = 256, minSamples:Int = 4, maxSamples:Int = 64)
+	{
+		RadianceCacheExt.reset(_ID, tracer._ID, capacity, cells, minSamples, maxSamples);
+	}
+
+	inline function get_size():Int
+		return RadianceCacheExt.getSize(_ID);
+
+	/**
+	 * Disposes of this cache. This cache becomes unusable after running this.
+	 */
+	public function dispose()
+	{
+		RadianceCacheExt.disposeRadianceCache(_ID);
+	}
+}
@@ -0,0 +1,113 @@
+package nebulatracer;
+
+/**
+ * How `NebulaRasterizer` blends a part over what's behind it, weighted by the texel's alpha.
+ */
+enum abstract RasterBlend(Int) to Int
+{
+	var NORMAL = 0;
+	var ADD = 1;
+	var MULTIPLY = 2;
+	var SCREEN = 3;
+	var SUBTRACT = 4;
+	var LIGHTEN = 5;
+	var DARKEN = 6;
+	var DIFFERENCE = 7;
+}
+
+/**
+ * A tiled, multithreaded z-buffer rasterizer.
+ * 
+ * Every frame, call `begin`, `submit` the output of `RasterizerExt.projectMeshPart` for every mesh part,
+ * then `finish` to write the frame into a pixel buffer.
+ * `finish` bins the triangles into 64x64 tiles and rasterizes the tiles across all cores, with a per-pixel depth test,
+ * so the submission order doesn't matter.
+ * Parts with another blend than `NORMAL` and the partly transparent texels of `translucent` parts are drawn after that,
+ * back to front per triangle, depth tested against the opaque parts but without hiding each other.
+ * 
+ * Textures are copied into nebulatracer with `createTexture` and referenced by ID.
+ * 
+ * You can run `dispose` to free up resources once this rasterizer isn't needed.
+ */
+class NebulaRasterizer
+{
+	private var _ID:Int;
+
+	/**
+	 * Creates a new NebulaRasterizer.
+	 */
+	public function new()
+	{
+		_ID = RasterizerExt.newRasterizer();
+	}
+
+	/**
+	 * Copies a texture into nebulatracer, textures are shared between all rasterizers.
+	 * @param format The lime `PixelFormat` of `pixels`.
+	 * @return The ID of the texture.
+	 */
+	public static function createTexture(pixels:hl.Bytes, width:Int, height:Int, format:Int, premultiplied:Bool):Int
+	{
+		return RasterizerExt.createTexture(pixels, width, height, format, premultiplied);
+	}
+
+	/**
+	 * Whether a rectangle of a texture has partly transparent texels, parts drawn from it should be submitted as `translucent`.
+	 */
+	public static function isTextureTranslucent(id:Int, x:Int, y:Int, width:Int, height:Int):Bool
+	{
+		return RasterizerExt.isTextureTranslucent(id, x, y, width, height);
+	}
+
+	/**
+	 * Frees a texture made with `createTexture`.
+	 */
+	public static function disposeTexture(id:Int)
+	{
+		RasterizerExt.disposeTexture(id);
+	}
+
+	/**
+	 * Starts a new frame.
+	 * @param clearColor The ARGB color of pixels nothing was drawn on.
+	 */
+	public function begin(width:Int, height:Int, clearColor:Int)
+	{
+		RasterizerExt.begin(_ID, width, height, clearColor);
+	}
+
+	/**
+	 * Adds a projected mesh part to the frame.
+	 * @param verts Screen space x, y float32 per vertex.
+	 * @param depth 1/w float32 per vertex.
+	 * @param uvt u, v, t float32 per vertex.
+	 * @param vertexCount The number of vertices, every 3 make a triangle.
+	 * @param textureID A texture from `createTexture`, -1 draws white.
+	 * @param translucent Whether the texels the part uses can be partly transparent, see `isTextureTranslucent`.
+	 * @param offsetX Screen space offset added to every vertex.
+	 * @param offsetY Screen space offset added to every vertex.
+	 */
+	public function submit(verts:hl.Bytes, depth:hl.Bytes, uvt:hl.Bytes, vertexCount:Int, textureID:Int, repeat:Bool, smooth:Bool,
+			blend:RasterBlend = NORMAL, translucent:Bool = false, offsetX:Float = 0, offsetY:Float = 0)
+	{
+		RasterizerExt.submit(_ID, verts, depth, uvt, vertexCount, textureID, repeat, smooth, blend, translucent, offsetX, offsetY);
+	}
+
+	/**
+	 * Rasterizes the frame and writes it into `out`.
+	 * @param out The destination, width * height pixels of 4 bytes.
+	 * @param format The lime `PixelFormat` of `out`.
+	 */
+	public function finish(out:hl.Bytes, format:Int)
+	{
+		RasterizerExt.finish(_ID, out, format);
+	}
+
+	/**
+	 * Disposes of this rasterizer. This rasterizer becomes unusable after running this.
+	 */
+	public function dispose()
+	{
+		RasterizerExt.disposeRasterizer(_ID);
+	}
+}
@@ -0,0 +1,137 @@
+package nebulatracer;
+
+/**
+ * The order `NebulaTileScheduler.restart` queues tiles in.
+ */
+enum abstract TileOrder(Int)
+{
+	/**
+	 * Row by row, top to bottom.
+	 */
+	var ROWS = 0;
+
+	/**
+	 * Ring by ring around the focus point, so what the user looks at shows up first.
+	 */
+	var SPIRAL = 1;
+}
+
+/**
+ * Splits the screen into `NebulaFramebuffer.TILE_SIZE` tiles and hands them out to a fixed set of worker threads.
+ * 
+ * Every worker owns a queue and steals from the others once its own is empty. `restart` queues the whole screen
+ * as a new generation and throws away whatever was still queued, a worker tracing a tile from an older generation
+ * sees `isCurrent` turn false and should drop it. Call `cancel` then `waitIdle` before editing anything the workers read.
+ * 
+ * You can run `dispose` to free up resources once this scheduler isn't needed, it also releases the waiting workers.
+ */
+class NebulaTileScheduler
+{
+	private var _ID:Int;
+
+	public var width(default, null):Int;
+	public var height(default, null):Int;
+
+	/**
+	 * How many workers pull tiles from this scheduler, each one is identified by its index.
+	 */
+	public var workerCount(default, null):Int;
+
+	public var tilesX(get, never):Int;
+	public var tilesY(get, never):Int;
+
+	/**
+	 * How many tiles of the current generation haven't been finished yet.
+	 */
+	public var pending(get, never):Int;
+
+	/**
+	 * Creates a new NebulaTileScheduler.
+	 * @param workers How many workers will pull tiles, 0 uses one per hardware thread but one.
+	 */
+	public function new(width:Int, height:Int, workers:Int = 0)
+	{
+		this.width = width;
+		this.height = height;
+		_ID = TileSchedulerExt.newTileScheduler(width, height, workers);
+		workerCount = TileSchedulerExt.getWorkerCount(_ID);
+	}
+
+	/**
+	 * Queues every tile of the screen again as a new generation, cancelling the current one.
+	 * @param focusX The pixel a `SPIRAL` starts from.
+	 * @return The new generation.
+	 */
+	public function restart(order:TileOrder = ROWS, focusX:Float = 0, focusY:Float = 0):Int
+	{
+		return TileSchedulerExt.restart(_ID, width, height, cast order, focusX, focusY);
+	}
+
+	/**
+	 * Changes the size of the screen, it's used from the next `restart` on.
+	 */
+	public function resize(width:Int, height:Int)
+	{
+		this.width = width;
+		this.height = height;
+	}
+
+	/**
+	 * Cancels the current generation without queueing anything.
+	 */
+	public function cancel()
+	{
+		TileSchedulerExt.cancel(_ID);
+	}
+
+	/**
+	 * Blocks until every worker handed its tile back.
+	 */
+	public function waitIdle()
+	{
+		TileSchedulerExt.waitIdle(_ID);
+	}
+
+	/**
+	 * Gives `worker` its next tile (row by row, `tilesX` wide), blocking while there's none.
+	 * @return The tile, or -1 once this scheduler is disposed and the worker should stop.
+	 */
+	public function acquire(worker:Int):Int
+	{
+		return TileSchedulerExt.acquire(_ID, worker);
+	}
+
+	/**
+	 * Whether the tile `worker` is tracing still belongs to the current generation.
+	 */
+	public function isCurrent(worker:Int):Bool
+	{
+		return TileSchedulerExt.isCurrent(_ID, worker);
+	}
+
+	/**
+	 * Hands the tile `worker` was tracing back, whether it was finished or dropped.
+	 * @return How many tiles of the current generation are left.
+	 */
+	public function finish(worker:Int):Int
+	{
+		return TileSchedulerExt.finish(_ID, worker);
+	}
+
+	inline function get_tilesX():Int
+		return Std.int((width + NebulaFramebuffer.TILE_SIZE - 1) / NebulaFramebuffer.TILE_SIZE);
+
+	inline function get_tilesY():Int
+		return Std.int((height + NebulaFramebuffer.TILE_SIZE - 1) / NebulaFramebuffer.TILE_SIZE);
+
+	inline function get_pending():Int
+		return TileSchedulerExt.getPending(_ID);
+
+	/**
+	 * Disposes of this scheduler. This scheduler becomes unusable after running this.
+	 */
+	public function dispose()
+	{
+		TileSchedulerExt.disposeTileScheduler(_ID);
+	}
+}
@@ -50,15 +50,43 @@ class SimpleRay
  * You can use `traceRay` to trace a ray through the scene and get the result,
  * or `traceRays` to trace multiple rays at once. (Much faster on Embree.)
  * 
+ * Materials and lights are kept in their own native tables, edit them with `setMaterial`/`setLight` and upload
+ * the changes with `commitMaterials`/`commitLights`. These never touch the geometry or the BVH.
+ * 
  * You can run `dispose` to free up resources once this raytracer isn't needed.
  * 
  * TODO: When complete, make a simple tutorial here on how to use NebulaTracer.
  */
 class NebulaTracer
 {
+	/**
+	 * Size in bytes of one material record, must match `MaterialRecord` in nebulatracer.cpp.
+	 */
+	public static inline var MATERIAL_SIZE:Int = 32;
+
+	/**
+	 * Size in bytes of one light record, must match `LightRecord` in nebulatracer.cpp.
+	 */
+	public static inline var LIGHT_SIZE:Int = 32;
+
+	@:allow(nebulatracer.NebulaProbeGrid)
+	@:allow(nebulatracer.NebulaRadianceCache)
 	private var _ID:Int = 0;
 	private var _raytracerExt:RaytracerExt;
 
+	// local mirrors of the native tables, only the ranges that actually changed get uploaded
+	private var _materials:hl.Bytes = new hl.Bytes(MATERIAL_SIZE);
+	private var _materialCapacity:Int = 1;
+	private var _materialCount:Int = 0;
+	private var _materialsDirtyMin:Int = -1;
+	private var _materialsDirtyMax:Int = -1;
+	private var _materialsResized:Bool = false;
+	private var _lights:hl.Bytes = new hl.Bytes(LIGHT_SIZE);
+	private var _lightCapacity:Int = 1;
+	private var _lightCount:Int = 0;
+	private var _lightsDirty:Bool = false;
+	private var _scratch:hl.Bytes = new hl.Bytes(32);
+
 	/**
 	 * The geometry of the scene to be raytraced.  
 	 * TODO: Define a JSON format for geometry that the externs can parse
@@ -102,6 +130,173 @@ class NebulaTracer
 		_raytracerExt.rebuildBVH(_ID);
 	}
 
+	/**
+	 * Sets how many mesh parts the scene has, parts past `count` are removed from the scene.
+	 */
+	public function setMeshPartCount(count:Int)
+	{
+		_raytracerExt.setMeshPartCount(_ID, count);
+	}
+
+	/**
+	 * Uploads a mesh part into `slot`, the slot is also the geomID the part gets when traced.
+	 * The data is hashed natively and nothing is uploaded if it matches what's already in the slot.
+	 * The tracer keeps its own copy, the buffers can be edited or freed right after.
+	 * 
+	 * You must call `rebuildBVH` if this returns true.
+	 * @param vertices Packed float32 x, y, z positions.
+	 * @param indices Packed int32 triangle indices.
+	 * @return Whether the geometry in the slot changed.
+	 */
+	public function uploadMeshPart(slot:Int, vertices:hl.Bytes, vertexCount:Int, indices:hl.Bytes, indexCount:Int):Bool
+	{
+		return _raytracerExt.uploadMeshPart(_ID, slot, vertices, vertexCount, indices, indexCount);
+	}
+
+	/**
+	 * Whether `slot` already holds this exact geometry, in which case `uploadMeshPart` would do nothing.
+	 * Unlike the upload it can run while other threads trace the scene.
+	 */
+	public function meshPartMatches(slot:Int, vertices:hl.Bytes, vertexCount:Int, indices:hl.Bytes, indexCount:Int):Bool
+	{
+		return _raytracerExt.meshPartMatches(_ID, slot, vertices, vertexCount, indices, indexCount);
+	}
+
+	/**
+	 * Sets how many materials the scene has, there is one material per geometry (indexed by geomID).
+	 */
+	public function setMaterialCount(count:Int)
+	{
+		if (count == _materialCount)
+			return;
+		if (count > _materialCapacity)
+		{
+			var newCapacity = Std.int(Math.max(count, _materialCapacity * 2));
+			_materials = growRecords(_materials, _materialCapacity, newCapacity, MATERIAL_SIZE);
+			_materialCapacity = newCapacity;
+		}
+		if (count > _materialCount)
+			_materials.fill(_materialCount * MATERIAL_SIZE, (count - _materialCount) * MATERIAL_SIZE, 0);
+		_materialCount = count;
+		_materialsResized = true;
+		if (_materialsDirtyMax >= count)
+			_materialsDirtyMax = count - 1;
+		if (_materialsDirtyMin > _materialsDirtyMax)
+			_materialsDirtyMin = _materialsDirtyMax = -1;
+	}
+
+	/**
+	 * Sets the material of the geometry `index`. Nothing is uploaded if the material didn't change.
+	 * Call `commitMaterials` to send the changes to the raytracer.
+	 */
+	public function setMaterial(index:Int, red:Float, green:Float, blue:Float, reflectiveness:Float, emissiveness:Float, isEmitter:Bool)
+	{
+		if (index >= _materialCount)
+			setMaterialCount(index + 1);
+		_scratch.setF32(0, red);
+		_scratch.setF32(4, green);
+		_scratch.setF32(8, blue);
+		_scratch.setF32(12, reflectiveness);
+		_scratch.setF32(16, emissiveness);
+		_scratch.setI32(20, isEmitter ? 1 : 0);
+		_scratch.setI32(24, 0);
+		_scratch.setI32(28, 0);
+		var pos = index * MATERIAL_SIZE;
+		if (_materials.compare(pos, _scratch, 0, MATERIAL_SIZE) == 0)
+			return;
+		_materials.blit(pos, _scratch, 0, MATERIAL_SIZE);
+		if (_materialsDirtyMin == -1 || index < _materialsDirtyMin)
+			_materialsDirtyMin = index;
+		if (index > _materialsDirtyMax)
+			_materialsDirtyMax = index;
+	}
+
+	/**
+	 * Uploads the materials that changed since the last commit, this patches the native table in place.
+	 * @return Whether anything was uploaded.
+	 */
+	public function commitMaterials():Bool
+	{
+		if (_materialsDirtyMin == -1 && !_materialsResized)
+			return false;
+		var start = _materialsDirtyMin == -1 ? 0 : _materialsDirtyMin;
+		var count = _materialsDirtyMin == -1 ? 0 : _materialsDirtyMax - _materialsDirtyMin + 1;
+		_raytracerExt.updateMaterials(_ID, _materials.offset(start * MATERIAL_SIZE), start, count, _materialCount);
+		_materialsDirtyMin = _materialsDirtyMax = -1;
+		_materialsResized = false;
+		return true;
+	}
+
+	/**
+	 * Sets how many lights the scene has.
+	 */
+	public function setLightCount(count:Int)
+	{
+		if (count == _lightCount)
+			return;
+		if (count > _lightCapacity)
+		{
+			var newCapacity = Std.int(Math.max(count, _lightCapacity * 2));
+			_lights = growRecords(_lights, _lightCapacity, newCapacity, LIGHT_SIZE);
+			_lightCapacity = newCapacity;
+		}
+		if (count > _lightCount)
+			_lights.fill(_lightCount * LIGHT_SIZE, (count - _lightCount) * LIGHT_SIZE, 0);
+		_lightCount = count;
+		_lightsDirty = true;
+	}
+
+	/**
+	 * Sets the light `index`. `geomID` is the geometry that emits this light.
+	 * Call `commitLights` to send the changes to the raytracer.
+	 */
+	public function setLight(index:Int, x:Float, y:Float, z:Float, red:Float, green:Float, blue:Float, power:Float, geomID:Int)
+	{
+		if (index >= _lightCount)
+			setLightCount(index + 1);
+		_scratch.setF32(0, x);
+		_scratch.setF32(4, y);
+		_scratch.setF32(8, z);
+		_scratch.setF32(12, red);
+		_scratch.setF32(16, green);
+		_scratch.setF32(20, blue);
+		_scratch.setF32(24, power);
+		_scratch.setI32(28, geomID);
+		var pos = index * LIGHT_SIZE;
+		if (_lights.compare(pos, _scratch, 0, LIGHT_SIZE) == 0)
+			return;
+		_lights.blit(pos, _scratch, 0, LIGHT_SIZE);
+		_lightsDirty = true;
+	}
+
+	/**
+	 * Uploads the lights if any of them changed.
+	 * @return Whether anything was uploaded.
+	 */
+	public function commitLights():Bool
+	{
+		if (!_lightsDirty)
+			return false;
+		_raytracerExt.updateLights(_ID, _lights, _lightCount);
+		_lightsDirty = false;
+		return true;
+	}
+
+	/**
+	 * Whether `commitMaterials` or `commitLights` would upload anything.
+	 */
+	public function hasPendingChanges():Bool
+	{
+		return _materialsDirtyMin != -1 || _materialsResized || _lightsDirty;
+	}
+
+	function growRecords(records:hl.Bytes, oldCapacity:Int, newCapacity:Int, size:Int):hl.Bytes
+	{
+		var grown = new hl.Bytes(newCapacity * size);
+		grown.blit(0, records, 0, oldCapacity * size);
+		return grown;
+	}
+
 	/**
 	 * Traces a ray.
 	 * @param ray The ray to trace with.
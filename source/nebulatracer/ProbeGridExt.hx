@@ -0,0 +1,25 @@
+package nebulatracer;
+
+import nebulatracer.native.ProbeGrid;
+
+/**
+ * The native side of `NebulaProbeGrid`.
+ */
+class ProbeGridExt
+{
+	public static function newProbeGrid():Int
+		return ProbeGrid.new_probe_grid();
+
+	public static function disposeProbeGrid(id:Int)
+		ProbeGrid.dispose_probe_grid(id);
+
+	public static function reset(id:Int, raytracerID:Int, resolution:Int):Int
+		return ProbeGrid.reset_probe_grid(id, raytracerID, resolution);
+
+	public static function update(id:Int, raytracerID:Int, materialsID:Int, probeCount:Int, raysPerProbe:Int, maxRays:Int, skyR:Float, skyG:Float,
+			skyB:Float, cacheID:Int, bounces:Int):Int
+		return ProbeGrid.update_probe_grid(id, raytracerID, materialsID, probeCount, raysPerProbe, maxRays, skyR, skyG, skyB, cacheID, bounces);
+
+	public static function sample(id:Int, x:Float, y:Float, z:Float, normalX:Float, normalY:Float, normalZ:Float, out:hl.Bytes):Bool
+		return ProbeGrid.sample_probe_grid(id, x, y, z, normalX, normalY, normalZ, out);
+}
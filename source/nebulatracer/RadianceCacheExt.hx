@@ -0,0 +1,21 @@
+package nebulatracer;
+
+import nebulatracer.native.RadianceCache;
+
+/**
+ * The native side of `NebulaRadianceCache`.
+ */
+class RadianceCacheExt
+{
+	public static function newRadianceCache():Int
+		return RadianceCache.new_radiance_cache();
+
+	public static function disposeRadianceCache(id:Int)
+		RadianceCache.dispose_radiance_cache(id);
+
+	public static function reset(id:Int, raytracerID:Int, capacity:Int, cells:Int, minSamples:Int, maxSamples:Int)
+		RadianceCache.reset_radiance_cache(id, raytracerID, capacity, cells, minSamples, maxSamples);
+
+	public static function getSize(id:Int):Int
+		return RadianceCache.radiance_cache_size(id);
+}
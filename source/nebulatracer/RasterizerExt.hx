@@ -0,0 +1,143 @@
+package nebulatracer;
+
+import hl.F32;
+import nebulatracer.native.Raster;
+
+/**
+ * Everything the native projection needs to build the model-view-projection matrix of a mesh part.
+ */
+class ProjectionTransform
+{
+	public var meshX:F32 = 0;
+	public var meshY:F32 = 0;
+	public var meshZ:F32 = 0;
+	public var meshYaw:F32 = 0;
+	public var meshPitch:F32 = 0;
+	public var meshRoll:F32 = 0;
+	public var scaleX:F32 = 1;
+	public var scaleY:F32 = 1;
+	public var scaleZ:F32 = 1;
+
+	/**
+	 * The point the mesh part rotates and scales around, in local space.
+	 */
+	public var pivotX:F32 = 0;
+
+	public var pivotY:F32 = 0;
+	public var pivotZ:F32 = 0;
+	public var camX:F32 = 0;
+	public var camY:F32 = 0;
+	public var camZ:F32 = 0;
+	public var camYaw:F32 = 0;
+	public var camPitch:F32 = 0;
+	public var fov:F32 = 70;
+	public var aspect:F32 = 1;
+	public var nearPlane:F32 = 0.1;
+	public var farPlane:F32 = 100000;
+	public var width:F32 = 0;
+	public var height:F32 = 0;
+
+	/**
+	 * Applied to every UV (`uv * scale + offset`), e.g. to map it into a region of a texture atlas.
+	 */
+	public var uvScaleU:F32 = 1;
+
+	public var uvScaleV:F32 = 1;
+	public var uvOffsetU:F32 = 0;
+	public var uvOffsetV:F32 = 0;
+
+	/**
+	 * Local space bounding sphere, the whole part is skipped if it's outside the view frustum.
+	 * A negative radius turns frustum culling off.
+	 */
+	public var boundsX:F32 = 0;
+
+	public var boundsY:F32 = 0;
+	public var boundsZ:F32 = 0;
+	public var boundsRadius:F32 = -1;
+
+	/**
+	 * A `nebula.mesh.MeshPart.CullMode`, which screen space winding gets dropped.
+	 */
+	public var cullMode:Int = 0;
+
+	public function new() {}
+}
+
+class RasterizerExt
+{
+	/**
+	 * Transforms and projects a whole mesh part in one native call.
+	 * Parts outside the view frustum are rejected before any vertex is transformed,
+	 * back facing triangles are dropped according to `transform.cullMode`,
+	 * and triangles crossing the near or far plane are clipped against them in clip space.
+	 * 
+	 * The output is an unindexed triangle list: 2 float32 per vertex in `outVerts`, u, v, t float32 in `outUvt`,
+	 * an int32 index in `outIndices` and 1/w in `outDepth` (pass null if you don't need it).
+	 * Each output has to fit `indexCount * 3` vertices.
+	 * @return The number of vertices written.
+	 */
+	public static function projectMeshPart(transform:ProjectionTransform, positions:hl.Bytes, vertexCount:Int, indices:hl.Bytes, indexCount:Int,
+			uvs:hl.Bytes, uvCount:Int, outVerts:hl.Bytes, outUvt:hl.Bytes, outIndices:hl.Bytes, outDepth:hl.Bytes):Int
+	{
+		return Raster.project_mesh_part(transform, positions, vertexCount, indices, indexCount, uvs, uvCount, outVerts, outUvt, outIndices, outDepth);
+	}
+
+	/**
+	 * Applies only the model part of `transform` (mesh position, rotation and scale around the pivot) to packed
+	 * float32 x, y, z positions. `out` has to fit `vertexCount` positions.
+	 */
+	public static function transformMeshPart(transform:ProjectionTransform, positions:hl.Bytes, vertexCount:Int, out:hl.Bytes)
+		Raster.transform_mesh_part(transform, positions, vertexCount, out);
+
+	public static function newProjectionBatch():Int
+		return Raster.new_projection_batch();
+
+	public static function disposeProjectionBatch(id:Int)
+		Raster.dispose_projection_batch(id);
+
+	/**
+	 * Queues a `projectMeshPart` call in the batch `id`, `transform` is copied so it can be reused right away.
+	 * The buffers are only read and written by `runProjectionBatch`, keep them alive until then.
+	 */
+	public static function queueProjection(id:Int, transform:ProjectionTransform, positions:hl.Bytes, vertexCount:Int, indices:hl.Bytes, indexCount:Int,
+			uvs:hl.Bytes, uvCount:Int, outVerts:hl.Bytes, outUvt:hl.Bytes, outIndices:hl.Bytes, outDepth:hl.Bytes)
+		Raster.queue_projection(id, transform, positions, vertexCount, indices, indexCount, uvs, uvCount, outVerts, outUvt, outIndices, outDepth);
+
+	/**
+	 * Projects everything queued in the batch across all cores and empties it.
+	 * @param outCounts Gets the number of vertices written for every queued part (int32, in queue order).
+	 */
+	public static function runProjectionBatch(id:Int, outCounts:hl.Bytes)
+		Raster.run_projection_batch(id, outCounts);
+
+	/**
+	 * Copies a texture into nebulatracer so the rasterizer can sample it.
+	 * @param format The lime `PixelFormat` of `pixels`.
+	 * @return The ID of the texture.
+	 */
+	public static function createTexture(pixels:hl.Bytes, width:Int, height:Int, format:Int, premultiplied:Bool):Int
+		return Raster.create_raster_texture(pixels, width, height, format, premultiplied);
+
+	public static function disposeTexture(id:Int)
+		Raster.dispose_raster_texture(id);
+
+	public static function isTextureTranslucent(id:Int, x:Int, y:Int, width:Int, height:Int):Bool
+		return Raster.raster_texture_translucent(id, x, y, width, height);
+
+	public static function newRasterizer():Int
+		return Raster.new_rasterizer();
+
+	public static function disposeRasterizer(id:Int)
+		Raster.dispose_rasterizer(id);
+
+	public static function begin(id:Int, width:Int, height:Int, clearColor:Int)
+		Raster.begin_raster(id, width, height, clearColor);
+
+	public static function submit(id:Int, verts:hl.Bytes, depth:hl.Bytes, uvt:hl.Bytes, vertexCount:Int, textureID:Int, repeat:Bool, smooth:Bool,
+			blend:Int, translucent:Bool, offsetX:Float, offsetY:Float)
+		Raster.submit_raster(id, verts, depth, uvt, vertexCount, textureID, repeat, smooth, blend, translucent, offsetX, offsetY);
+
+	public static function finish(id:Int, out:hl.Bytes, format:Int)
+		Raster.finish_raster(id, out, format);
+}
@@ -49,6 +49,31 @@ class RaytracerExt
 		Embree.load_geometry_embree(geometry, id);
 	}
 
+	public function setMeshPartCount(id:Int, count:Int)
+	{
+		Embree.set_mesh_part_count_embree(id, count);
+	}
+
+	public function uploadMeshPart(id:Int, slot:Int, vertices:hl.Bytes, vertexCount:Int, indices:hl.Bytes, indexCount:Int):Bool
+	{
+		return Embree.upload_mesh_part_embree(id, slot, vertices, vertexCount, indices, indexCount);
+	}
+
+	public function meshPartMatches(id:Int, slot:Int, vertices:hl.Bytes, vertexCount:Int, indices:hl.Bytes, indexCount:Int):Bool
+	{
+		return Embree.mesh_part_matches_embree(id, slot, vertices, vertexCount, indices, indexCount);
+	}
+
+	public function updateMaterials(id:Int, records:hl.Bytes, start:Int, count:Int, total:Int)
+	{
+		Embree.update_materials_embree(id, records, start, count, total);
+	}
+
+	public function updateLights(id:Int, records:hl.Bytes, count:Int)
+	{
+		Embree.update_lights_embree(id, records, count);
+	}
+
 	public function traceRay(id:Int, ray:SimpleRay):TraceResult
 	{
 		var result = Embree.trace_ray_embree(id, ray);
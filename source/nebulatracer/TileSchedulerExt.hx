@@ -0,0 +1,39 @@
+package nebulatracer;
+
+import nebulatracer.native.TileScheduler;
+
+/**
+ * The native side of `NebulaTileScheduler`.
+ */
+class TileSchedulerExt
+{
+	public static function newTileScheduler(width:Int, height:Int, workers:Int):Int
+		return TileScheduler.new_tile_scheduler(width, height, workers);
+
+	public static function disposeTileScheduler(id:Int)
+		TileScheduler.dispose_tile_scheduler(id);
+
+	public static function getWorkerCount(id:Int):Int
+		return TileScheduler.tile_scheduler_workers(id);
+
+	public static function restart(id:Int, width:Int, height:Int, order:Int, focusX:Float, focusY:Float):Int
+		return TileScheduler.restart_tile_scheduler(id, width, height, order, focusX, focusY);
+
+	public static function cancel(id:Int)
+		TileScheduler.cancel_tile_scheduler(id);
+
+	public static function waitIdle(id:Int)
+		TileScheduler.wait_tile_scheduler_idle(id);
+
+	public static function acquire(id:Int, worker:Int):Int
+		return TileScheduler.acquire_tile(id, worker);
+
+	public static function isCurrent(id:Int, worker:Int):Bool
+		return TileScheduler.is_tile_current(id, worker);
+
+	public static function finish(id:Int, worker:Int):Int
+		return TileScheduler.finish_tile(id, worker);
+
+	public static function getPending(id:Int):Int
+		return TileScheduler.tile_scheduler_pending(id);
+}
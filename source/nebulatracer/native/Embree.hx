@@ -22,6 +22,18 @@ class Embree
 
 	public static function load_geometry_embree(string:String, id:Int):Void {}
 
+	public static function set_mesh_part_count_embree(id:Int, count:Int):Void {}
+
+	public static function upload_mesh_part_embree(id:Int, slot:Int, vertices:hl.Bytes, vertexCount:Int, indices:hl.Bytes, indexCount:Int):Bool
+		return false;
+
+	public static function mesh_part_matches_embree(id:Int, slot:Int, vertices:hl.Bytes, vertexCount:Int, indices:hl.Bytes, indexCount:Int):Bool
+		return false;
+
+	public static function update_materials_embree(id:Int, records:hl.Bytes, start:Int, count:Int, total:Int):Void {}
+
+	public static function update_lights_embree(id:Int, records:hl.Bytes, count:Int):Void {}
+
 	public static function trace_ray_embree(id:Int, ray:SimpleRay):TraceResult
 		return null;
 }
@@ -0,0 +1,42 @@
+package nebulatracer.native;
+
+import hl.Bytes;
+
+@:hlNative("nebulatracer")
+@:noCompletion
+class Framebuffer
+{
+	public static function new_framebuffer(width:Int, height:Int):Int
+		return 0;
+
+	public static function dispose_framebuffer(id:Int):Void {}
+
+	public static function reset_framebuffer(id:Int, width:Int, height:Int):Void {}
+
+	public static function add_framebuffer_sample(id:Int, x:Int, y:Int, r:Float, g:Float, b:Float):Void {}
+
+	public static function framebuffer_sample_count(id:Int, x:Int, y:Int):Int
+		return 0;
+
+	public static function resolve_framebuffer(id:Int, out:Bytes, fillRadius:Int):Float
+		return 0;
+
+	public static function update_framebuffer_convergence(id:Int, targetError:Float, minSamples:Int, maxSamples:Int, stride:Int,
+			outTileSamples:Bytes):Int
+		return 0;
+
+	public static function add_framebuffer_features(id:Int, x:Int, y:Int, albedoR:Float, albedoG:Float, albedoB:Float, normalX:Float, normalY:Float,
+		normalZ:Float, depth:Float, geomID:Int):Void {}
+
+	public static function reproject_framebuffer(id:Int, fromCamera:Bytes, toCamera:Bytes, maxHistory:Int):Int
+		return 0;
+
+	public static function is_denoiser_available(mode:Int):Bool
+		return false;
+
+	public static function denoise_framebuffer(id:Int, color:Bytes, out:Bytes, mode:Int, iterations:Int, sigmaColor:Float, sigmaNormal:Float,
+			sigmaDepth:Float):Int
+		return 0;
+
+	public static function tonemap_frame(color:Bytes, width:Int, height:Int, out:Bytes, format:Int, op:Int, exposure:Float, srgb:Bool):Void {}
+}
@@ -0,0 +1,53 @@
+package nebulatracer.native;
+
+import hl.Bytes;
+import hl.F32;
+
+@:hlNative("nebulatracer")
+@:noCompletion
+class MeshIO
+{
+	public static function load_obj_file(path:String):Int
+		return -1;
+
+	public static function load_obj_data(objData:String, mtlData:String, dir:String):Int
+		return -1;
+
+	public static function loaded_part_count(id:Int):Int
+		return 0;
+
+	public static function loaded_part_info(id:Int, part:Int, out:Bytes):Void {}
+
+	public static function loaded_part_texture(id:Int, part:Int):Bytes
+		return null;
+
+	public static function copy_loaded_part(id:Int, part:Int, vertices:Bytes, uvs:Bytes, indices:Bytes):Void {}
+
+	public static function free_loaded_mesh(id:Int):Void {}
+
+	public static function open_nmesh(path:String):Int
+		return -1;
+
+	public static function open_nmesh_data(data:Bytes, size:Int):Int
+		return -1;
+
+	public static function nmesh_part_count(id:Int):Int
+		return 0;
+
+	public static function nmesh_part_info(id:Int, part:Int, out:Bytes):Void {}
+
+	public static function nmesh_part_stream(id:Int, part:Int, stream:Int):Bytes
+		return null;
+
+	public static function nmesh_part_graphic(id:Int, part:Int):Bytes
+		return null;
+
+	public static function close_nmesh(id:Int):Void {}
+
+	public static function optimize_mesh_part(positions:Bytes, normals:Bytes, uvs:Bytes, uvCount:Int, vertexCount:Int, indices:Bytes, indexCount:Int,
+		tolerance:F32, outPositions:Bytes, outNormals:Bytes, outUvs:Bytes, outIndices:Bytes, outCounts:Bytes):Void {}
+
+	public static function simplify_mesh(positions:Bytes, vertexCount:Int, indices:Bytes, indexCount:Int, targetIndexCount:Int, maxError:F32,
+		outIndices:Bytes, outError:Bytes):Int
+		return 0;
+}
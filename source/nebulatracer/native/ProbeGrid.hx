@@ -0,0 +1,23 @@
+package nebulatracer.native;
+
+import hl.Bytes;
+
+@:hlNative("nebulatracer")
+@:noCompletion
+class ProbeGrid
+{
+	public static function new_probe_grid():Int
+		return 0;
+
+	public static function dispose_probe_grid(id:Int):Void {}
+
+	public static function reset_probe_grid(id:Int, raytracerID:Int, resolution:Int):Int
+		return 0;
+
+	public static function update_probe_grid(id:Int, raytracerID:Int, materialsID:Int, probeCount:Int, raysPerProbe:Int, maxRays:Int, skyR:Float,
+			skyG:Float, skyB:Float, cacheID:Int, bounces:Int):Int
+		return 0;
+
+	public static function sample_probe_grid(id:Int, x:Float, y:Float, z:Float, normalX:Float, normalY:Float, normalZ:Float, out:Bytes):Bool
+		return false;
+}
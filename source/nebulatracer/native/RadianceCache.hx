@@ -0,0 +1,16 @@
+package nebulatracer.native;
+
+@:hlNative("nebulatracer")
+@:noCompletion
+class RadianceCache
+{
+	public static function new_radiance_cache():Int
+		return 0;
+
+	public static function dispose_radiance_cache(id:Int):Void {}
+
+	public static function reset_radiance_cache(id:Int, raytracerID:Int, capacity:Int, cells:Int, minSamples:Int, maxSamples:Int):Void {}
+
+	public static function radiance_cache_size(id:Int):Int
+		return 0;
+}
@@ -0,0 +1,45 @@
+package nebulatracer.native;
+
+import hl.Bytes;
+import nebulatracer.RasterizerExt.ProjectionTransform;
+
+@:hlNative("nebulatracer")
+@:noCompletion
+class Raster
+{
+	public static function project_mesh_part(transform:ProjectionTransform, positions:Bytes, vertexCount:Int, indices:Bytes, indexCount:Int, uvs:Bytes,
+			uvCount:Int, outVerts:Bytes, outUvt:Bytes, outIndices:Bytes, outDepth:Bytes):Int
+		return 0;
+
+	public static function transform_mesh_part(transform:ProjectionTransform, positions:Bytes, vertexCount:Int, out:Bytes):Void {}
+
+	public static function new_projection_batch():Int
+		return 0;
+
+	public static function dispose_projection_batch(id:Int):Void {}
+
+	public static function queue_projection(id:Int, transform:ProjectionTransform, positions:Bytes, vertexCount:Int, indices:Bytes, indexCount:Int,
+		uvs:Bytes, uvCount:Int, outVerts:Bytes, outUvt:Bytes, outIndices:Bytes, outDepth:Bytes):Void {}
+
+	public static function run_projection_batch(id:Int, outCounts:Bytes):Void {}
+
+	public static function create_raster_texture(pixels:Bytes, width:Int, height:Int, format:Int, premultiplied:Bool):Int
+		return 0;
+
+	public static function dispose_raster_texture(id:Int):Void {}
+
+	public static function raster_texture_translucent(id:Int, x:Int, y:Int, width:Int, height:Int):Bool
+		return false;
+
+	public static function new_rasterizer():Int
+		return 0;
+
+	public static function dispose_rasterizer(id:Int):Void {}
+
+	public static function begin_raster(id:Int, width:Int, height:Int, clearColor:Int):Void {}
+
+	public static function submit_raster(id:Int, verts:Bytes, depth:Bytes, uvt:Bytes, vertexCount:Int, textureID:Int, repeat:Bool, smooth:Bool,
+		blend:Int, translucent:Bool, offsetX:Float, offsetY:Float):Void {}
+
+	public static function finish_raster(id:Int, out:Bytes, format:Int):Void {}
+}
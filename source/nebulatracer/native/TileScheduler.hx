@@ -0,0 +1,33 @@
+package nebulatracer.native;
+
+@:hlNative("nebulatracer")
+@:noCompletion
+class TileScheduler
+{
+	public static function new_tile_scheduler(width:Int, height:Int, workers:Int):Int
+		return 0;
+
+	public static function dispose_tile_scheduler(id:Int):Void {}
+
+	public static function tile_scheduler_workers(id:Int):Int
+		return 0;
+
+	public static function restart_tile_scheduler(id:Int, width:Int, height:Int, order:Int, focusX:Float, focusY:Float):Int
+		return 0;
+
+	public static function cancel_tile_scheduler(id:Int):Void {}
+
+	public static function wait_tile_scheduler_idle(id:Int):Void {}
+
+	public static function acquire_tile(id:Int, worker:Int):Int
+		return -1;
+
+	public static function is_tile_current(id:Int, worker:Int):Bool
+		return false;
+
+	public static function finish_tile(id:Int, worker:Int):Int
+		return 0;
+
+	public static function tile_scheduler_pending(id:Int):Int
+		return 0;
+}